@@ -4,12 +4,39 @@ namespace TextureSubPlugin
     enum Event
     {
         TextureSubImage2D = 0,
-        TextureSubImage3D = 1
+        TextureSubImage3D = 1,
+        CreateTexture3D = 2,
+        ClearTexture3D = 3,
+        FlushUploadQueue = 4,
+        WindowTexture3D = 5,
+        CreatePartitionedTexture3D = 6,
+        ClearPartitionedTexture3D = 7
     }
 
+    // values have to match the Format enum in source/Formats.h
     enum Format
     {
         R8 = 0,
-        RHalf = 1
+        R16 = 1,
+        [System.Obsolete("RHalf is 16-bit unsigned normalized, use R16 (or R16F for half floats)")]
+        RHalf = 1,
+        R16F = 2,
+        R32F = 3,
+        RG8 = 4,
+        RG16 = 5,
+        RGBA8 = 6,
+        R16_SNorm = 7,
+        R16UI = 8,
+        R32UI = 9,
+        BC4 = 10
+    }
+
+    // values have to match the Codec enum in source/Decompression.h
+    enum Codec
+    {
+        None = 0,
+        LZ4 = 1,
+        Zstd = 2,
+        DeltaR16 = 3
     }
 }
\ No newline at end of file
@@ -9,6 +9,28 @@ LOCAL_ARM_MODE := arm
 
 LOCAL_SRC_FILES += $(SRC_DIR)/RenderAPI.cpp
 LOCAL_SRC_FILES += $(SRC_DIR)/RenderingPlugin.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/UploadQueue.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/XXHash.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/ContentHashTable.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/BrickStatistics.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/FormatConversion.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/BlockCompression.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/WorkerPool.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/Decompression.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/DeltaCodec.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/MappedVolume.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/Downsample.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/BrickedVolume.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/ReadQueue.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/BrickPrefetcher.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/BrickCache.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/StagingAllocator.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/GpuMemoryBudget.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/PartitionedVolume.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/MipChain.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/BrickHalo.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/SliceRepacker.cpp
+LOCAL_SRC_FILES += $(SRC_DIR)/SwizzledVolume.cpp
 
 # OpenGL ES
 LOCAL_SRC_FILES += $(SRC_DIR)/RenderAPI_OpenGLCoreES.cpp
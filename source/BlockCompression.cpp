@@ -0,0 +1,221 @@
+#include "BlockCompression.h"
+
+#include <string.h>
+
+#include <memory>
+#include <sstream>
+
+#include "StagingAllocator.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BLOCK_COMPRESSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The encoder uses the 8 value mode of BC4 with the block's maximum as first
+// and its minimum as second endpoint. Palette entries are then evenly spaced
+// from max (index 0) over the 6 interpolated values (indices 2 to 7) to min
+// (index 1), so the nearest entry of a texel v is at position
+//   p = round(7 * (max - v) / (max - min))
+// which is computed exactly as the number of thresholds k = 0 ... 6 for which
+//   14 * (max - v) >= (2 * k + 1) * (max - min)
+// holds.
+
+/// @brief Maps a palette position (0: max ... 7: min) to a BC4 index.
+static inline uint32_t PaletteIndex(uint32_t position) {
+  uint32_t index = (position + 1) & 7;
+  return index < 2 ? index ^ 1 : index;
+}
+
+/// @brief Writes endpoints and 16 3-bit indices (as bytes) into a block.
+static void PackBC4Block(uint8_t max, uint8_t min, const uint8_t indices[16],
+                         uint8_t block[8]) {
+  block[0] = max;
+  block[1] = min;
+  uint64_t bits = 0;
+  for (int i = 0; i < 16; ++i) bits |= (uint64_t)indices[i] << (3 * i);
+  for (int i = 0; i < 6; ++i) block[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+void EncodeBC4Block(const uint8_t texels[16], uint8_t block[8]) {
+  uint8_t indices[16];
+#if BLOCK_COMPRESSION_SSE2
+  __m128i v = _mm_loadu_si128((const __m128i*)texels);
+  // horizontal min/max
+  __m128i vmin = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+  __m128i vmax = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+  vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 4));
+  vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 4));
+  vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 2));
+  vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 2));
+  vmin = _mm_min_epu8(vmin, _mm_srli_si128(vmin, 1));
+  vmax = _mm_max_epu8(vmax, _mm_srli_si128(vmax, 1));
+  uint8_t min = (uint8_t)_mm_cvtsi128_si32(vmin);
+  uint8_t max = (uint8_t)_mm_cvtsi128_si32(vmax);
+  if (max == min) {
+    memset(indices, 0, sizeof(indices));
+  } else {
+    int diff = max - min;
+    __m128i zero = _mm_setzero_si128();
+    __m128i d = _mm_subs_epu8(_mm_set1_epi8((char)max), v);
+    __m128i d_lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+                                   _mm_set1_epi16(14));
+    __m128i d_hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+                                   _mm_set1_epi16(14));
+    __m128i p_lo = zero, p_hi = zero;
+    for (int k = 0; k < 7; ++k) {
+      // compare masks are -1, subtracting them counts the thresholds
+      __m128i threshold = _mm_set1_epi16((short)((2 * k + 1) * diff - 1));
+      p_lo = _mm_sub_epi16(p_lo, _mm_cmpgt_epi16(d_lo, threshold));
+      p_hi = _mm_sub_epi16(p_hi, _mm_cmpgt_epi16(d_hi, threshold));
+    }
+    __m128i one = _mm_set1_epi8(1);
+    __m128i index = _mm_and_si128(
+        _mm_add_epi8(_mm_packus_epi16(p_lo, p_hi), one), _mm_set1_epi8(7));
+    index = _mm_xor_si128(
+        index, _mm_and_si128(_mm_cmplt_epi8(index, _mm_set1_epi8(2)), one));
+    _mm_storeu_si128((__m128i*)indices, index);
+  }
+#elif BLOCK_COMPRESSION_NEON
+  uint8x16_t v = vld1q_u8(texels);
+  uint8_t min = vminvq_u8(v);
+  uint8_t max = vmaxvq_u8(v);
+  if (max == min) {
+    memset(indices, 0, sizeof(indices));
+  } else {
+    int diff = max - min;
+    uint8x16_t d = vqsubq_u8(vdupq_n_u8(max), v);
+    uint16x8_t d_lo = vmull_u8(vget_low_u8(d), vdup_n_u8(14));
+    uint16x8_t d_hi = vmull_u8(vget_high_u8(d), vdup_n_u8(14));
+    uint16x8_t p_lo = vdupq_n_u16(0), p_hi = vdupq_n_u16(0);
+    for (int k = 0; k < 7; ++k) {
+      uint16x8_t threshold = vdupq_n_u16((uint16_t)((2 * k + 1) * diff));
+      p_lo = vsubq_u16(p_lo, vcgeq_u16(d_lo, threshold));
+      p_hi = vsubq_u16(p_hi, vcgeq_u16(d_hi, threshold));
+    }
+    uint8x16_t one = vdupq_n_u8(1);
+    uint8x16_t index =
+        vandq_u8(vaddq_u8(vcombine_u8(vmovn_u16(p_lo), vmovn_u16(p_hi)), one),
+                 vdupq_n_u8(7));
+    index = veorq_u8(index, vandq_u8(vcltq_u8(index, vdupq_n_u8(2)), one));
+    vst1q_u8(indices, index);
+  }
+#else
+  uint8_t min = 255, max = 0;
+  for (int i = 0; i < 16; ++i) {
+    if (texels[i] < min) min = texels[i];
+    if (texels[i] > max) max = texels[i];
+  }
+  int diff = max - min;
+  for (int i = 0; i < 16; ++i) {
+    indices[i] =
+        max == min ? 0
+                   : (uint8_t)PaletteIndex(
+                         (14 * (max - texels[i]) + diff) / (2 * diff));
+  }
+#endif
+  PackBC4Block(max, min, indices, block);
+}
+
+void EncodeBC4(const void* data_ptr, const SourceLayout& layout, int32_t width,
+               int32_t height, int32_t depth, uint8_t* blocks) {
+  size_t row_pitch = SourceRowPitch(layout, width, 1);
+  size_t slice_pitch = SourceSlicePitch(layout, width, height, 1);
+  const uint8_t* src = SourceOrigin(data_ptr, layout, width, height, 1);
+
+  uint8_t texels[16];
+  for (int32_t z = 0; z < depth; ++z) {
+    const uint8_t* slice = src + z * slice_pitch;
+    for (int32_t y = 0; y < height; y += 4) {
+      for (int32_t x = 0; x < width; x += 4) {
+        if (x + 4 <= width && y + 4 <= height) {
+          for (int32_t j = 0; j < 4; ++j)
+            memcpy(texels + 4 * j, slice + (y + j) * row_pitch + x, 4);
+        } else {
+          // repeat the last column/row of partial blocks
+          for (int32_t j = 0; j < 4; ++j) {
+            int32_t row = y + j < height ? y + j : height - 1;
+            for (int32_t i = 0; i < 4; ++i) {
+              int32_t column = x + i < width ? x + i : width - 1;
+              texels[4 * j + i] = slice[row * row_pitch + column];
+            }
+          }
+        }
+        EncodeBC4Block(texels, blocks);
+        blocks += 8;
+      }
+    }
+  }
+}
+
+void BlockCompressor::Register(void* texture_handle, int32_t width,
+                               int32_t height, Format format) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Texture& texture = m_Textures[texture_handle];
+  texture.width = width;
+  texture.height = height;
+  texture.format = format;
+}
+
+void BlockCompressor::Unregister(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Textures.erase(texture_handle);
+}
+
+void BlockCompressor::Clear() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Textures.clear();
+}
+
+bool BlockCompressor::IsRegistered(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Textures.find(texture_handle) != m_Textures.end();
+}
+
+bool BlockCompressor::Compress(const UploadCommand& cmd,
+                               UploadCommand& compressed) {
+  Texture texture;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::unordered_map<void*, Texture>::iterator it =
+        m_Textures.find(cmd.texture_handle);
+    if (it == m_Textures.end()) return false;
+    texture = it->second;
+  }
+
+  // partial blocks are only allowed at the border of the texture (level)
+  int32_t level_width = texture.width >> cmd.level;
+  int32_t level_height = texture.height >> cmd.level;
+  if (level_width < 1) level_width = 1;
+  if (level_height < 1) level_height = 1;
+  if (cmd.format != R8_UINT || texture.format != BC4_UNORM ||
+      cmd.width <= 0 || cmd.height <= 0 || cmd.depth <= 0 ||
+      cmd.xoffset % 4 != 0 || cmd.yoffset % 4 != 0 ||
+      (cmd.width % 4 != 0 && cmd.xoffset + cmd.width != level_width) ||
+      (cmd.height % 4 != 0 && cmd.yoffset + cmd.height != level_height)) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": upload of " << cmd.width << "x" << cmd.height
+       << "x" << cmd.depth << " texels of format " << cmd.format << " at ("
+       << cmd.xoffset << ", " << cmd.yoffset << ", " << cmd.zoffset
+       << ") is not 4x4 block aligned or not R8";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+
+  std::shared_ptr<uint8_t> blocks = g_StagingAllocator.Allocate(
+      TextureDataSize(BC4_UNORM, cmd.width, cmd.height, cmd.depth));
+  if (!blocks) return false;
+  EncodeBC4(cmd.data_ptr, cmd.layout, cmd.width, cmd.height, cmd.depth,
+            blocks.get());
+
+  compressed = cmd;
+  compressed.data_ptr = blocks.get();
+  compressed.layout = PackedSourceLayout();
+  compressed.format = BC4_UNORM;
+  compressed.storage = blocks;
+  return true;
+}
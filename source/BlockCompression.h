@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <unordered_map>
+
+#include "RenderAPI.h"
+#include "UploadQueue.h"
+
+/// @brief Encodes a 4x4 block of R8 texels (row-major) into a BC4/RGTC1
+/// block (8 bytes). Uses SSE2/NEON where available.
+void EncodeBC4Block(const uint8_t texels[16], uint8_t block[8]);
+
+/// @brief Encodes a box of R8 texels into BC4 blocks, slice by slice (rows of
+/// blocks, tightly packed). Partial blocks at the right/bottom border are
+/// padded by repeating the last column/row.
+/// @param blocks receives TextureDataSize(BC4_UNORM, width, height, depth)
+/// bytes
+void EncodeBC4(const void* data_ptr, const SourceLayout& layout, int32_t width,
+               int32_t height, int32_t depth, uint8_t* blocks);
+
+/// @brief Textures created with a block-compressed format whose uploads are
+/// encoded on the submitting (producer) thread.
+///
+/// R8 uploads to a registered BC4_UNORM texture are encoded into a buffer
+/// owned by the returned upload, so the render thread only has to upload
+/// half as many bytes.
+class BlockCompressor {
+ public:
+  void Register(void* texture_handle, int32_t width, int32_t height,
+                Format format);
+
+  void Unregister(void* texture_handle);
+
+  void Clear();
+
+  /// @brief Whether uploads to the texture have to be encoded first.
+  bool IsRegistered(void* texture_handle);
+
+  /// @brief Encodes the source of an upload to a registered texture.
+  /// @param cmd R8 upload whose x/y offsets are multiples of 4 and whose
+  /// width/height are multiples of 4 or reach the texture's border
+  /// @param compressed receives the upload of the encoded blocks
+  /// @return false (and logs an error) if cmd cannot be encoded
+  bool Compress(const UploadCommand& cmd, UploadCommand& compressed);
+
+ private:
+  struct Texture {
+    int32_t width;
+    int32_t height;
+    Format format;
+  };
+
+  std::mutex m_Mutex;
+  std::unordered_map<void*, Texture> m_Textures;
+};
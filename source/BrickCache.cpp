@@ -0,0 +1,134 @@
+#include "BrickCache.h"
+
+#include <string.h>
+
+#include "Decompression.h"
+
+// cost model of loading a brick again, in microseconds: a positional read of
+// its stored extent and decoding it if it is compressed
+static const double kReadLatency = 100.0;
+static const double kReadBytesPerMicrosecond = 1000.0;
+static const double kDecodeBytesPerMicrosecond = 500.0;
+
+static double ReadCost(size_t stored_size) {
+  return kReadLatency + stored_size / kReadBytesPerMicrosecond;
+}
+
+BrickCache::BrickCache() { memset(&m_Statistics, 0, sizeof(m_Statistics)); }
+
+void BrickCache::SetBudgets(size_t hot_bytes, size_t warm_bytes) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Hot.budget = hot_bytes;
+  m_Warm.budget = warm_bytes;
+  m_Hot.Evict(0);
+  m_Warm.Evict(0);
+}
+
+bool BrickCache::Find(const BrickKey& key, std::shared_ptr<uint8_t>& decoded,
+                      std::shared_ptr<uint8_t>& stored) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (Tier::Item* item = m_Hot.Find(key)) {
+    ++m_Statistics.hot_hits;
+    decoded = item->data;
+    return true;
+  }
+  if (Tier::Item* item = m_Warm.Find(key)) {
+    ++m_Statistics.warm_hits;
+    stored = item->data;
+    return true;
+  }
+  ++m_Statistics.misses;
+  return false;
+}
+
+bool BrickCache::ContainsDecoded(const BrickKey& key) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Hot.items.count(key) > 0;
+}
+
+void BrickCache::Insert(const BrickKey& key, const BrickedVolumeEntry& entry,
+                        const std::shared_ptr<uint8_t>& decoded,
+                        size_t decoded_size,
+                        const std::shared_ptr<uint8_t>& stored) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  bool compressed = entry.codec != kCodecNone;
+  if (compressed && stored) {
+    m_Warm.Insert(key, stored, entry.size, ReadCost(entry.size));
+  }
+  // decoding from the warm tier is cheaper than reading the file again
+  double cost = compressed ? decoded_size / kDecodeBytesPerMicrosecond : 0.0;
+  if (m_Warm.items.count(key) == 0) cost += ReadCost(entry.size);
+  m_Hot.Insert(key, decoded, decoded_size, cost);
+}
+
+void BrickCache::Forget(int32_t volume_id) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Tier* tiers[2] = {&m_Hot, &m_Warm};
+  for (int t = 0; t < 2; ++t) {
+    for (std::unordered_map<BrickKey, Tier::Item, BrickKeyHasher>::iterator
+             it = tiers[t]->items.begin();
+         it != tiers[t]->items.end();) {
+      std::unordered_map<BrickKey, Tier::Item, BrickKeyHasher>::iterator next =
+          it;
+      ++next;
+      if (it->first.volume_id == volume_id) tiers[t]->Erase(it);
+      it = next;
+    }
+  }
+}
+
+BrickCacheStatistics BrickCache::statistics() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  BrickCacheStatistics statistics = m_Statistics;
+  statistics.hot_bytes = m_Hot.bytes;
+  statistics.warm_bytes = m_Warm.bytes;
+  return statistics;
+}
+
+void BrickCache::ResetStatistics() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  memset(&m_Statistics, 0, sizeof(m_Statistics));
+}
+
+BrickCache::Tier::Item* BrickCache::Tier::Find(const BrickKey& key) {
+  std::unordered_map<BrickKey, Item, BrickKeyHasher>::iterator it =
+      items.find(key);
+  if (it == items.end()) return NULL;
+  Item& item = it->second;
+  priorities.erase(item.priority);
+  item.priority = priorities.insert(
+      std::make_pair(inflation + item.cost / item.size, key));
+  return &item;
+}
+
+void BrickCache::Tier::Insert(const BrickKey& key,
+                              const std::shared_ptr<uint8_t>& data,
+                              size_t size, double cost) {
+  std::unordered_map<BrickKey, Item, BrickKeyHasher>::iterator it =
+      items.find(key);
+  if (it != items.end()) Erase(it);
+  if (size == 0 || size > budget) return;
+  Evict(size);
+  Item& item = items[key];
+  item.data = data;
+  item.size = size;
+  item.cost = cost;
+  item.priority =
+      priorities.insert(std::make_pair(inflation + cost / size, key));
+  bytes += size;
+}
+
+void BrickCache::Tier::Erase(
+    std::unordered_map<BrickKey, Item, BrickKeyHasher>::iterator it) {
+  bytes -= it->second.size;
+  priorities.erase(it->second.priority);
+  items.erase(it);
+}
+
+void BrickCache::Tier::Evict(size_t size) {
+  while (bytes + size > budget && !priorities.empty()) {
+    std::multimap<double, BrickKey>::iterator lowest = priorities.begin();
+    inflation = lowest->first;
+    Erase(items.find(lowest->second));
+  }
+}
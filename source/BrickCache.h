@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "BrickedVolume.h"
+
+/// @brief Counters of a BrickCache, see GetBrickCacheStatistics.
+struct BrickCacheStatistics {
+  // lookups served by the hot tier
+  uint64_t hot_hits;
+  // lookups served by the warm tier (decoded again)
+  uint64_t warm_hits;
+  // lookups served by neither tier
+  uint64_t misses;
+  // current sizes of the tiers
+  uint64_t hot_bytes;
+  uint64_t warm_bytes;
+};
+
+/// @brief Host-memory cache of the bricks of bricked volumes, so that bricks
+/// evicted from the GPU can be uploaded again without reading the file.
+///
+/// The hot tier holds decoded bricks that can be uploaded right away, the
+/// warm tier the stored extents of compressed bricks that only need to be
+/// decoded. Each tier has its own budget in bytes and evicts with
+/// GreedyDual-Size: a brick's priority is the tier's inflation value plus its
+/// reload cost per byte, refreshed on every hit, and evicting a brick raises
+/// the inflation value to its priority. Bricks that are expensive to load
+/// again (read from the file rather than decoded from the warm tier, small
+/// bricks paying a whole read latency) are kept longer than their recency
+/// alone would allow.
+class BrickCache {
+ public:
+  BrickCache();
+
+  /// @brief Sets the budgets of the tiers (0 disables a tier) and evicts the
+  /// bricks that do not fit.
+  void SetBudgets(size_t hot_bytes, size_t warm_bytes);
+
+  /// @brief Looks a brick up.
+  /// @param decoded receives the decoded brick if it is in the hot tier
+  /// @param stored receives the stored extent if the brick is only in the
+  /// warm tier
+  /// @return false on a miss
+  bool Find(const BrickKey& key, std::shared_ptr<uint8_t>& decoded,
+            std::shared_ptr<uint8_t>& stored);
+
+  /// @brief Whether a brick is in the hot tier. Does not count as a lookup.
+  bool ContainsDecoded(const BrickKey& key);
+
+  /// @brief Keeps a loaded brick: the decoded brick in the hot tier and, if
+  /// the brick is compressed and stored is not NULL, its stored extent
+  /// (entry.size bytes) in the warm tier.
+  void Insert(const BrickKey& key, const BrickedVolumeEntry& entry,
+              const std::shared_ptr<uint8_t>& decoded, size_t decoded_size,
+              const std::shared_ptr<uint8_t>& stored);
+
+  /// @brief Drops the bricks of a volume.
+  void Forget(int32_t volume_id);
+
+  BrickCacheStatistics statistics();
+
+  void ResetStatistics();
+
+ private:
+  /// @brief A GreedyDual-Size cache of buffers.
+  struct Tier {
+    struct Item {
+      std::shared_ptr<uint8_t> data;
+      size_t size;
+      // reload cost in microseconds
+      double cost;
+      std::multimap<double, BrickKey>::iterator priority;
+    };
+
+    Tier() : budget(0), bytes(0), inflation(0.0) {}
+
+    /// @return the item, NULL if it is not cached. Refreshes its priority.
+    Item* Find(const BrickKey& key);
+
+    void Insert(const BrickKey& key, const std::shared_ptr<uint8_t>& data,
+                size_t size, double cost);
+
+    void Erase(std::unordered_map<BrickKey, Item, BrickKeyHasher>::iterator it);
+
+    /// @brief Evicts the lowest-priority items until size more bytes fit.
+    void Evict(size_t size);
+
+    size_t budget;
+    size_t bytes;
+    double inflation;
+    std::unordered_map<BrickKey, Item, BrickKeyHasher> items;
+    std::multimap<double, BrickKey> priorities;
+  };
+
+  std::mutex m_Mutex;
+  Tier m_Hot;
+  Tier m_Warm;
+  BrickCacheStatistics m_Statistics;
+};
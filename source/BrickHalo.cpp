@@ -0,0 +1,89 @@
+#include "BrickHalo.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+/// @brief Fills count texels with copies of the texel at src.
+static void RepeatTexel(const uint8_t* src, uint32_t bytes_per_texel,
+                        int32_t count, uint8_t* dst) {
+  for (int32_t i = 0; i < count; ++i, dst += bytes_per_texel)
+    memcpy(dst, src, bytes_per_texel);
+}
+
+void ClampPaddedBox(void* box, int32_t width, int32_t height, int32_t depth,
+                    uint32_t bytes_per_texel, const int32_t before[3],
+                    const int32_t after[3]) {
+  uint8_t* out = (uint8_t*)box;
+  size_t row_size = (size_t)width * bytes_per_texel;
+  size_t slice_size = row_size * height;
+  int32_t last_x = width - after[0] - 1;
+  int32_t last_y = height - after[1] - 1;
+  int32_t last_z = depth - after[2] - 1;
+
+  for (int32_t k = before[2]; k <= last_z; ++k) {
+    uint8_t* slice = out + (size_t)k * slice_size;
+    for (int32_t j = before[1]; j <= last_y; ++j) {
+      uint8_t* row = slice + (size_t)j * row_size;
+      RepeatTexel(row + (size_t)before[0] * bytes_per_texel, bytes_per_texel,
+                  before[0], row);
+      RepeatTexel(row + (size_t)last_x * bytes_per_texel, bytes_per_texel,
+                  after[0], row + (size_t)(last_x + 1) * bytes_per_texel);
+    }
+    for (int32_t j = 0; j < before[1]; ++j) {
+      memcpy(slice + (size_t)j * row_size,
+             slice + (size_t)before[1] * row_size, row_size);
+    }
+    for (int32_t j = last_y + 1; j < height; ++j) {
+      memcpy(slice + (size_t)j * row_size, slice + (size_t)last_y * row_size,
+             row_size);
+    }
+  }
+  for (int32_t k = 0; k < before[2]; ++k) {
+    memcpy(out + (size_t)k * slice_size,
+           out + (size_t)before[2] * slice_size, slice_size);
+  }
+  for (int32_t k = last_z + 1; k < depth; ++k) {
+    memcpy(out + (size_t)k * slice_size, out + (size_t)last_z * slice_size,
+           slice_size);
+  }
+}
+
+void GatherPaddedBox(const void* volume, int32_t volume_width,
+                     int32_t volume_height, int32_t volume_depth,
+                     uint32_t bytes_per_texel, int32_t x, int32_t y,
+                     int32_t z, int32_t width, int32_t height, int32_t depth,
+                     int32_t halo, void* dst) {
+  const uint8_t* texels = (const uint8_t*)volume;
+  uint8_t* out = (uint8_t*)dst;
+  int32_t padded_width = width + 2 * halo;
+  int32_t padded_height = height + 2 * halo;
+  int32_t padded_depth = depth + 2 * halo;
+  size_t row_size = (size_t)padded_width * bytes_per_texel;
+  size_t slice_size = row_size * padded_height;
+
+  // part of the padded box that lies within the volume
+  int32_t x0 = std::max(x - halo, 0);
+  int32_t y0 = std::max(y - halo, 0);
+  int32_t z0 = std::max(z - halo, 0);
+  int32_t x1 = std::min(x + width + halo, volume_width);
+  int32_t y1 = std::min(y + height + halo, volume_height);
+  int32_t z1 = std::min(z + depth + halo, volume_depth);
+  int32_t before[3] = {x0 - (x - halo), y0 - (y - halo), z0 - (z - halo)};
+  int32_t after[3] = {x + width + halo - x1, y + height + halo - y1,
+                      z + depth + halo - z1};
+
+  size_t copied = (size_t)(x1 - x0) * bytes_per_texel;
+  for (int32_t sz = z0; sz < z1; ++sz) {
+    uint8_t* slice = out + (size_t)(before[2] + sz - z0) * slice_size +
+                     (size_t)before[0] * bytes_per_texel;
+    for (int32_t sy = y0; sy < y1; ++sy) {
+      memcpy(slice + (size_t)(before[1] + sy - y0) * row_size,
+             texels + (((size_t)sz * volume_height + sy) * volume_width + x0) *
+                          bytes_per_texel,
+             copied);
+    }
+  }
+  ClampPaddedBox(dst, padded_width, padded_height, padded_depth,
+                 bytes_per_texel, before, after);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Maximum number of halo texels on each side of a padded brick.
+static const int32_t kMaxBrickHalo = 8;
+
+/// @brief Copies a box of a volume grown by halo texels on every side into
+/// (width + 2 * halo) x (height + 2 * halo) x (depth + 2 * halo) tightly
+/// packed texels, so that bricks of an atlas can be filtered (e.g.,
+/// trilinearly) across their borders without lookups into their neighbours.
+/// Halo texels outside the volume repeat the nearest texel of the volume
+/// (clamp-to-edge, as the sampler does at the border of a texture).
+///
+/// The rows within the volume are copied whole, the other texels are filled
+/// afterwards by ClampPaddedBox.
+/// @param volume tightly packed texels of the volume, x fastest
+/// @param x x offset of the box within the volume, the box has to lie within
+/// the volume
+/// @param dst has to hold the padded box
+void GatherPaddedBox(const void* volume, int32_t volume_width,
+                     int32_t volume_height, int32_t volume_depth,
+                     uint32_t bytes_per_texel, int32_t x, int32_t y,
+                     int32_t z, int32_t width, int32_t height, int32_t depth,
+                     int32_t halo, void* dst);
+
+/// @brief Fills the texels of a tightly packed padded box that lie outside
+/// the volume with the nearest texel inside it, once the texels inside it
+/// have been written. Rows are filled at their ends, and rows and slices that
+/// lie outside entirely are copies of the nearest padded row or slice.
+/// @param width padded width of the box
+/// @param before number of texels outside the volume before the first one
+/// inside it, along x, y and z
+/// @param after number of texels outside the volume after the last one
+/// inside it, along x, y and z
+void ClampPaddedBox(void* box, int32_t width, int32_t height, int32_t depth,
+                    uint32_t bytes_per_texel, const int32_t before[3],
+                    const int32_t after[3]);
+
+/// @brief Size in bytes of a box padded by halo texels on every side.
+inline size_t PaddedBoxSize(int32_t width, int32_t height, int32_t depth,
+                            int32_t halo, uint32_t bytes_per_texel) {
+  return (size_t)(width + 2 * halo) * (size_t)(height + 2 * halo) *
+         (size_t)(depth + 2 * halo) * bytes_per_texel;
+}
@@ -0,0 +1,294 @@
+#include "BrickPrefetcher.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+// bricks whose successors are remembered, the history is dropped when it
+// grows larger
+static const size_t kMaxHistory = 1 << 16;
+
+// steps longer than this (in bricks along an axis) are jumps (e.g., the
+// camera has been moved) that reset the direction of motion
+static const int32_t kMaxStep = 2;
+
+// weight of the latest step in the direction of motion
+static const float kDirectionWeight = 0.25f;
+
+/// @brief Stream of the requests of a (volume, level).
+static uint64_t StreamId(const BrickKey& key) {
+  return (uint64_t)(uint32_t)key.volume_id << 32 | (uint32_t)key.level;
+}
+
+BrickPrefetcher::BrickPrefetcher()
+    : m_MaxPredictions(0),
+      m_MaxBytes(0),
+      m_NextId(1),
+      m_LoadedBytes(0),
+      m_Pending(0) {
+  memset(&m_Statistics, 0, sizeof(m_Statistics));
+}
+
+void BrickPrefetcher::Configure(uint32_t max_predictions, size_t max_bytes) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_MaxPredictions = max_predictions;
+  m_MaxBytes = max_bytes;
+  if (max_predictions == 0) {
+    Drop([](const BrickKey&) { return true; });
+    m_History.clear();
+    m_Streams.clear();
+  }
+  Evict();
+}
+
+uint32_t BrickPrefetcher::max_predictions() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_MaxPredictions;
+}
+
+bool BrickPrefetcher::Request(const BrickKey& key, const Consumer& consumer) {
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  ++m_Statistics.requests;
+  std::unordered_map<BrickKey, Entry, BrickKeyHasher>::iterator it =
+      m_Entries.find(key);
+  if (it == m_Entries.end()) return false;
+  if (!it->second.started) {
+    // low-priority prefetches must not delay requests: the caller loads the
+    // brick and the prefetch is skipped
+    --m_Pending;
+    ++m_Statistics.wasted;
+    m_Entries.erase(it);
+    return false;
+  }
+  ++m_Statistics.hits;
+  if (!it->second.loaded) {
+    it->second.consumers.push_back(consumer);
+    return true;
+  }
+  // the brick is handed over, it is not kept for further requests
+  std::shared_ptr<uint8_t> data = it->second.data;
+  m_LoadedBytes -= it->second.size;
+  m_Entries.erase(it);
+  Evict();
+  lock.unlock();
+  consumer(data);
+  return true;
+}
+
+void BrickPrefetcher::Predict(const BrickKey& key,
+                              std::vector<BrickKey>& candidates) {
+  candidates.clear();
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (m_MaxPredictions == 0) return;
+
+  // history
+  std::unordered_map<uint64_t, Stream>::iterator stream =
+      m_Streams.find(StreamId(key));
+  if (stream == m_Streams.end()) {
+    Stream s;
+    s.last = key;
+    s.direction[0] = s.direction[1] = s.direction[2] = 0.0f;
+    stream = m_Streams.insert(std::make_pair(StreamId(key), s)).first;
+  } else if (!(stream->second.last == key)) {
+    Stream& s = stream->second;
+    int32_t step[3] = {key.x - s.last.x, key.y - s.last.y, key.z - s.last.z};
+    bool jump = false;
+    for (int i = 0; i < 3; ++i) jump = jump || abs(step[i]) > kMaxStep;
+    for (int i = 0; i < 3; ++i) {
+      s.direction[i] = jump ? 0.0f
+                            : (1.0f - kDirectionWeight) * s.direction[i] +
+                                  kDirectionWeight * step[i];
+    }
+
+    if (m_History.size() >= kMaxHistory) m_History.clear();
+    // value-initialized (zero counts) if new
+    Successors& successors = m_History[s.last];
+    if (successors.counts[0] > 0 && successors.keys[0] == key) {
+      ++successors.counts[0];
+    } else if (successors.counts[1] > 0 && successors.keys[1] == key) {
+      if (++successors.counts[1] > successors.counts[0]) {
+        std::swap(successors.keys[0], successors.keys[1]);
+        std::swap(successors.counts[0], successors.counts[1]);
+      }
+    } else {
+      int slot = successors.counts[0] == 0 ? 0 : 1;
+      successors.keys[slot] = key;
+      successors.counts[slot] = 1;
+    }
+    s.last = key;
+  }
+  const float* direction = stream->second.direction;
+
+  // candidates, most likely first
+  std::function<void(const BrickKey&)> add = [&](const BrickKey& candidate) {
+    if (candidate == key || m_Entries.count(candidate) > 0 ||
+        std::find(candidates.begin(), candidates.end(), candidate) !=
+            candidates.end())
+      return;
+    candidates.push_back(candidate);
+  };
+  std::unordered_map<BrickKey, Successors, BrickKeyHasher>::const_iterator
+      successors = m_History.find(key);
+  if (successors != m_History.end()) {
+    for (int i = 0; i < 2; ++i) {
+      if (successors->second.counts[i] > 0) add(successors->second.keys[i]);
+    }
+  }
+  BrickKey next = key;
+  next.x += direction[0] > 0.5f ? 1 : direction[0] < -0.5f ? -1 : 0;
+  next.y += direction[1] > 0.5f ? 1 : direction[1] < -0.5f ? -1 : 0;
+  next.z += direction[2] > 0.5f ? 1 : direction[2] < -0.5f ? -1 : 0;
+  add(next);
+
+  static const int32_t kFaces[6][3] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                       {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+  int order[6] = {0, 1, 2, 3, 4, 5};
+  std::stable_sort(order, order + 6, [&](int a, int b) {
+    float da = kFaces[a][0] * direction[0] + kFaces[a][1] * direction[1] +
+               kFaces[a][2] * direction[2];
+    float db = kFaces[b][0] * direction[0] + kFaces[b][1] * direction[1] +
+               kFaces[b][2] * direction[2];
+    return da > db;
+  });
+  for (int i = 0; i < 6; ++i) {
+    BrickKey neighbour = key;
+    neighbour.x += kFaces[order[i]][0];
+    neighbour.y += kFaces[order[i]][1];
+    neighbour.z += kFaces[order[i]][2];
+    add(neighbour);
+  }
+}
+
+bool BrickPrefetcher::Issue(const BrickKey& key, uint64_t& id) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  // a few requests worth of predictions may be pending
+  if (m_MaxPredictions == 0 || m_Pending >= 4 * (size_t)m_MaxPredictions ||
+      m_Entries.count(key) > 0)
+    return false;
+  Entry& entry = m_Entries[key];
+  entry.id = id = m_NextId++;
+  entry.started = false;
+  entry.loaded = false;
+  entry.size = 0;
+  ++m_Pending;
+  ++m_Statistics.issued;
+  return true;
+}
+
+bool BrickPrefetcher::Begin(const BrickKey& key, uint64_t id) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<BrickKey, Entry, BrickKeyHasher>::iterator it =
+      m_Entries.find(key);
+  if (it == m_Entries.end() || it->second.id != id) return false;
+  it->second.started = true;
+  return true;
+}
+
+void BrickPrefetcher::Complete(const BrickKey& key, uint64_t id,
+                               const std::shared_ptr<uint8_t>& data,
+                               size_t size) {
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  std::unordered_map<BrickKey, Entry, BrickKeyHasher>::iterator it =
+      m_Entries.find(key);
+  // canceled
+  if (it == m_Entries.end() || it->second.id != id) return;
+  --m_Pending;
+  std::vector<Consumer> consumers;
+  consumers.swap(it->second.consumers);
+  if (!consumers.empty() || !data) {
+    if (consumers.empty()) ++m_Statistics.wasted;
+    m_Entries.erase(it);
+    lock.unlock();
+    for (size_t i = 0; i < consumers.size(); ++i) consumers[i](data);
+    return;
+  }
+  it->second.loaded = true;
+  it->second.data = data;
+  it->second.size = size;
+  m_Loaded.push_back(std::make_pair(key, id));
+  m_LoadedBytes += size;
+  Evict();
+}
+
+void BrickPrefetcher::Cancel() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Drop([](const BrickKey&) { return true; });
+}
+
+void BrickPrefetcher::Forget(int32_t volume_id) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Drop([=](const BrickKey& key) { return key.volume_id == volume_id; });
+  for (std::unordered_map<BrickKey, Successors, BrickKeyHasher>::iterator it =
+           m_History.begin();
+       it != m_History.end();) {
+    if (it->first.volume_id == volume_id) {
+      it = m_History.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (std::unordered_map<uint64_t, Stream>::iterator it = m_Streams.begin();
+       it != m_Streams.end();) {
+    if (it->second.last.volume_id == volume_id) {
+      it = m_Streams.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+BrickPrefetchStatistics BrickPrefetcher::statistics() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Statistics;
+}
+
+void BrickPrefetcher::ResetStatistics() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  memset(&m_Statistics, 0, sizeof(m_Statistics));
+}
+
+void BrickPrefetcher::Evict() {
+  while (m_LoadedBytes > m_MaxBytes && !m_Loaded.empty()) {
+    std::unordered_map<BrickKey, Entry, BrickKeyHasher>::iterator it =
+        m_Entries.find(m_Loaded.front().first);
+    if (it != m_Entries.end() && it->second.loaded &&
+        it->second.id == m_Loaded.front().second) {
+      m_LoadedBytes -= it->second.size;
+      ++m_Statistics.wasted;
+      m_Entries.erase(it);
+    }
+    m_Loaded.pop_front();
+  }
+  // drop the ids of the entries requested in the meantime
+  size_t loaded = m_Entries.size() - m_Pending;
+  if (m_Loaded.size() > 2 * loaded + 64) {
+    std::deque<std::pair<BrickKey, uint64_t> > live;
+    for (size_t i = 0; i < m_Loaded.size(); ++i) {
+      std::unordered_map<BrickKey, Entry, BrickKeyHasher>::const_iterator it =
+          m_Entries.find(m_Loaded[i].first);
+      if (it != m_Entries.end() && it->second.id == m_Loaded[i].second)
+        live.push_back(m_Loaded[i]);
+    }
+    m_Loaded.swap(live);
+  }
+}
+
+void BrickPrefetcher::Drop(
+    const std::function<bool(const BrickKey&)>& predicate) {
+  for (std::unordered_map<BrickKey, Entry, BrickKeyHasher>::iterator it =
+           m_Entries.begin();
+       it != m_Entries.end();) {
+    if (it->second.consumers.empty() && predicate(it->first)) {
+      if (it->second.loaded) {
+        m_LoadedBytes -= it->second.size;
+      } else {
+        --m_Pending;
+      }
+      ++m_Statistics.wasted;
+      it = m_Entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
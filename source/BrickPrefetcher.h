@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "BrickedVolume.h"
+
+/// @brief Counters of a BrickPrefetcher, see GetBrickPrefetchStatistics.
+struct BrickPrefetchStatistics {
+  // bricks requested
+  uint64_t requests;
+  // requested bricks that had been prefetched (or were being loaded)
+  uint64_t hits;
+  // prefetches issued
+  uint64_t issued;
+  // prefetched bricks dropped without being requested (evicted, canceled or
+  // failed)
+  uint64_t wasted;
+};
+
+/// @brief Predicts the next bricks of bricked volumes from the sequence of
+/// requested bricks and keeps the bricks loaded ahead of time until they are
+/// requested.
+///
+/// Every requested brick is a step of the stream of its (volume, level). The
+/// predictions are, in order: the successors that followed the brick before
+/// (first-order Markov history), the next brick along the direction of
+/// motion (moving average of the steps) and the face neighbours of the
+/// brick, most aligned with the motion first. The caller loads the issued
+/// predictions (e.g., on low-priority worker tasks) and hands them back
+/// through Complete. Loaded bricks are kept up to a budget in bytes, oldest
+/// dropped first.
+class BrickPrefetcher {
+ public:
+  /// @brief Receives the data of a requested brick that had been prefetched,
+  /// NULL if loading it failed.
+  typedef std::function<void(const std::shared_ptr<uint8_t>& data)> Consumer;
+
+  BrickPrefetcher();
+
+  /// @brief Sets the number of predictions issued per request (0 disables
+  /// prefetching and drops the prefetched bricks) and the maximum size of the
+  /// loaded bricks kept.
+  void Configure(uint32_t max_predictions, size_t max_bytes);
+
+  uint32_t max_predictions();
+
+  /// @brief Records the request of a brick and takes its prefetched data.
+  /// @return true if the brick has been prefetched: consumer is called with
+  /// its data, right away or once the prefetch completes. false if the
+  /// caller has to load the brick itself (a prefetch that has not begun is
+  /// skipped).
+  bool Request(const BrickKey& key, const Consumer& consumer);
+
+  /// @brief Ranks the bricks likely to be requested after key (which must
+  /// have been requested last), skipping those prefetched already. The
+  /// caller issues the valid ones.
+  void Predict(const BrickKey& key, std::vector<BrickKey>& candidates);
+
+  /// @brief Issues the prefetch of a brick.
+  /// @param id receives the id of the prefetch to pass to Begin and Complete
+  /// @return false if the brick is already prefetched or too many prefetches
+  /// are pending
+  bool Issue(const BrickKey& key, uint64_t& id);
+
+  /// @brief Whether an issued prefetch is still wanted (i.e., has not been
+  /// canceled or requested) when its loading begins.
+  bool Begin(const BrickKey& key, uint64_t id);
+
+  /// @brief Stores the data of a prefetched brick (NULL if loading it failed)
+  /// or hands it to the consumers that requested it in the meantime.
+  void Complete(const BrickKey& key, uint64_t id,
+                const std::shared_ptr<uint8_t>& data, size_t size);
+
+  /// @brief Drops the prefetched bricks and the pending prefetches nobody
+  /// waits for. Prefetches that have not started are skipped.
+  void Cancel();
+
+  /// @brief Drops the history and the prefetched bricks of a volume.
+  void Forget(int32_t volume_id);
+
+  BrickPrefetchStatistics statistics();
+
+  void ResetStatistics();
+
+ private:
+  struct Entry {
+    uint64_t id;
+    // whether loading has begun
+    bool started;
+    bool loaded;
+    std::shared_ptr<uint8_t> data;
+    size_t size;
+    // requests waiting for the pending prefetch
+    std::vector<Consumer> consumers;
+  };
+
+  // successors of a brick in the request history
+  struct Successors {
+    BrickKey keys[2];
+    uint32_t counts[2];
+  };
+
+  // last request and direction of motion of a (volume, level)
+  struct Stream {
+    BrickKey last;
+    float direction[3];
+  };
+
+  /// @brief Drops the oldest loaded bricks until they fit into the budget.
+  /// m_Mutex must be held.
+  void Evict();
+
+  /// @brief Drops the entries that satisfy predicate and nobody waits for.
+  /// m_Mutex must be held.
+  void Drop(const std::function<bool(const BrickKey&)>& predicate);
+
+  std::mutex m_Mutex;
+  uint32_t m_MaxPredictions;
+  size_t m_MaxBytes;
+  uint64_t m_NextId;
+  std::unordered_map<BrickKey, Entry, BrickKeyHasher> m_Entries;
+  // ids of the loaded entries in completion order (entries requested in the
+  // meantime are skipped)
+  std::deque<std::pair<BrickKey, uint64_t> > m_Loaded;
+  size_t m_LoadedBytes;
+  size_t m_Pending;
+  std::unordered_map<BrickKey, Successors, BrickKeyHasher> m_History;
+  std::unordered_map<uint64_t, Stream> m_Streams;
+  BrickPrefetchStatistics m_Statistics;
+};
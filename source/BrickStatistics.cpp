@@ -0,0 +1,384 @@
+#include "BrickStatistics.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BRICK_STATS_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BRICK_STATS_NEON 1
+#include <arm_neon.h>
+#endif
+
+/// @brief Accumulates min/max/sum of a row of n R8 texels.
+static void AccumulateRowR8(const uint8_t* src, size_t n, uint32_t& min,
+                            uint32_t& max, uint64_t& sum) {
+  size_t i = 0;
+#if BRICK_STATS_SSE2
+  if (n >= 16) {
+    __m128i vmin = _mm_set1_epi8((char)0xFF);
+    __m128i vmax = _mm_setzero_si128();
+    __m128i vsum = _mm_setzero_si128();
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      vmin = _mm_min_epu8(vmin, v);
+      vmax = _mm_max_epu8(vmax, v);
+      vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, zero));
+    }
+    uint8_t lanes_min[16], lanes_max[16];
+    uint64_t lanes_sum[2];
+    _mm_storeu_si128((__m128i*)lanes_min, vmin);
+    _mm_storeu_si128((__m128i*)lanes_max, vmax);
+    _mm_storeu_si128((__m128i*)lanes_sum, vsum);
+    for (int l = 0; l < 16; ++l) {
+      if (lanes_min[l] < min) min = lanes_min[l];
+      if (lanes_max[l] > max) max = lanes_max[l];
+    }
+    sum += lanes_sum[0] + lanes_sum[1];
+  }
+#elif BRICK_STATS_NEON
+  if (n >= 16) {
+    uint8x16_t vmin = vdupq_n_u8(0xFF);
+    uint8x16_t vmax = vdupq_n_u8(0);
+    uint32x4_t vsum = vdupq_n_u32(0);
+    for (; i + 16 <= n; i += 16) {
+      uint8x16_t v = vld1q_u8(src + i);
+      vmin = vminq_u8(vmin, v);
+      vmax = vmaxq_u8(vmax, v);
+      vsum = vpadalq_u16(vsum, vpaddlq_u8(v));
+    }
+    uint8_t lanes_min[16], lanes_max[16];
+    uint32_t lanes_sum[4];
+    vst1q_u8(lanes_min, vmin);
+    vst1q_u8(lanes_max, vmax);
+    vst1q_u32(lanes_sum, vsum);
+    for (int l = 0; l < 16; ++l) {
+      if (lanes_min[l] < min) min = lanes_min[l];
+      if (lanes_max[l] > max) max = lanes_max[l];
+    }
+    sum += (uint64_t)lanes_sum[0] + lanes_sum[1] + lanes_sum[2] + lanes_sum[3];
+  }
+#endif
+  for (; i < n; ++i) {
+    uint32_t v = src[i];
+    if (v < min) min = v;
+    if (v > max) max = v;
+    sum += v;
+  }
+}
+
+/// @brief Accumulates min/max/sum of a row of n R16 texels.
+static void AccumulateRowR16(const uint16_t* src, size_t n, uint32_t& min,
+                             uint32_t& max, uint64_t& sum) {
+  size_t i = 0;
+#if BRICK_STATS_SSE2
+  if (n >= 8) {
+    // SSE2 only has signed 16-bit min/max: flip the sign bit to map the
+    // unsigned range onto the signed one
+    __m128i bias = _mm_set1_epi16((short)0x8000);
+    __m128i vmin = _mm_set1_epi16(0x7FFF);
+    __m128i vmax = _mm_set1_epi16((short)0x8000);
+    __m128i vsum = _mm_setzero_si128();
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i s = _mm_xor_si128(v, bias);
+      vmin = _mm_min_epi16(vmin, s);
+      vmax = _mm_max_epi16(vmax, s);
+      vsum = _mm_add_epi32(vsum, _mm_unpacklo_epi16(v, zero));
+      vsum = _mm_add_epi32(vsum, _mm_unpackhi_epi16(v, zero));
+    }
+    vmin = _mm_xor_si128(vmin, bias);
+    vmax = _mm_xor_si128(vmax, bias);
+    uint16_t lanes_min[8], lanes_max[8];
+    uint32_t lanes_sum[4];
+    _mm_storeu_si128((__m128i*)lanes_min, vmin);
+    _mm_storeu_si128((__m128i*)lanes_max, vmax);
+    _mm_storeu_si128((__m128i*)lanes_sum, vsum);
+    for (int l = 0; l < 8; ++l) {
+      if (lanes_min[l] < min) min = lanes_min[l];
+      if (lanes_max[l] > max) max = lanes_max[l];
+    }
+    sum += (uint64_t)lanes_sum[0] + lanes_sum[1] + lanes_sum[2] + lanes_sum[3];
+  }
+#elif BRICK_STATS_NEON
+  if (n >= 8) {
+    uint16x8_t vmin = vdupq_n_u16(0xFFFF);
+    uint16x8_t vmax = vdupq_n_u16(0);
+    uint32x4_t vsum = vdupq_n_u32(0);
+    for (; i + 8 <= n; i += 8) {
+      uint16x8_t v = vld1q_u16(src + i);
+      vmin = vminq_u16(vmin, v);
+      vmax = vmaxq_u16(vmax, v);
+      vsum = vpadalq_u16(vsum, v);
+    }
+    uint16_t lanes_min[8], lanes_max[8];
+    uint32_t lanes_sum[4];
+    vst1q_u16(lanes_min, vmin);
+    vst1q_u16(lanes_max, vmax);
+    vst1q_u32(lanes_sum, vsum);
+    for (int l = 0; l < 8; ++l) {
+      if (lanes_min[l] < min) min = lanes_min[l];
+      if (lanes_max[l] > max) max = lanes_max[l];
+    }
+    sum += (uint64_t)lanes_sum[0] + lanes_sum[1] + lanes_sum[2] + lanes_sum[3];
+  }
+#endif
+  for (; i < n; ++i) {
+    uint32_t v = src[i];
+    if (v < min) min = v;
+    if (v > max) max = v;
+    sum += v;
+  }
+}
+
+bool ComputeBrickStats(const void* data_ptr, const SourceLayout& layout,
+                       int32_t width, int32_t height, int32_t depth,
+                       Format format, BrickStats& stats) {
+  if (format != R8_UINT && format != R16_UINT) return false;
+  if (width <= 0 || height <= 0 || depth <= 0) return false;
+
+  uint32_t bytes_per_texel = BytesPerTexel(format);
+  size_t row_pitch = SourceRowPitch(layout, width, bytes_per_texel);
+  size_t slice_pitch = SourceSlicePitch(layout, width, height, bytes_per_texel);
+  const uint8_t* src =
+      SourceOrigin(data_ptr, layout, width, height, bytes_per_texel);
+
+  uint32_t min = 0xFFFFFFFF, max = 0;
+  uint64_t sum = 0;
+  for (int32_t z = 0; z < depth; ++z) {
+    const uint8_t* row = src + z * slice_pitch;
+    for (int32_t y = 0; y < height; ++y) {
+      if (format == R8_UINT) {
+        AccumulateRowR8(row, width, min, max, sum);
+      } else {
+        AccumulateRowR16((const uint16_t*)row, width, min, max, sum);
+      }
+      row += row_pitch;
+    }
+  }
+
+  stats.min = min;
+  stats.max = max;
+  stats.mean = (float)((double)sum / ((double)width * height * depth));
+  return true;
+}
+
+void BrickStatisticsTable::Register(void* texture_handle, int32_t width,
+                                    int32_t height, int32_t depth,
+                                    Format format, int32_t brick_width,
+                                    int32_t brick_height, int32_t brick_depth,
+                                    uint32_t empty_threshold,
+                                    void* metadata_texture_handle) {
+  if (width <= 0 || height <= 0 || depth <= 0 || brick_width <= 0 ||
+      brick_height <= 0 || brick_depth <= 0 || BytesPerTexel(format) == 0)
+    return;
+
+  Volume volume;
+  volume.width = width;
+  volume.height = height;
+  volume.depth = depth;
+  volume.format = format;
+  volume.brick_width = brick_width;
+  volume.brick_height = brick_height;
+  volume.brick_depth = brick_depth;
+  volume.bricks_x = (width + brick_width - 1) / brick_width;
+  volume.bricks_y = (height + brick_height - 1) / brick_height;
+  volume.bricks_z = (depth + brick_depth - 1) / brick_depth;
+  volume.empty_threshold = empty_threshold;
+  volume.metadata_texture_handle = metadata_texture_handle;
+  size_t brick_count =
+      (size_t)volume.bricks_x * volume.bricks_y * volume.bricks_z;
+  volume.stats.resize(brick_count);
+  volume.known.resize(brick_count, false);
+  if (metadata_texture_handle) {
+    volume.metadata.reset(
+        new std::vector<uint8_t>(brick_count * BytesPerTexel(format), 0));
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Volumes[texture_handle] = volume;
+}
+
+void BrickStatisticsTable::Unregister(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Volumes.erase(texture_handle);
+}
+
+void BrickStatisticsTable::Clear() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Volumes.clear();
+}
+
+bool BrickStatisticsTable::Analyze(const UploadCommand& cmd,
+                                   std::vector<UploadCommand>& uploads) {
+  Volume volume;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::unordered_map<void*, Volume>::iterator it =
+        m_Volumes.find(cmd.texture_handle);
+    if (it == m_Volumes.end() || cmd.level != 0 ||
+        cmd.format != it->second.format) {
+      uploads.push_back(cmd);
+      return false;
+    }
+    // copy everything but the (large) per-brick arrays so that the statistics
+    // can be computed without holding the lock
+    const Volume& registered = it->second;
+    volume.width = registered.width;
+    volume.height = registered.height;
+    volume.depth = registered.depth;
+    volume.format = registered.format;
+    volume.brick_width = registered.brick_width;
+    volume.brick_height = registered.brick_height;
+    volume.brick_depth = registered.brick_depth;
+    volume.bricks_x = registered.bricks_x;
+    volume.bricks_y = registered.bricks_y;
+    volume.bricks_z = registered.bricks_z;
+    volume.empty_threshold = registered.empty_threshold;
+    volume.metadata_texture_handle = registered.metadata_texture_handle;
+    volume.metadata = registered.metadata;
+  }
+
+  // range of bricks (clipped to the volume) that are fully covered by cmd
+  int32_t first[3], last[3];
+  const int32_t offset[3] = {cmd.xoffset, cmd.yoffset, cmd.zoffset};
+  const int32_t extent[3] = {cmd.width, cmd.height, cmd.depth};
+  const int32_t brick[3] = {volume.brick_width, volume.brick_height,
+                            volume.brick_depth};
+  const int32_t size[3] = {volume.width, volume.height, volume.depth};
+  bool tiled = true;
+  for (int a = 0; a < 3; ++a) {
+    int32_t end = offset[a] + extent[a];
+    first[a] = (offset[a] + brick[a] - 1) / brick[a];
+    last[a] = end >= size[a] ? (size[a] + brick[a] - 1) / brick[a]
+                             : end / brick[a];
+    if (offset[a] < 0 || first[a] >= last[a]) {
+      uploads.push_back(cmd);
+      return false;
+    }
+    // whether cmd is exactly the union of the covered bricks
+    int32_t covered_end = last[a] * brick[a] < size[a] ? last[a] * brick[a]
+                                                      : size[a];
+    tiled = tiled && first[a] * brick[a] == offset[a] && covered_end == end;
+  }
+
+  uint32_t bytes_per_texel = BytesPerTexel(cmd.format);
+  size_t first_upload = uploads.size();
+  std::vector<BrickStats> stats;
+  std::vector<size_t> indices;
+  bool any_empty = false;
+  for (int32_t bz = first[2]; bz < last[2]; ++bz) {
+    for (int32_t by = first[1]; by < last[1]; ++by) {
+      for (int32_t bx = first[0]; bx < last[0]; ++bx) {
+        UploadCommand sub = cmd;
+        sub.xoffset = bx * brick[0];
+        sub.yoffset = by * brick[1];
+        sub.zoffset = bz * brick[2];
+        sub.width = sub.xoffset + brick[0] < size[0] ? brick[0]
+                                                    : size[0] - sub.xoffset;
+        sub.height = sub.yoffset + brick[1] < size[1] ? brick[1]
+                                                     : size[1] - sub.yoffset;
+        sub.depth = sub.zoffset + brick[2] < size[2] ? brick[2]
+                                                    : size[2] - sub.zoffset;
+        sub.layout.row_length = (int32_t)(
+            SourceRowPitch(cmd.layout, cmd.width, bytes_per_texel) /
+            bytes_per_texel);
+        sub.layout.image_height =
+            cmd.layout.image_height > 0 ? cmd.layout.image_height : cmd.height;
+        sub.layout.skip_texels += sub.xoffset - cmd.xoffset;
+        sub.layout.skip_rows += sub.yoffset - cmd.yoffset;
+        sub.layout.skip_images += sub.zoffset - cmd.zoffset;
+
+        BrickStats brick_stats;
+        ComputeBrickStats(sub.data_ptr, sub.layout, sub.width, sub.height,
+                          sub.depth, sub.format, brick_stats);
+        stats.push_back(brick_stats);
+        indices.push_back(((size_t)bz * volume.bricks_y + by) *
+                              volume.bricks_x + bx);
+
+        if (brick_stats.max < volume.empty_threshold) {
+          any_empty = true;
+        } else {
+          uploads.push_back(sub);
+        }
+      }
+    }
+  }
+
+  // empty bricks can only be left out if nothing but bricks is uploaded
+  bool left_out = any_empty && tiled;
+  if (!left_out) {
+    uploads.resize(first_upload);
+    uploads.push_back(cmd);
+  }
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<void*, Volume>::iterator it =
+      m_Volumes.find(cmd.texture_handle);
+  // the texture may have been unregistered in the meantime
+  if (it == m_Volumes.end() || it->second.metadata != volume.metadata)
+    return left_out;
+  Volume& registered = it->second;
+  for (size_t b = 0; b < indices.size(); ++b) {
+    registered.stats[indices[b]] = stats[b];
+    registered.known[indices[b]] = true;
+  }
+  if (!volume.metadata) return left_out;
+
+  uint8_t* metadata = &(*volume.metadata)[0];
+  uint32_t bytes_per_metadata_texel = BytesPerTexel(volume.format);
+  for (size_t b = 0; b < indices.size(); ++b) {
+    size_t index = indices[b];
+    if (volume.format == R8_UINT) {
+      metadata[index] = (uint8_t)stats[b].max;
+    } else {
+      uint16_t value = (uint16_t)stats[b].max;
+      memcpy(metadata + index * sizeof(value), &value, sizeof(value));
+    }
+    // the host copy is updated by later uploads while this one is queued,
+    // so each upload owns a copy of its texel
+    std::shared_ptr<std::vector<uint8_t> > value(new std::vector<uint8_t>(
+        metadata + index * bytes_per_metadata_texel,
+        metadata + (index + 1) * bytes_per_metadata_texel));
+
+    UploadCommand texel;
+    texel.texture_handle = volume.metadata_texture_handle;
+    texel.xoffset = (int32_t)(index % volume.bricks_x);
+    texel.yoffset = (int32_t)(index / volume.bricks_x % volume.bricks_y);
+    texel.zoffset =
+        (int32_t)(index / ((size_t)volume.bricks_x * volume.bricks_y));
+    texel.width = 1;
+    texel.height = 1;
+    texel.depth = 1;
+    texel.data_ptr = &(*value)[0];
+    texel.layout = PackedSourceLayout();
+    texel.level = 0;
+    texel.format = volume.format;
+    texel.ticket = 0;
+    texel.storage = value;
+    uploads.push_back(texel);
+  }
+  return left_out;
+}
+
+bool BrickStatisticsTable::Get(void* texture_handle, int32_t brick_x,
+                               int32_t brick_y, int32_t brick_z,
+                               BrickStats& stats) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<void*, Volume>::iterator it =
+      m_Volumes.find(texture_handle);
+  if (it == m_Volumes.end()) return false;
+  const Volume& volume = it->second;
+  if (brick_x < 0 || brick_y < 0 || brick_z < 0 ||
+      brick_x >= volume.bricks_x || brick_y >= volume.bricks_y ||
+      brick_z >= volume.bricks_z)
+    return false;
+  size_t index =
+      ((size_t)brick_z * volume.bricks_y + brick_y) * volume.bricks_x + brick_x;
+  if (!volume.known[index]) return false;
+  stats = volume.stats[index];
+  return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderAPI.h"
+#include "UploadQueue.h"
+
+/// @brief Summary of the texel values of a single brick.
+struct BrickStats {
+  uint32_t min;
+  uint32_t max;
+  float mean;
+};
+
+/// @brief Computes the minimum, maximum and mean texel value of a box of
+/// unsigned R8/R16 texels. Uses SSE2/NEON where available.
+/// @return false if the format is not supported
+bool ComputeBrickStats(const void* data_ptr, const SourceLayout& layout,
+                       int32_t width, int32_t height, int32_t depth,
+                       Format format, BrickStats& stats);
+
+/// @brief Per-brick statistics of registered volume textures.
+///
+/// Queued uploads to a registered texture are analysed on the submitting
+/// thread: statistics are computed for every brick the upload fully covers,
+/// bricks whose maximum is below the texture's empty threshold are not
+/// uploaded at all, and the per-brick maxima are written into an optional
+/// metadata 3D texture (one texel per brick, same format as the volume) that
+/// shaders can use for empty-space skipping.
+class BrickStatisticsTable {
+ public:
+  /// @brief Starts computing per-brick statistics of a volume texture.
+  /// @param texture_handle the volume texture
+  /// @param width width of the volume texture
+  /// @param height height of the volume texture
+  /// @param depth depth of the volume texture
+  /// @param format format of the volume texture
+  /// @param brick_width width of a brick
+  /// @param brick_height height of a brick
+  /// @param brick_depth depth of a brick
+  /// @param empty_threshold bricks whose maximum is lower than this are not
+  /// uploaded. 0 uploads all bricks.
+  /// @param metadata_texture_handle optional (may be NULL) 3D texture of
+  /// ceil(width / brick_width) x ceil(height / brick_height) x
+  /// ceil(depth / brick_depth) texels of the provided format that receives the
+  /// per-brick maxima
+  void Register(void* texture_handle, int32_t width, int32_t height,
+                int32_t depth, Format format, int32_t brick_width,
+                int32_t brick_height, int32_t brick_depth,
+                uint32_t empty_threshold, void* metadata_texture_handle);
+
+  void Unregister(void* texture_handle);
+
+  void Clear();
+
+  /// @brief Analyses an upload to a (possibly unregistered) texture.
+  /// @param cmd the upload
+  /// @param uploads receives the uploads to execute instead of cmd: cmd
+  /// itself, the non-empty bricks of cmd and the metadata texture updates
+  /// @return true if empty bricks of cmd were left out
+  bool Analyze(const UploadCommand& cmd, std::vector<UploadCommand>& uploads);
+
+  /// @brief Retrieves the statistics of a brick of a registered texture.
+  /// @return false if the brick has not been uploaded yet
+  bool Get(void* texture_handle, int32_t brick_x, int32_t brick_y,
+           int32_t brick_z, BrickStats& stats);
+
+ private:
+  struct Volume {
+    int32_t width;
+    int32_t height;
+    int32_t depth;
+    Format format;
+    int32_t brick_width;
+    int32_t brick_height;
+    int32_t brick_depth;
+    int32_t bricks_x;
+    int32_t bricks_y;
+    int32_t bricks_z;
+    uint32_t empty_threshold;
+    void* metadata_texture_handle;
+    std::vector<BrickStats> stats;
+    std::vector<bool> known;
+    // host copy of the metadata texture, only accessed with m_Mutex held
+    std::shared_ptr<std::vector<uint8_t> > metadata;
+  };
+
+  std::mutex m_Mutex;
+  std::unordered_map<void*, Volume> m_Volumes;
+};
@@ -0,0 +1,250 @@
+#include "BrickedVolume.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <sstream>
+
+#include "Downsample.h"
+#include "PlatformBase.h"
+#include "RenderAPI.h"
+
+#if UNITY_WIN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define BRICKED_VOLUME_SUPPORTED 1
+#elif UNITY_METRO || UNITY_WEBGL
+#define BRICKED_VOLUME_SUPPORTED 0
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BRICKED_VOLUME_SUPPORTED 1
+#endif
+
+static const intptr_t kNoFile = -1;
+
+bool BrickKey::operator==(const BrickKey& other) const {
+  return volume_id == other.volume_id && level == other.level &&
+         x == other.x && y == other.y && z == other.z;
+}
+
+size_t BrickKeyHasher::operator()(const BrickKey& key) const {
+  uint64_t h = (uint64_t)(uint32_t)key.volume_id * 0x9E3779B97F4A7C15ull;
+  h ^= (uint64_t)(uint32_t)key.level + (h << 6) + (h >> 2);
+  h ^= (uint64_t)(uint32_t)key.x * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+  h ^= (uint64_t)(uint32_t)key.y * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+  h ^= (uint64_t)(uint32_t)key.z * 0x27D4EB2F165667C5ull + (h << 6) + (h >> 2);
+  return (size_t)h;
+}
+
+void BrickedVolumeLevelExtents(const BrickedVolumeHeader& header,
+                               int32_t level, int32_t& width, int32_t& height,
+                               int32_t& depth) {
+  width = header.width;
+  height = header.height;
+  depth = header.depth;
+  for (int32_t l = 0; l < level; ++l) {
+    width = DownsampledExtent(width);
+    height = DownsampledExtent(height);
+    depth = DownsampledExtent(depth);
+  }
+}
+
+void BrickedVolumeLevelBricks(const BrickedVolumeHeader& header, int32_t level,
+                              int32_t& bricks_x, int32_t& bricks_y,
+                              int32_t& bricks_z) {
+  int32_t width, height, depth;
+  BrickedVolumeLevelExtents(header, level, width, height, depth);
+  int32_t size = header.brick_size;
+  bricks_x = (width + size - 1) / size;
+  bricks_y = (height + size - 1) / size;
+  bricks_z = (depth + size - 1) / size;
+}
+
+BrickedVolume::BrickedVolume() : m_File(kNoFile), m_DirectFile(kNoFile) {
+  memset(&m_Header, 0, sizeof(m_Header));
+}
+
+BrickedVolume::~BrickedVolume() { Close(); }
+
+bool BrickedVolume::Open(const char* path) {
+  Close();
+  std::ostringstream ss;
+  ss << __FUNCTION__ << ": " << path << ": ";
+  uint64_t file_size = 0;
+
+#if !BRICKED_VOLUME_SUPPORTED
+  ss << "bricked volumes are not supported on this platform";
+  UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  return false;
+#else
+#if UNITY_WIN
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+  LARGE_INTEGER size;
+  if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) {
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    ss << "cannot open file (error " << GetLastError() << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  m_File = (intptr_t)file;
+  file_size = (uint64_t)size.QuadPart;
+#else
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) close(fd);
+    ss << "cannot open file (" << strerror(errno) << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  m_File = fd;
+  file_size = (uint64_t)st.st_size;
+#endif
+
+  // header
+  const BrickedVolumeHeader& h = m_Header;
+  if (!ReadAt(0, sizeof(m_Header), &m_Header) ||
+      h.magic != kBrickedVolumeMagic || h.version != kBrickedVolumeVersion ||
+      h.width <= 0 || h.height <= 0 || h.depth <= 0 || h.brick_size <= 0 ||
+      (uint32_t)h.format >= (uint32_t)kFormatCount ||
+      BytesPerTexel((Format)h.format) == 0 || h.level_count <= 0 ||
+      h.level_count > 32) {
+    ss << "not a bricked volume (version " << kBrickedVolumeVersion << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    Close();
+    return false;
+  }
+
+  // index
+  m_LevelStart.resize(h.level_count + 1);
+  m_LevelStart[0] = 0;
+  for (int32_t level = 0; level < h.level_count; ++level) {
+    int32_t bricks_x, bricks_y, bricks_z;
+    BrickedVolumeLevelBricks(h, level, bricks_x, bricks_y, bricks_z);
+    m_LevelStart[level + 1] =
+        m_LevelStart[level] + (uint64_t)bricks_x * bricks_y * bricks_z;
+  }
+  uint64_t index_size = h.brick_count * sizeof(BrickedVolumeEntry);
+  bool valid = h.brick_count == m_LevelStart[h.level_count] &&
+               h.index_offset <= file_size &&
+               index_size <= file_size - h.index_offset;
+  if (valid) {
+    m_Index.resize((size_t)h.brick_count);
+    valid = ReadAt(h.index_offset, (size_t)index_size, &m_Index[0]);
+  }
+  for (size_t i = 0; valid && i < m_Index.size(); ++i) {
+    valid = m_Index[i].offset <= file_size &&
+            m_Index[i].size <= file_size - m_Index[i].offset;
+  }
+  if (!valid) {
+    ss << "index of " << h.brick_count << " bricks is truncated or invalid";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    Close();
+    return false;
+  }
+
+#if UNITY_LINUX && defined(O_DIRECT)
+  // uncached reads of whole aligned extents, not every file system supports
+  // them (e.g., tmpfs)
+  if (h.alignment % 512 == 0) {
+    int direct_fd = open(path, O_RDONLY | O_DIRECT);
+    if (direct_fd >= 0) m_DirectFile = direct_fd;
+  }
+#endif
+  return true;
+#endif  // #if !BRICKED_VOLUME_SUPPORTED
+}
+
+void BrickedVolume::Close() {
+  if (m_File != kNoFile) {
+#if UNITY_WIN
+    CloseHandle((HANDLE)m_File);
+#elif BRICKED_VOLUME_SUPPORTED
+    close((int)m_File);
+#endif
+  }
+#if !UNITY_WIN && BRICKED_VOLUME_SUPPORTED
+  if (m_DirectFile != kNoFile) close((int)m_DirectFile);
+#endif
+  m_File = kNoFile;
+  m_DirectFile = kNoFile;
+  memset(&m_Header, 0, sizeof(m_Header));
+  m_Index.clear();
+  m_LevelStart.clear();
+}
+
+int BrickedVolume::descriptor(bool direct) const {
+#if UNITY_WIN
+  return -1;
+#else
+  return (int)(direct ? m_DirectFile : m_File);
+#endif
+}
+
+bool BrickedVolume::FindBrick(int32_t level, int32_t brick_x, int32_t brick_y,
+                              int32_t brick_z,
+                              BrickedVolumeBrick& brick) const {
+  if (m_File == kNoFile || level < 0 || level >= m_Header.level_count)
+    return false;
+  int32_t bricks_x, bricks_y, bricks_z;
+  BrickedVolumeLevelBricks(m_Header, level, bricks_x, bricks_y, bricks_z);
+  if (brick_x < 0 || brick_y < 0 || brick_z < 0 || brick_x >= bricks_x ||
+      brick_y >= bricks_y || brick_z >= bricks_z)
+    return false;
+
+  int32_t width, height, depth;
+  BrickedVolumeLevelExtents(m_Header, level, width, height, depth);
+  int32_t size = m_Header.brick_size;
+  brick.x = brick_x * size;
+  brick.y = brick_y * size;
+  brick.z = brick_z * size;
+  brick.width = width - brick.x < size ? width - brick.x : size;
+  brick.height = height - brick.y < size ? height - brick.y : size;
+  brick.depth = depth - brick.z < size ? depth - brick.z : size;
+  brick.entry =
+      m_Index[(size_t)(m_LevelStart[level] +
+                       ((uint64_t)brick_z * bricks_y + brick_y) * bricks_x +
+                       brick_x)];
+  return true;
+}
+
+bool BrickedVolume::ReadBrick(const BrickedVolumeBrick& brick,
+                              void* dst) const {
+  if (ReadAt(brick.entry.offset, brick.entry.size, dst)) return true;
+  std::ostringstream ss;
+  ss << __FUNCTION__ << ": cannot read " << brick.entry.size
+     << " bytes at offset " << brick.entry.offset;
+  UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  return false;
+}
+
+bool BrickedVolume::ReadAt(uint64_t offset, size_t size, void* dst) const {
+#if !BRICKED_VOLUME_SUPPORTED
+  return false;
+#else
+  uint8_t* out = (uint8_t*)dst;
+  while (size > 0) {
+#if UNITY_WIN
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+    DWORD read = 0;
+    if (!ReadFile((HANDLE)m_File, out, chunk, &read, &overlapped) || read == 0)
+      return false;
+#else
+    ssize_t read = pread((int)m_File, out, size, (off_t)offset);
+    if (read < 0 && errno == EINTR) continue;
+    if (read <= 0) return false;
+#endif
+    out += read;
+    offset += read;
+    size -= read;
+  }
+  return true;
+#endif  // #if !BRICKED_VOLUME_SUPPORTED
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "Formats.h"
+
+// Bricked multi-resolution volume container (.bvol), written by
+// tools/BrickBuilder.cpp.
+//
+// Level 0 is the full-resolution volume, every following level halves the
+// previous one along every axis (DownsampledExtent, see Downsample.h). Each
+// level is cut into bricks of brick_size^3 texels (smaller at the upper
+// borders). Every brick is stored as a single extent (a tightly packed box,
+// x fastest, optionally compressed with a Codec of Decompression.h) whose
+// offset is a multiple of the container's alignment, so that loading a brick
+// is a single positional read of a known extent.
+//
+// Layout of a file (little endian):
+//   BrickedVolumeHeader
+//   brick extents, each padded to a multiple of the alignment
+//   index: one BrickedVolumeEntry per brick, level by level, in z, y, x order
+//   within a level
+
+static const uint32_t kBrickedVolumeMagic = 0x4C4F5642;  // "BVOL"
+static const uint32_t kBrickedVolumeVersion = 1;
+
+struct BrickedVolumeHeader {
+  uint32_t magic;
+  uint32_t version;
+  int32_t width;  // extents of level 0
+  int32_t height;
+  int32_t depth;
+  int32_t format;  // Format of the texels
+  int32_t brick_size;
+  int32_t level_count;
+  uint32_t alignment;  // of the brick extents within the file
+  uint32_t reserved;
+  uint64_t index_offset;
+  uint64_t brick_count;  // of all levels
+  uint64_t reserved2[2];
+};
+
+struct BrickedVolumeEntry {
+  uint64_t offset;  // of the stored extent within the file
+  uint32_t size;    // of the stored extent in bytes
+  uint32_t codec;   // Codec of the stored extent, kCodecNone if uncompressed
+  uint32_t min;     // minimum texel value of the brick (integer formats)
+  uint32_t max;     // maximum texel value of the brick (integer formats)
+};
+
+/// @brief A brick of a bricked volume: its box within its level and its
+/// stored extent.
+struct BrickedVolumeBrick {
+  int32_t x;
+  int32_t y;
+  int32_t z;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  BrickedVolumeEntry entry;
+};
+
+/// @brief Identifies a brick of a bricked volume registered with the plugin.
+struct BrickKey {
+  int32_t volume_id;
+  int32_t level;
+  int32_t x;
+  int32_t y;
+  int32_t z;
+
+  bool operator==(const BrickKey& other) const;
+};
+
+struct BrickKeyHasher {
+  size_t operator()(const BrickKey& key) const;
+};
+
+/// @brief Extents of a level of a bricked volume.
+void BrickedVolumeLevelExtents(const BrickedVolumeHeader& header,
+                               int32_t level, int32_t& width, int32_t& height,
+                               int32_t& depth);
+
+/// @brief Number of bricks of a level along every axis.
+void BrickedVolumeLevelBricks(const BrickedVolumeHeader& header, int32_t level,
+                              int32_t& bricks_x, int32_t& bricks_y,
+                              int32_t& bricks_z);
+
+/// @brief Reader of bricked volume files. The header and index are read when
+/// the file is opened, bricks are read on demand with positional reads, so
+/// several threads can read bricks concurrently.
+class BrickedVolume {
+ public:
+  BrickedVolume();
+  ~BrickedVolume();
+
+  /// @brief Opens a file and reads its header and index.
+  /// @return false (and logs an error) if the file cannot be read or is not
+  /// a valid bricked volume
+  bool Open(const char* path);
+
+  void Close();
+
+  const BrickedVolumeHeader& header() const { return m_Header; }
+
+  /// @brief File descriptor of the file for asynchronous reads (POSIX
+  /// platforms).
+  /// @param direct whether to return the descriptor opened with O_DIRECT
+  /// (Linux, bricks aligned to 512 bytes or more)
+  /// @return -1 if there is no such descriptor
+  int descriptor(bool direct) const;
+
+  Format format() const { return (Format)m_Header.format; }
+
+  /// @brief Looks up a brick by its level and brick coordinates.
+  /// @return false if there is no such brick
+  bool FindBrick(int32_t level, int32_t brick_x, int32_t brick_y,
+                 int32_t brick_z, BrickedVolumeBrick& brick) const;
+
+  /// @brief Reads the stored extent of a brick (entry.size bytes) into dst.
+  /// Thread-safe.
+  /// @return false (and logs an error) if the read fails
+  bool ReadBrick(const BrickedVolumeBrick& brick, void* dst) const;
+
+ private:
+  BrickedVolume(const BrickedVolume&);
+  BrickedVolume& operator=(const BrickedVolume&);
+
+  /// @brief Reads size bytes at offset. Thread-safe.
+  bool ReadAt(uint64_t offset, size_t size, void* dst) const;
+
+  // file descriptor on POSIX platforms, HANDLE on Windows
+  intptr_t m_File;
+  // file descriptor opened with O_DIRECT on Linux, if the file allows it
+  intptr_t m_DirectFile;
+  BrickedVolumeHeader m_Header;
+  std::vector<BrickedVolumeEntry> m_Index;
+  // index of the first brick of every level
+  std::vector<uint64_t> m_LevelStart;
+};
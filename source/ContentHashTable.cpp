@@ -0,0 +1,215 @@
+#include "ContentHashTable.h"
+
+#include "XXHash.h"
+
+bool ContentHashTable::Region::operator==(const Region& other) const {
+  return xoffset == other.xoffset && yoffset == other.yoffset &&
+         zoffset == other.zoffset && width == other.width &&
+         height == other.height && depth == other.depth &&
+         level == other.level;
+}
+
+bool ContentHashTable::Region::Overlaps(const Region& other) const {
+  return level == other.level && xoffset < other.xoffset + other.width &&
+         other.xoffset < xoffset + width &&
+         yoffset < other.yoffset + other.height &&
+         other.yoffset < yoffset + height &&
+         zoffset < other.zoffset + other.depth &&
+         other.zoffset < zoffset + depth;
+}
+
+ContentHashTable::Region ContentHashTable::MakeRegion(
+    int32_t xoffset, int32_t yoffset, int32_t zoffset, int32_t width,
+    int32_t height, int32_t depth, int32_t level) {
+  Region region;
+  region.xoffset = xoffset;
+  region.yoffset = yoffset;
+  region.zoffset = zoffset;
+  region.width = width;
+  region.height = height;
+  region.depth = depth;
+  region.level = level;
+  return region;
+}
+
+bool ContentHashTable::IsGridCell(const Region& region, const Region& grid) {
+  return region.width == grid.width && region.height == grid.height &&
+         region.depth == grid.depth && region.xoffset % grid.width == 0 &&
+         region.yoffset % grid.height == 0 && region.zoffset % grid.depth == 0;
+}
+
+size_t ContentHashTable::RegionHasher::operator()(const Region& region) const {
+  return (size_t)XXHash64::Hash(&region, sizeof(region));
+}
+
+/// @brief Hashes the texels of an upload's source, row by row for strided
+/// sources.
+static uint64_t HashSource(int32_t width, int32_t height, int32_t depth,
+                           const void* data_ptr, const SourceLayout& layout,
+                           uint32_t bytes_per_texel) {
+  size_t row_size = (size_t)width * bytes_per_texel;
+  size_t row_pitch = SourceRowPitch(layout, width, bytes_per_texel);
+  size_t slice_pitch = SourceSlicePitch(layout, width, height, bytes_per_texel);
+  const uint8_t* src =
+      SourceOrigin(data_ptr, layout, width, height, bytes_per_texel);
+
+  if (row_pitch == row_size && slice_pitch == row_size * height) {
+    return XXHash64::Hash(src, slice_pitch * depth);
+  }
+
+  XXHash64 state;
+  for (int32_t z = 0; z < depth; ++z) {
+    const uint8_t* row = src + z * slice_pitch;
+    for (int32_t y = 0; y < height; ++y) {
+      state.Update(row, row_size);
+      row += row_pitch;
+    }
+  }
+  return state.Digest();
+}
+
+ContentHashTable::ContentHashTable() : m_Enabled(false) {}
+
+void ContentHashTable::Register(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  Texture& texture = m_Textures[texture_handle];
+  texture.regions.clear();
+  texture.uniform = true;
+}
+
+void ContentHashTable::Unregister(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Textures.erase(texture_handle);
+}
+
+void ContentHashTable::SetEnabled(bool enabled) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Enabled = enabled;
+  if (!enabled) {
+    for (std::unordered_map<void*, Texture>::iterator it = m_Textures.begin();
+         it != m_Textures.end(); ++it) {
+      it->second.regions.clear();
+      it->second.uniform = true;
+    }
+  }
+}
+
+void ContentHashTable::Clear() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Textures.clear();
+}
+
+bool ContentHashTable::IsRedundant(void* texture_handle, int32_t xoffset,
+                                   int32_t yoffset, int32_t zoffset,
+                                   int32_t width, int32_t height,
+                                   int32_t depth, const void* data_ptr,
+                                   const SourceLayout& layout, int32_t level,
+                                   Format format) {
+  uint64_t hash;
+  if (!Hash(texture_handle, xoffset, yoffset, zoffset, width, height, depth,
+            data_ptr, layout, level, format, hash)) {
+    return false;
+  }
+  if (IsResident(texture_handle, xoffset, yoffset, zoffset, width, height,
+                 depth, level, format, hash)) {
+    return true;
+  }
+  Record(texture_handle, xoffset, yoffset, zoffset, width, height, depth,
+         level, format, hash);
+  return false;
+}
+
+bool ContentHashTable::Hash(void* texture_handle, int32_t xoffset,
+                            int32_t yoffset, int32_t zoffset, int32_t width,
+                            int32_t height, int32_t depth,
+                            const void* data_ptr, const SourceLayout& layout,
+                            int32_t level, Format format, uint64_t& hash) {
+  uint32_t bytes_per_texel = BytesPerTexel(format);
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!m_Enabled || m_Textures.find(texture_handle) == m_Textures.end())
+      return false;
+  }
+  if (bytes_per_texel == 0 || width <= 0 || height <= 0 || depth <= 0) {
+    Invalidate(texture_handle, xoffset, yoffset, zoffset, width, height, depth,
+               level);
+    return false;
+  }
+
+  // hashing is the expensive part and does not need the lock
+  hash = HashSource(width, height, depth, data_ptr, layout, bytes_per_texel);
+  return true;
+}
+
+bool ContentHashTable::IsResident(void* texture_handle, int32_t xoffset,
+                                  int32_t yoffset, int32_t zoffset,
+                                  int32_t width, int32_t height,
+                                  int32_t depth, int32_t level, Format format,
+                                  uint64_t hash) {
+  Region region =
+      MakeRegion(xoffset, yoffset, zoffset, width, height, depth, level);
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<void*, Texture>::iterator it =
+      m_Textures.find(texture_handle);
+  if (!m_Enabled || it == m_Textures.end()) return false;
+  std::unordered_map<Region, Entry, RegionHasher>::const_iterator entry =
+      it->second.regions.find(region);
+  return entry != it->second.regions.end() && entry->second.hash == hash &&
+         entry->second.format == format;
+}
+
+void ContentHashTable::Record(void* texture_handle, int32_t xoffset,
+                              int32_t yoffset, int32_t zoffset, int32_t width,
+                              int32_t height, int32_t depth, int32_t level,
+                              Format format, uint64_t hash) {
+  Region region =
+      MakeRegion(xoffset, yoffset, zoffset, width, height, depth, level);
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<void*, Texture>::iterator it =
+      m_Textures.find(texture_handle);
+  if (!m_Enabled || it == m_Textures.end()) return;
+  Texture& texture = it->second;
+
+  InvalidateOverlapping(texture, region);
+  if (texture.regions.empty()) {
+    texture.uniform = true;
+    texture.grid = region;
+  }
+  if (!IsGridCell(region, texture.grid)) texture.uniform = false;
+
+  Entry& value = texture.regions[region];
+  value.hash = hash;
+  value.format = format;
+}
+
+void ContentHashTable::Invalidate(void* texture_handle, int32_t xoffset,
+                                  int32_t yoffset, int32_t zoffset,
+                                  int32_t width, int32_t height,
+                                  int32_t depth, int32_t level) {
+  Region region =
+      MakeRegion(xoffset, yoffset, zoffset, width, height, depth, level);
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<void*, Texture>::iterator it =
+      m_Textures.find(texture_handle);
+  if (it == m_Textures.end()) return;
+  it->second.regions.erase(region);
+  InvalidateOverlapping(it->second, region);
+}
+
+void ContentHashTable::InvalidateOverlapping(Texture& texture,
+                                             const Region& region) {
+  // cells of the same grid only overlap themselves
+  if (texture.regions.empty() ||
+      (texture.uniform && IsGridCell(region, texture.grid)))
+    return;
+
+  std::unordered_map<Region, Entry, RegionHasher>::iterator it =
+      texture.regions.begin();
+  while (it != texture.regions.end()) {
+    if (!(it->first == region) && it->first.Overlaps(region)) {
+      it = texture.regions.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
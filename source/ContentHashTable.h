@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderAPI.h"
+
+/// @brief Keeps a hash of the content of every uploaded region of the
+/// textures created through CreateTexture3D so that uploads of content that
+/// is already resident can be dropped.
+///
+/// Hashes are computed on the submitting (producer) thread, the render thread
+/// never has to touch the uploaded data. Uploads to a region invalidate the
+/// hashes of all other regions they overlap.
+class ContentHashTable {
+ public:
+  ContentHashTable();
+
+  /// @brief Starts tracking the content of a texture.
+  void Register(void* texture_handle);
+
+  /// @brief Stops tracking the content of a texture and drops its hashes.
+  void Unregister(void* texture_handle);
+
+  /// @brief Enables/disables content hashing. Disabling drops all hashes
+  /// since uploads are not tracked while disabled.
+  void SetEnabled(bool enabled);
+
+  /// @brief Hashes the upload's source and compares it against the hash of
+  /// the region's resident content. If it differs, the region's hash is
+  /// updated. Uploads to textures that are not registered are never
+  /// considered redundant.
+  /// @return true if the upload is redundant and can be dropped
+  bool IsRedundant(void* texture_handle, int32_t xoffset, int32_t yoffset,
+                   int32_t zoffset, int32_t width, int32_t height,
+                   int32_t depth, const void* data_ptr,
+                   const SourceLayout& layout, int32_t level, Format format);
+
+  /// @brief Hashes the upload's source without comparing or recording it,
+  /// for uploads whose hash is only recorded once they executed (see
+  /// IsResident and Record).
+  /// @param hash receives the hash of the source
+  /// @return false if the texture's content is not tracked
+  bool Hash(void* texture_handle, int32_t xoffset, int32_t yoffset,
+            int32_t zoffset, int32_t width, int32_t height, int32_t depth,
+            const void* data_ptr, const SourceLayout& layout, int32_t level,
+            Format format, uint64_t& hash);
+
+  /// @brief Whether the region's resident content has the provided hash.
+  bool IsResident(void* texture_handle, int32_t xoffset, int32_t yoffset,
+                  int32_t zoffset, int32_t width, int32_t height,
+                  int32_t depth, int32_t level, Format format, uint64_t hash);
+
+  /// @brief Records the hash of the content uploaded to a region and
+  /// invalidates the hashes of the other regions it overlaps.
+  void Record(void* texture_handle, int32_t xoffset, int32_t yoffset,
+              int32_t zoffset, int32_t width, int32_t height, int32_t depth,
+              int32_t level, Format format, uint64_t hash);
+
+  /// @brief Invalidates the hashes of all regions overlapping the provided
+  /// box (e.g., for uploads whose content is not known).
+  void Invalidate(void* texture_handle, int32_t xoffset, int32_t yoffset,
+                  int32_t zoffset, int32_t width, int32_t height,
+                  int32_t depth, int32_t level);
+
+  /// @brief Drops all hashes of all textures (e.g., on device shutdown).
+  void Clear();
+
+ private:
+  struct Region {
+    int32_t xoffset;
+    int32_t yoffset;
+    int32_t zoffset;
+    int32_t width;
+    int32_t height;
+    int32_t depth;
+    int32_t level;
+
+    bool operator==(const Region& other) const;
+    bool Overlaps(const Region& other) const;
+  };
+
+  struct RegionHasher {
+    size_t operator()(const Region& region) const;
+  };
+
+  struct Entry {
+    uint64_t hash;
+    Format format;
+  };
+
+  struct Texture {
+    std::unordered_map<Region, Entry, RegionHasher> regions;
+    // as long as all regions are cells of the same grid (the usual case when
+    // streaming fixed-size bricks), regions can only overlap themselves and
+    // invalidation does not need to scan all regions
+    bool uniform;
+    Region grid;
+  };
+
+  static Region MakeRegion(int32_t xoffset, int32_t yoffset, int32_t zoffset,
+                           int32_t width, int32_t height, int32_t depth,
+                           int32_t level);
+
+  /// @brief Whether region is a cell of the grid whose cell size is the size
+  /// of the provided grid region.
+  static bool IsGridCell(const Region& region, const Region& grid);
+
+  /// @brief Drops the hashes of all regions overlapping region except for
+  /// region itself.
+  static void InvalidateOverlapping(Texture& texture, const Region& region);
+
+  std::mutex m_Mutex;
+  bool m_Enabled;
+  std::unordered_map<void*, Texture> m_Textures;
+};
@@ -0,0 +1,221 @@
+#include "Decompression.h"
+
+#include <string.h>
+
+#include <sstream>
+
+#include "DeltaCodec.h"
+#include "RenderAPI.h"
+
+#if SUPPORT_ZSTD
+#include <zstd.h>
+#endif
+
+static const uint32_t kLZ4FrameMagic = 0x184D2204;
+// skippable frames use the magic numbers 0x184D2A50 ... 0x184D2A5F
+static const uint32_t kLZ4SkippableMagic = 0x184D2A50;
+
+static inline uint32_t ReadLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+/// @brief Reads the extension bytes of an LZ4 literal/match length (each 255
+/// continues it).
+/// @return false if src ends before the length does
+static inline bool ReadLZ4Length(const uint8_t*& ip, const uint8_t* iend,
+                                 size_t& length) {
+  uint8_t byte;
+  do {
+    if (ip >= iend) return false;
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/// @brief Decodes an LZ4 block and appends it to dst[pos ... capacity).
+/// Matches may reference everything decoded so far (dst[0 ... pos)), which
+/// also covers linked blocks of an LZ4 frame.
+/// @return false if the block is malformed or does not fit into dst
+static bool DecodeLZ4Block(const uint8_t* src, size_t src_size, uint8_t* dst,
+                           size_t& pos, size_t capacity) {
+  const uint8_t* ip = src;
+  const uint8_t* iend = src + src_size;
+  while (ip < iend) {
+    uint32_t token = *ip++;
+
+    size_t literals = token >> 4;
+    if (literals == 15 && !ReadLZ4Length(ip, iend, literals)) return false;
+    if ((size_t)(iend - ip) < literals || capacity - pos < literals)
+      return false;
+    memcpy(dst + pos, ip, literals);
+    ip += literals;
+    pos += literals;
+    // the last sequence of a block only consists of literals
+    if (ip == iend) break;
+
+    if (iend - ip < 2) return false;
+    size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > pos) return false;
+    size_t length = token & 15;
+    if (length == 15 && !ReadLZ4Length(ip, iend, length)) return false;
+    length += 4;
+    if (capacity - pos < length) return false;
+
+    uint8_t* op = dst + pos;
+    const uint8_t* match = op - offset;
+    pos += length;
+    if (offset >= 8) {
+      // chunks of 8 bytes never overlap their source
+      for (; length >= 8; length -= 8, op += 8, match += 8)
+        memcpy(op, match, 8);
+    }
+    // overlapping matches repeat the last offset bytes
+    for (; length > 0; --length) *op++ = *match++;
+  }
+  return true;
+}
+
+/// @brief Decodes a sequence of (skippable) LZ4 frames. Block and content
+/// checksums are skipped, not verified.
+static bool DecodeLZ4Frames(const uint8_t* src, size_t src_size, uint8_t* dst,
+                            size_t dst_size) {
+  const uint8_t* ip = src;
+  const uint8_t* iend = src + src_size;
+  size_t pos = 0;
+  while (ip < iend) {
+    if (iend - ip < 4) return false;
+    uint32_t magic = ReadLE32(ip);
+    ip += 4;
+    if ((magic & 0xFFFFFFF0) == kLZ4SkippableMagic) {
+      if (iend - ip < 4) return false;
+      size_t size = ReadLE32(ip);
+      ip += 4;
+      if ((size_t)(iend - ip) < size) return false;
+      ip += size;
+      continue;
+    }
+    if (magic != kLZ4FrameMagic) return false;
+
+    // frame descriptor: FLG, BD, [content size], [dictionary id], HC
+    if (iend - ip < 3) return false;
+    uint8_t flags = ip[0];
+    if ((flags >> 6) != 1 || (flags & 0x01) != 0) return false;
+    bool block_checksum = (flags & 0x10) != 0;
+    bool content_size = (flags & 0x08) != 0;
+    bool content_checksum = (flags & 0x04) != 0;
+    size_t descriptor_size = 3 + (content_size ? 8 : 0);
+    if ((size_t)(iend - ip) < descriptor_size) return false;
+    ip += descriptor_size;
+
+    for (;;) {
+      if (iend - ip < 4) return false;
+      uint32_t block_size = ReadLE32(ip);
+      ip += 4;
+      if (block_size == 0) break;  // end mark
+      bool uncompressed = (block_size & 0x80000000) != 0;
+      block_size &= 0x7FFFFFFF;
+      if ((size_t)(iend - ip) < block_size) return false;
+      if (uncompressed) {
+        if (dst_size - pos < block_size) return false;
+        memcpy(dst + pos, ip, block_size);
+        pos += block_size;
+      } else if (!DecodeLZ4Block(ip, block_size, dst, pos, dst_size)) {
+        return false;
+      }
+      ip += block_size;
+      if (block_checksum) {
+        if (iend - ip < 4) return false;
+        ip += 4;
+      }
+    }
+    if (content_checksum) {
+      if (iend - ip < 4) return false;
+      ip += 4;
+    }
+  }
+  return pos == dst_size;
+}
+
+/// @brief Decodes an LZ4 frame or, if src does not start with the frame magic
+/// number, a raw LZ4 block. A valid raw block can not start with the magic
+/// number since its first match would reference data before the output.
+static bool DecodeLZ4(const uint8_t* src, size_t src_size, uint8_t* dst,
+                      size_t dst_size) {
+  if (src_size >= 4) {
+    uint32_t magic = ReadLE32(src);
+    if (magic == kLZ4FrameMagic ||
+        (magic & 0xFFFFFFF0) == kLZ4SkippableMagic)
+      return DecodeLZ4Frames(src, src_size, dst, dst_size);
+  }
+  size_t pos = 0;
+  return DecodeLZ4Block(src, src_size, dst, pos, dst_size) && pos == dst_size;
+}
+
+bool IsCodecSupported(Codec codec) {
+  switch (codec) {
+    case kCodecNone:
+    case kCodecLZ4:
+    case kCodecDeltaR16:
+      return true;
+#if SUPPORT_ZSTD
+    case kCodecZstd:
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+bool Decompress(Codec codec, const void* src, size_t src_size, void* dst,
+                size_t dst_size) {
+  bool result = false;
+  switch (codec) {
+    case kCodecNone: {
+      result = src_size == dst_size;
+      if (result) memcpy(dst, src, dst_size);
+      break;
+    }
+    case kCodecLZ4: {
+      result =
+          DecodeLZ4((const uint8_t*)src, src_size, (uint8_t*)dst, dst_size);
+      break;
+    }
+    case kCodecDeltaR16: {
+      result = dst_size % sizeof(uint16_t) == 0 &&
+               DecodeDeltaR16(src, src_size, (uint16_t*)dst,
+                              dst_size / sizeof(uint16_t));
+      break;
+    }
+#if SUPPORT_ZSTD
+    case kCodecZstd: {
+      size_t size = ZSTD_decompress(dst, dst_size, src, src_size);
+      if (ZSTD_isError(size)) {
+        std::ostringstream ss;
+        ss << __FUNCTION__ << ": " << ZSTD_getErrorName(size);
+        UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+        return false;
+      }
+      result = size == dst_size;
+      break;
+    }
+#endif
+    default: {
+      std::ostringstream ss;
+      ss << __FUNCTION__ << ": codec " << codec
+         << " is not supported by this build";
+      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+      return false;
+    }
+  }
+  if (!result) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": payload of " << src_size << " bytes (codec "
+       << codec << ") is malformed or does not decompress to " << dst_size
+       << " bytes";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  }
+  return result;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Compression codec of a payload passed to
+/// EnqueueCompressedTextureSubImage3D.
+enum Codec {
+  kCodecNone = 0,     // uncompressed, copied as is
+  kCodecLZ4 = 1,      // LZ4 frame (.lz4 files) or raw LZ4 block
+  kCodecZstd = 2,     // Zstandard frame, requires a build with SUPPORT_ZSTD
+  kCodecDeltaR16 = 3  // lossless 16-bit brick codec, see DeltaCodec.h
+};
+
+/// @brief Whether payloads of the codec can be decompressed by this build.
+bool IsCodecSupported(Codec codec);
+
+/// @brief Decompresses a payload into exactly dst_size bytes. Thread-safe.
+/// @return false (and logs an error) if the codec is not supported or src is
+/// malformed or does not decompress to dst_size bytes
+bool Decompress(Codec codec, const void* src, size_t src_size, void* dst,
+                size_t dst_size);
@@ -0,0 +1,321 @@
+#include "DeltaCodec.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DELTA_CODEC_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define DELTA_CODEC_NEON 1
+#include <arm_neon.h>
+#endif
+
+/// @brief Maps residuals (interpreted as int16) to small unsigned values:
+/// 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+static inline uint16_t ZigZag(uint16_t residual) {
+  uint16_t sign = (residual & 0x8000) ? 0xFFFF : 0;
+  return (uint16_t)((residual << 1) ^ sign);
+}
+
+static inline uint16_t UnZigZag(uint16_t value) {
+  return (uint16_t)((value >> 1) ^ (0 - (value & 1)));
+}
+
+static inline size_t BlockCount(size_t texels) {
+  return (texels + kDeltaCodecBlockSize - 1) / kDeltaCodecBlockSize;
+}
+
+static inline size_t DataOffset(size_t blocks) {
+  return (sizeof(DeltaCodecHeader) + blocks + 15) & ~(size_t)15;
+}
+
+/// @brief Number of bits needed to store value.
+static inline uint32_t BitWidth(uint32_t value) {
+  uint32_t bits = 0;
+  for (; value != 0; value >>= 1) ++bits;
+  return bits;
+}
+
+/// @brief Differences a tightly packed box along x, y and z in place, which
+/// turns texels into their Lorenzo residuals.
+static void Difference(uint16_t* texels, int32_t width, int32_t height,
+                       int32_t depth) {
+  size_t row = (size_t)width, slice = (size_t)width * height;
+  for (size_t z = depth; z-- > 0;) {
+    for (size_t y = height; y-- > 0;) {
+      uint16_t* r = texels + z * slice + y * row;
+      for (size_t x = width; x-- > 1;) r[x] = (uint16_t)(r[x] - r[x - 1]);
+    }
+  }
+  for (size_t z = depth; z-- > 0;) {
+    for (size_t y = height; y-- > 1;) {
+      uint16_t* r = texels + z * slice + y * row;
+      for (size_t x = 0; x < row; ++x) r[x] = (uint16_t)(r[x] - r[x - row]);
+    }
+  }
+  for (size_t z = depth; z-- > 1;) {
+    uint16_t* s = texels + z * slice;
+    for (size_t i = 0; i < slice; ++i) s[i] = (uint16_t)(s[i] - s[i - slice]);
+  }
+}
+
+void EncodeDeltaR16(const uint16_t* texels, int32_t width, int32_t height,
+                    int32_t depth, std::vector<uint8_t>& encoded) {
+  size_t count = (size_t)width * height * depth;
+  std::vector<uint16_t> residuals(texels, texels + count);
+  Difference(&residuals[0], width, height, depth);
+
+  size_t blocks = BlockCount(count);
+  size_t data_offset = DataOffset(blocks);
+  encoded.assign(data_offset, 0);
+  DeltaCodecHeader header = {kDeltaCodecMagic, width, height, depth};
+  memcpy(&encoded[0], &header, sizeof(header));
+
+  uint16_t values[kDeltaCodecBlockSize];
+  uint16_t words[8 * 16];
+  for (size_t b = 0; b < blocks; ++b) {
+    size_t first = b * kDeltaCodecBlockSize;
+    uint32_t max = 0;
+    for (uint32_t j = 0; j < kDeltaCodecBlockSize; ++j) {
+      values[j] = first + j < count ? ZigZag(residuals[first + j]) : 0;
+      if (values[j] > max) max = values[j];
+    }
+    uint32_t bits = BitWidth(max);
+    encoded[sizeof(header) + b] = (uint8_t)bits;
+
+    for (uint32_t lane = 0; lane < 8; ++lane) {
+      uint32_t acc = 0, acc_bits = 0, word = 0;
+      for (uint32_t k = 0; k < 16; ++k) {
+        acc |= (uint32_t)values[8 * k + lane] << acc_bits;
+        for (acc_bits += bits; acc_bits >= 16; acc_bits -= 16) {
+          words[8 * word++ + lane] = (uint16_t)acc;
+          acc >>= 16;
+        }
+      }
+    }
+    const uint8_t* packed = (const uint8_t*)words;
+    encoded.insert(encoded.end(), packed, packed + 16 * bits);
+  }
+}
+
+bool ReadDeltaR16Header(const void* src, size_t src_size,
+                        DeltaCodecHeader& header, size_t& data_offset) {
+  if (src_size < sizeof(header)) return false;
+  memcpy(&header, src, sizeof(header));
+  if (header.magic != kDeltaCodecMagic || header.width <= 0 ||
+      header.height <= 0 || header.depth <= 0)
+    return false;
+
+  uint64_t count = (uint64_t)header.width * header.height * header.depth;
+  if (count > (uint64_t)(src_size - sizeof(header)) * kDeltaCodecBlockSize)
+    return false;
+  size_t blocks = BlockCount((size_t)count);
+  data_offset = DataOffset(blocks);
+  if (data_offset > src_size) return false;
+
+  const uint8_t* widths = (const uint8_t*)src + sizeof(header);
+  size_t size = data_offset;
+  for (size_t b = 0; b < blocks; ++b) {
+    if (widths[b] > 16) return false;
+    size += 16 * (size_t)widths[b];
+  }
+  return size == src_size;
+}
+
+/// @brief Unpacks (and unzigzags) the residuals of a block of kBits bits.
+/// The bit width is a template parameter so that the shifts of the unrolled
+/// loop are constants.
+template <uint32_t kBits>
+static void UnpackBlock(const uint8_t* packed,
+                        uint16_t values[kDeltaCodecBlockSize]) {
+  if (kBits == 0) {
+    memset(values, 0, kDeltaCodecBlockSize * sizeof(uint16_t));
+    return;
+  }
+  const uint16_t mask = (uint16_t)((1u << kBits) - 1);
+#if DELTA_CODEC_SSE2
+  const __m128i* words = (const __m128i*)packed;
+  __m128i vmask = _mm_set1_epi16((short)mask);
+  __m128i one = _mm_set1_epi16(1);
+  __m128i zero = _mm_setzero_si128();
+  for (uint32_t k = 0; k < 16; ++k) {
+    const uint32_t bit = k * kBits, word = bit >> 4, shift = bit & 15;
+    __m128i v = _mm_srli_epi16(_mm_loadu_si128(words + word), shift);
+    if (shift + kBits > 16) {
+      __m128i next = _mm_loadu_si128(words + word + 1);
+      v = _mm_or_si128(v, _mm_slli_epi16(next, 16 - shift));
+    }
+    v = _mm_and_si128(v, vmask);
+    v = _mm_xor_si128(_mm_srli_epi16(v, 1),
+                      _mm_sub_epi16(zero, _mm_and_si128(v, one)));
+    _mm_storeu_si128((__m128i*)(values + 8 * k), v);
+  }
+#elif DELTA_CODEC_NEON
+  const uint16_t* words = (const uint16_t*)packed;
+  uint16x8_t vmask = vdupq_n_u16(mask);
+  uint16x8_t one = vdupq_n_u16(1);
+  uint16x8_t zero = vdupq_n_u16(0);
+  for (uint32_t k = 0; k < 16; ++k) {
+    const uint32_t bit = k * kBits, word = bit >> 4, shift = bit & 15;
+    uint16x8_t v = vshlq_u16(vld1q_u16(words + 8 * word),
+                             vdupq_n_s16(-(int16_t)shift));
+    if (shift + kBits > 16) {
+      uint16x8_t next = vld1q_u16(words + 8 * (word + 1));
+      v = vorrq_u16(v, vshlq_u16(next, vdupq_n_s16((int16_t)(16 - shift))));
+    }
+    v = vandq_u16(v, vmask);
+    v = veorq_u16(vshrq_n_u16(v, 1), vsubq_u16(zero, vandq_u16(v, one)));
+    vst1q_u16(values + 8 * k, v);
+  }
+#else
+  uint16_t words[8 * 16];
+  memcpy(words, packed, 16 * kBits);
+  for (uint32_t lane = 0; lane < 8; ++lane) {
+    for (uint32_t k = 0; k < 16; ++k) {
+      const uint32_t bit = k * kBits, word = bit >> 4, shift = bit & 15;
+      uint32_t v = words[8 * word + lane] >> shift;
+      if (shift + kBits > 16)
+        v |= (uint32_t)words[8 * (word + 1) + lane] << (16 - shift);
+      values[8 * k + lane] = UnZigZag((uint16_t)(v & mask));
+    }
+  }
+#endif
+}
+
+typedef void (*UnpackBlockFunc)(const uint8_t*, uint16_t*);
+
+static const UnpackBlockFunc kUnpackBlock[17] = {
+    UnpackBlock<0>,  UnpackBlock<1>,  UnpackBlock<2>,  UnpackBlock<3>,
+    UnpackBlock<4>,  UnpackBlock<5>,  UnpackBlock<6>,  UnpackBlock<7>,
+    UnpackBlock<8>,  UnpackBlock<9>,  UnpackBlock<10>, UnpackBlock<11>,
+    UnpackBlock<12>, UnpackBlock<13>, UnpackBlock<14>, UnpackBlock<15>,
+    UnpackBlock<16>};
+
+/// @brief Prefix sum (modulo 2^16) of a row of texels, in place.
+static void PrefixSumRow(uint16_t* row, size_t count) {
+  size_t x = 0;
+#if DELTA_CODEC_SSE2
+  __m128i carry = _mm_setzero_si128();
+  for (; x + 8 <= count; x += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+    v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+    v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+    v = _mm_add_epi16(v, carry);
+    _mm_storeu_si128((__m128i*)(row + x), v);
+    // broadcast the last sum
+    carry = _mm_shufflehi_epi16(v, 0xFF);
+    carry = _mm_unpackhi_epi64(carry, carry);
+  }
+#elif DELTA_CODEC_NEON
+  uint16x8_t zero = vdupq_n_u16(0);
+  uint16x8_t carry = zero;
+  for (; x + 8 <= count; x += 8) {
+    uint16x8_t v = vld1q_u16(row + x);
+    v = vaddq_u16(v, vextq_u16(zero, v, 7));
+    v = vaddq_u16(v, vextq_u16(zero, v, 6));
+    v = vaddq_u16(v, vextq_u16(zero, v, 4));
+    v = vaddq_u16(v, carry);
+    vst1q_u16(row + x, v);
+    carry = vdupq_laneq_u16(v, 7);
+  }
+#endif
+  uint16_t sum = x > 0 ? row[x - 1] : 0;
+  for (; x < count; ++x) row[x] = sum = (uint16_t)(sum + row[x]);
+}
+
+/// @brief row[i] += up[i] + back[i] - back_up[i] (modulo 2^16), which adds
+/// the already integrated rows above (up), behind (back) and above behind
+/// (back_up) a row. Missing rows are passed as NULL.
+static void IntegrateRow(uint16_t* row, const uint16_t* up,
+                         const uint16_t* back, const uint16_t* back_up,
+                         size_t count) {
+  if (!up && !back) return;
+  size_t i = 0;
+#if DELTA_CODEC_SSE2
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+    if (up) v = _mm_add_epi16(v, _mm_loadu_si128((const __m128i*)(up + i)));
+    if (back) {
+      v = _mm_add_epi16(v, _mm_loadu_si128((const __m128i*)(back + i)));
+      if (back_up)
+        v = _mm_sub_epi16(v, _mm_loadu_si128((const __m128i*)(back_up + i)));
+    }
+    _mm_storeu_si128((__m128i*)(row + i), v);
+  }
+#elif DELTA_CODEC_NEON
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t v = vld1q_u16(row + i);
+    if (up) v = vaddq_u16(v, vld1q_u16(up + i));
+    if (back) {
+      v = vaddq_u16(v, vld1q_u16(back + i));
+      if (back_up) v = vsubq_u16(v, vld1q_u16(back_up + i));
+    }
+    vst1q_u16(row + i, v);
+  }
+#endif
+  for (; i < count; ++i) {
+    uint16_t v = row[i];
+    if (up) v = (uint16_t)(v + up[i]);
+    if (back) v = (uint16_t)(v + back[i] - (back_up ? back_up[i] : 0));
+    row[i] = v;
+  }
+}
+
+// number of blocks (16KB of texels) unpacked between two integration passes
+static const size_t kIntegrationBlocks = 64;
+
+/// @brief Integrates the unpacked residuals of rows first ... last - 1 (rows
+/// of all slices, in memory order) into texels. Rows before first have to be
+/// integrated already.
+static void IntegrateRows(uint16_t* texels, const DeltaCodecHeader& header,
+                          size_t first, size_t last) {
+  size_t row = (size_t)header.width;
+  size_t slice = row * header.height;
+  for (size_t i = first; i < last; ++i) {
+    bool y = i % header.height > 0, z = i >= (size_t)header.height;
+    uint16_t* r = texels + i * row;
+    // along x, then add the integrated neighbour rows (inclusion-exclusion
+    // along y and z)
+    PrefixSumRow(r, row);
+    IntegrateRow(r, y ? r - row : NULL, z ? r - slice : NULL,
+                 y && z ? r - row - slice : NULL, row);
+  }
+}
+
+bool DecodeDeltaR16(const void* src, size_t src_size, uint16_t* dst,
+                    size_t dst_count) {
+  DeltaCodecHeader header;
+  size_t data_offset;
+  if (!ReadDeltaR16Header(src, src_size, header, data_offset)) return false;
+  size_t row = (size_t)header.width;
+  size_t slice = row * header.height;
+  size_t count = slice * header.depth;
+  if (count != dst_count) return false;
+
+  const uint8_t* widths = (const uint8_t*)src + sizeof(header);
+  const uint8_t* packed = (const uint8_t*)src + data_offset;
+  size_t full_blocks = count / kDeltaCodecBlockSize;
+  size_t rows = 0;
+  for (size_t b = 0; b < full_blocks; ++b) {
+    kUnpackBlock[widths[b]](packed, dst + b * kDeltaCodecBlockSize);
+    packed += 16 * (size_t)widths[b];
+    // integrate the completely unpacked rows every few blocks, while they
+    // are still in cache
+    if ((b + 1) % kIntegrationBlocks == 0) {
+      size_t unpacked_rows = (b + 1) * kDeltaCodecBlockSize / row;
+      IntegrateRows(dst, header, rows, unpacked_rows);
+      rows = unpacked_rows;
+    }
+  }
+  size_t tail = count - full_blocks * kDeltaCodecBlockSize;
+  if (tail > 0) {
+    uint16_t values[kDeltaCodecBlockSize];
+    kUnpackBlock[widths[full_blocks]](packed, values);
+    memcpy(dst + full_blocks * kDeltaCodecBlockSize, values,
+           tail * sizeof(uint16_t));
+  }
+  IntegrateRows(dst, header, rows, (size_t)header.height * header.depth);
+  return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Lossless codec for R16 bricks (e.g., 12/16-bit CT or microscopy data).
+//
+// Every texel is predicted from its 7 already visited neighbours (3D Lorenzo
+// predictor, texels outside the brick count as 0), so the residuals are the
+// texels differenced along x, y and z (modulo 2^16). The residuals are zigzag
+// encoded and bit-packed in blocks of 128 (in texel order) with one bit width
+// per block. Decoding unpacks the residuals and runs prefix sums along x, y
+// and z, all of which vectorize.
+//
+// Within a block the residuals are interleaved over 8 lanes of 16-bit words:
+// residual j belongs to lane j % 8, where it is the (j / 8)-th value of the
+// lane's bit stream (LSB first). Word w of lane l is stored at word 8 * w + l,
+// so a block of bit width b takes 8 * b words (16 residuals of b bits per
+// lane) and the 8 residuals 8k ... 8k+7 are unpacked with the same shifts from
+// at most two vectors of words.
+//
+// Layout of an encoded brick (little endian):
+//   DeltaCodecHeader
+//   bit width (0 ... 16) of every block, one byte each
+//   zero padding to a multiple of 16 bytes
+//   packed blocks, 16 * bit width bytes each
+
+static const uint32_t kDeltaCodecMagic = 0x4C363152;  // "R16L"
+static const uint32_t kDeltaCodecBlockSize = 128;
+
+struct DeltaCodecHeader {
+  uint32_t magic;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+};
+
+/// @brief Encodes a tightly packed box of R16 texels.
+/// @param encoded receives the encoded brick (replacing its content)
+void EncodeDeltaR16(const uint16_t* texels, int32_t width, int32_t height,
+                    int32_t depth, std::vector<uint8_t>& encoded);
+
+/// @brief Validates the header and bit widths of an encoded brick.
+/// @param data_offset receives the offset of the packed blocks
+/// @return false if src is not a complete encoded brick
+bool ReadDeltaR16Header(const void* src, size_t src_size,
+                        DeltaCodecHeader& header, size_t& data_offset);
+
+/// @brief Decodes an encoded brick into tightly packed R16 texels. Uses
+/// SSE2/NEON where available.
+/// @param dst_count number of texels dst can hold, has to equal the number of
+/// texels of the brick
+/// @return false if src is malformed or does not hold dst_count texels
+bool DecodeDeltaR16(const void* src, size_t src_size, uint16_t* dst,
+                    size_t dst_count);
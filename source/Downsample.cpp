@@ -0,0 +1,396 @@
+#include "Downsample.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DOWNSAMPLE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define DOWNSAMPLE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Every output row is the average of 2x2 input rows (clamped to the box) and
+// of the pairs of texels 2x and 2x + 1 within them. The kernels compute the
+// outputs whose both texels exist (x < width / 2) and return the number of
+// outputs they computed, the scalar kernels handle the rest.
+
+template <typename T>
+static inline uint32_t PairSum(const T* row, int32_t x0, int32_t x1) {
+  return (uint32_t)row[x0] + (uint32_t)row[x1];
+}
+
+/// @brief Scalar kernel for outputs [first, count) of an unsigned format.
+template <typename T>
+static void DownsampleRowScalar(const T* const rows[4], int32_t width,
+                                T* dst, int32_t first, int32_t count) {
+  for (int32_t x = first; x < count; ++x) {
+    int32_t x0 = 2 * x, x1 = x0 + 1 < width ? x0 + 1 : x0;
+    uint32_t sum = PairSum(rows[0], x0, x1) + PairSum(rows[1], x0, x1) +
+                   PairSum(rows[2], x0, x1) + PairSum(rows[3], x0, x1);
+    dst[x] = (T)((sum + 4) >> 3);
+  }
+}
+
+static void DownsampleRowFloat(const float* const rows[4], int32_t width,
+                               float* dst, int32_t count) {
+  for (int32_t x = 0; x < count; ++x) {
+    int32_t x0 = 2 * x, x1 = x0 + 1 < width ? x0 + 1 : x0;
+    float sum = 0.0f;
+    for (int i = 0; i < 4; ++i) sum += rows[i][x0] + rows[i][x1];
+    dst[x] = sum * 0.125f;
+  }
+}
+
+/// @brief Scalar kernel for the maxima (or minima) of outputs [first, count).
+template <typename T>
+static void DownsampleRowExtremeScalar(const T* const rows[4], int32_t width,
+                                       T* dst, int32_t first, int32_t count,
+                                       bool maximum) {
+  for (int32_t x = first; x < count; ++x) {
+    int32_t x0 = 2 * x, x1 = x0 + 1 < width ? x0 + 1 : x0;
+    T extreme = rows[0][x0];
+    for (int i = 0; i < 4; ++i) {
+      T a = rows[i][x0], b = rows[i][x1];
+      if (maximum) {
+        extreme = a > extreme ? a : extreme;
+        extreme = b > extreme ? b : extreme;
+      } else {
+        extreme = a < extreme ? a : extreme;
+        extreme = b < extreme ? b : extreme;
+      }
+    }
+    dst[x] = extreme;
+  }
+}
+
+#if DOWNSAMPLE_SSE2
+/// @brief Sums the pairs of 8-bit texels of 16 bytes into 8 16-bit lanes.
+static inline __m128i PairSums8(const uint8_t* p) {
+  __m128i v = _mm_loadu_si128((const __m128i*)p);
+  return _mm_add_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)),
+                       _mm_srli_epi16(v, 8));
+}
+
+/// @brief Sums the pairs of 16-bit texels of 16 bytes into 4 32-bit lanes.
+static inline __m128i PairSums16(const uint16_t* p) {
+  __m128i v = _mm_loadu_si128((const __m128i*)p);
+  return _mm_add_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)),
+                       _mm_srli_epi32(v, 16));
+}
+
+static int32_t DownsampleRowVector(const uint8_t* const rows[4],
+                                   uint8_t* dst, int32_t count) {
+  const __m128i round = _mm_set1_epi16(4);
+  int32_t x = 0;
+  for (; x + 16 <= count; x += 16) {
+    __m128i s[2];
+    for (int h = 0; h < 2; ++h) {
+      int32_t i = 2 * x + 16 * h;
+      s[h] = _mm_add_epi16(_mm_add_epi16(PairSums8(rows[0] + i),
+                                         PairSums8(rows[1] + i)),
+                           _mm_add_epi16(PairSums8(rows[2] + i),
+                                         PairSums8(rows[3] + i)));
+      s[h] = _mm_srli_epi16(_mm_add_epi16(s[h], round), 3);
+    }
+    _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(s[0], s[1]));
+  }
+  return x;
+}
+
+static int32_t DownsampleRowVector(const uint16_t* const rows[4],
+                                   uint16_t* dst, int32_t count) {
+  const __m128i round = _mm_set1_epi32(4);
+  const __m128i bias32 = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+  int32_t x = 0;
+  for (; x + 8 <= count; x += 8) {
+    __m128i s[2];
+    for (int h = 0; h < 2; ++h) {
+      int32_t i = 2 * x + 8 * h;
+      s[h] = _mm_add_epi32(_mm_add_epi32(PairSums16(rows[0] + i),
+                                         PairSums16(rows[1] + i)),
+                           _mm_add_epi32(PairSums16(rows[2] + i),
+                                         PairSums16(rows[3] + i)));
+      // averages are at most 65535: bias them into the int16 range to pack
+      s[h] = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(s[h], round), 3),
+                           bias32);
+    }
+    __m128i packed = _mm_xor_si128(_mm_packs_epi32(s[0], s[1]), bias16);
+    _mm_storeu_si128((__m128i*)(dst + x), packed);
+  }
+  return x;
+}
+
+static inline __m128i Extreme8(__m128i a, __m128i b, bool maximum) {
+  return maximum ? _mm_max_epu8(a, b) : _mm_min_epu8(a, b);
+}
+
+/// @brief Unsigned 16-bit maximum (minimum) with SSE2 saturating arithmetic.
+static inline __m128i Extreme16(__m128i a, __m128i b, bool maximum) {
+  return maximum ? _mm_add_epi16(a, _mm_subs_epu16(b, a))
+                 : _mm_sub_epi16(a, _mm_subs_epu16(a, b));
+}
+
+static int32_t DownsampleRowExtremeVector(const uint8_t* const rows[4],
+                                          uint8_t* dst, int32_t count,
+                                          bool maximum) {
+  const __m128i low = _mm_set1_epi16(0x00FF);
+  int32_t x = 0;
+  for (; x + 16 <= count; x += 16) {
+    __m128i e[2];
+    for (int h = 0; h < 2; ++h) {
+      int32_t i = 2 * x + 16 * h;
+      e[h] = _mm_loadu_si128((const __m128i*)(rows[0] + i));
+      for (int r = 1; r < 4; ++r) {
+        e[h] = Extreme8(e[h], _mm_loadu_si128((const __m128i*)(rows[r] + i)),
+                        maximum);
+      }
+      // the low byte of every 16-bit lane receives the extreme of its pair
+      e[h] = _mm_and_si128(Extreme8(e[h], _mm_srli_epi16(e[h], 8), maximum),
+                           low);
+    }
+    _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(e[0], e[1]));
+  }
+  return x;
+}
+
+static int32_t DownsampleRowExtremeVector(const uint16_t* const rows[4],
+                                          uint16_t* dst, int32_t count,
+                                          bool maximum) {
+  const __m128i low = _mm_set1_epi32(0xFFFF);
+  const __m128i bias32 = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+  int32_t x = 0;
+  for (; x + 8 <= count; x += 8) {
+    __m128i e[2];
+    for (int h = 0; h < 2; ++h) {
+      int32_t i = 2 * x + 8 * h;
+      e[h] = _mm_loadu_si128((const __m128i*)(rows[0] + i));
+      for (int r = 1; r < 4; ++r) {
+        e[h] = Extreme16(e[h],
+                         _mm_loadu_si128((const __m128i*)(rows[r] + i)),
+                         maximum);
+      }
+      e[h] = _mm_and_si128(Extreme16(e[h], _mm_srli_epi32(e[h], 16), maximum),
+                           low);
+      e[h] = _mm_sub_epi32(e[h], bias32);
+    }
+    __m128i packed = _mm_xor_si128(_mm_packs_epi32(e[0], e[1]), bias16);
+    _mm_storeu_si128((__m128i*)(dst + x), packed);
+  }
+  return x;
+}
+#elif DOWNSAMPLE_NEON
+static int32_t DownsampleRowVector(const uint8_t* const rows[4],
+                                   uint8_t* dst, int32_t count) {
+  int32_t x = 0;
+  for (; x + 8 <= count; x += 8) {
+    uint16x8_t s = vpaddlq_u8(vld1q_u8(rows[0] + 2 * x));
+    for (int i = 1; i < 4; ++i) s = vpadalq_u8(s, vld1q_u8(rows[i] + 2 * x));
+    vst1_u8(dst + x, vrshrn_n_u16(s, 3));
+  }
+  return x;
+}
+
+static int32_t DownsampleRowVector(const uint16_t* const rows[4],
+                                   uint16_t* dst, int32_t count) {
+  int32_t x = 0;
+  for (; x + 4 <= count; x += 4) {
+    uint32x4_t s = vpaddlq_u16(vld1q_u16(rows[0] + 2 * x));
+    for (int i = 1; i < 4; ++i) s = vpadalq_u16(s, vld1q_u16(rows[i] + 2 * x));
+    vst1_u16(dst + x, vrshrn_n_u32(s, 3));
+  }
+  return x;
+}
+
+static int32_t DownsampleRowExtremeVector(const uint8_t* const rows[4],
+                                          uint8_t* dst, int32_t count,
+                                          bool maximum) {
+  int32_t x = 0;
+  for (; x + 8 <= count; x += 8) {
+    uint8x16_t e = vld1q_u8(rows[0] + 2 * x);
+    for (int i = 1; i < 4; ++i) {
+      uint8x16_t v = vld1q_u8(rows[i] + 2 * x);
+      e = maximum ? vmaxq_u8(e, v) : vminq_u8(e, v);
+    }
+    // pairwise extremes of adjacent texels
+    vst1_u8(dst + x, maximum ? vpmax_u8(vget_low_u8(e), vget_high_u8(e))
+                             : vpmin_u8(vget_low_u8(e), vget_high_u8(e)));
+  }
+  return x;
+}
+
+static int32_t DownsampleRowExtremeVector(const uint16_t* const rows[4],
+                                          uint16_t* dst, int32_t count,
+                                          bool maximum) {
+  int32_t x = 0;
+  for (; x + 4 <= count; x += 4) {
+    uint16x8_t e = vld1q_u16(rows[0] + 2 * x);
+    for (int i = 1; i < 4; ++i) {
+      uint16x8_t v = vld1q_u16(rows[i] + 2 * x);
+      e = maximum ? vmaxq_u16(e, v) : vminq_u16(e, v);
+    }
+    vst1_u16(dst + x, maximum ? vpmax_u16(vget_low_u16(e), vget_high_u16(e))
+                              : vpmin_u16(vget_low_u16(e), vget_high_u16(e)));
+  }
+  return x;
+}
+#else
+static int32_t DownsampleRowVector(const uint8_t* const rows[4],
+                                   uint8_t* dst, int32_t count) {
+  return 0;
+}
+
+static int32_t DownsampleRowVector(const uint16_t* const rows[4],
+                                   uint16_t* dst, int32_t count) {
+  return 0;
+}
+
+static int32_t DownsampleRowExtremeVector(const uint8_t* const rows[4],
+                                          uint8_t* dst, int32_t count,
+                                          bool maximum) {
+  return 0;
+}
+
+static int32_t DownsampleRowExtremeVector(const uint16_t* const rows[4],
+                                          uint16_t* dst, int32_t count,
+                                          bool maximum) {
+  return 0;
+}
+#endif
+
+// 32-bit texels have no vector kernel
+static int32_t DownsampleRowExtremeVector(const uint32_t* const rows[4],
+                                          uint32_t* dst, int32_t count,
+                                          bool maximum) {
+  return 0;
+}
+
+static int32_t DownsampleRowExtremeVector(const float* const rows[4],
+                                          float* dst, int32_t count,
+                                          bool maximum) {
+  return 0;
+}
+
+template <typename T>
+static void DownsampleSlices(const T* src, int32_t width, int32_t height,
+                             int32_t depth, T* dst, int32_t first_slice,
+                             int32_t slice_count) {
+  int32_t dst_width = DownsampledExtent(width);
+  int32_t dst_height = DownsampledExtent(height);
+  size_t row = (size_t)width, slice = (size_t)width * height;
+  for (int32_t z = first_slice; z < first_slice + slice_count; ++z) {
+    int32_t z0 = 2 * z, z1 = z0 + 1 < depth ? z0 + 1 : z0;
+    for (int32_t y = 0; y < dst_height; ++y) {
+      int32_t y0 = 2 * y, y1 = y0 + 1 < height ? y0 + 1 : y0;
+      const T* rows[4] = {src + z0 * slice + y0 * row,
+                          src + z0 * slice + y1 * row,
+                          src + z1 * slice + y0 * row,
+                          src + z1 * slice + y1 * row};
+      T* out = dst + ((size_t)z * dst_height + y) * dst_width;
+      int32_t x = DownsampleRowVector(rows, out, width / 2);
+      DownsampleRowScalar(rows, width, out, x, dst_width);
+    }
+  }
+}
+
+static void DownsampleSlicesFloat(const float* src, int32_t width,
+                                  int32_t height, int32_t depth, float* dst,
+                                  int32_t first_slice, int32_t slice_count) {
+  int32_t dst_width = DownsampledExtent(width);
+  int32_t dst_height = DownsampledExtent(height);
+  size_t row = (size_t)width, slice = (size_t)width * height;
+  for (int32_t z = first_slice; z < first_slice + slice_count; ++z) {
+    int32_t z0 = 2 * z, z1 = z0 + 1 < depth ? z0 + 1 : z0;
+    for (int32_t y = 0; y < dst_height; ++y) {
+      int32_t y0 = 2 * y, y1 = y0 + 1 < height ? y0 + 1 : y0;
+      const float* rows[4] = {src + z0 * slice + y0 * row,
+                              src + z0 * slice + y1 * row,
+                              src + z1 * slice + y0 * row,
+                              src + z1 * slice + y1 * row};
+      DownsampleRowFloat(rows, width,
+                         dst + ((size_t)z * dst_height + y) * dst_width,
+                         dst_width);
+    }
+  }
+}
+
+template <typename T>
+static void DownsampleSlicesExtreme(const T* src, int32_t width,
+                                    int32_t height, int32_t depth, T* dst,
+                                    int32_t first_slice, int32_t slice_count,
+                                    bool maximum) {
+  int32_t dst_width = DownsampledExtent(width);
+  int32_t dst_height = DownsampledExtent(height);
+  size_t row = (size_t)width, slice = (size_t)width * height;
+  for (int32_t z = first_slice; z < first_slice + slice_count; ++z) {
+    int32_t z0 = 2 * z, z1 = z0 + 1 < depth ? z0 + 1 : z0;
+    for (int32_t y = 0; y < dst_height; ++y) {
+      int32_t y0 = 2 * y, y1 = y0 + 1 < height ? y0 + 1 : y0;
+      const T* rows[4] = {src + z0 * slice + y0 * row,
+                          src + z0 * slice + y1 * row,
+                          src + z1 * slice + y0 * row,
+                          src + z1 * slice + y1 * row};
+      T* out = dst + ((size_t)z * dst_height + y) * dst_width;
+      int32_t x = DownsampleRowExtremeVector(rows, out, width / 2, maximum);
+      DownsampleRowExtremeScalar(rows, width, out, x, dst_width, maximum);
+    }
+  }
+}
+
+bool IsDownsamplingSupported(Format format, DownsampleFilter filter) {
+  if (filter == kDownsampleAverage)
+    return format == R8_UINT || format == R16_UINT || format == R32F;
+  return (filter == kDownsampleMax || filter == kDownsampleMin) &&
+         (format == R8_UINT || format == R16_UINT || format == R16UI ||
+          format == R32UI || format == R32F);
+}
+
+bool Downsample2x(const void* src, int32_t width, int32_t height,
+                  int32_t depth, Format format, void* dst,
+                  int32_t first_slice, int32_t slice_count,
+                  DownsampleFilter filter) {
+  if (!IsDownsamplingSupported(format, filter)) return false;
+  if (filter != kDownsampleAverage) {
+    bool maximum = filter == kDownsampleMax;
+    switch (format) {
+      case R8_UINT:
+        DownsampleSlicesExtreme((const uint8_t*)src, width, height, depth,
+                                (uint8_t*)dst, first_slice, slice_count,
+                                maximum);
+        return true;
+      case R16_UINT:
+      case R16UI:
+        DownsampleSlicesExtreme((const uint16_t*)src, width, height, depth,
+                                (uint16_t*)dst, first_slice, slice_count,
+                                maximum);
+        return true;
+      case R32UI:
+        DownsampleSlicesExtreme((const uint32_t*)src, width, height, depth,
+                                (uint32_t*)dst, first_slice, slice_count,
+                                maximum);
+        return true;
+      default:
+        DownsampleSlicesExtreme((const float*)src, width, height, depth,
+                                (float*)dst, first_slice, slice_count,
+                                maximum);
+        return true;
+    }
+  }
+  switch (format) {
+    case R8_UINT:
+      DownsampleSlices((const uint8_t*)src, width, height, depth,
+                       (uint8_t*)dst, first_slice, slice_count);
+      return true;
+    case R16_UINT:
+      DownsampleSlices((const uint16_t*)src, width, height, depth,
+                       (uint16_t*)dst, first_slice, slice_count);
+      return true;
+    case R32F:
+      DownsampleSlicesFloat((const float*)src, width, height, depth,
+                            (float*)dst, first_slice, slice_count);
+      return true;
+    default:
+      return false;
+  }
+}
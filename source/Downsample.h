@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Formats.h"
+
+/// @brief Extent of the next coarser resolution level: ceil(extent / 2).
+inline int32_t DownsampledExtent(int32_t extent) { return (extent + 1) / 2; }
+
+/// @brief How the 2x2x2 texels of a parent texel are combined.
+enum DownsampleFilter {
+  kDownsampleAverage = 0,  // rounded average, for intensities
+  kDownsampleMax = 1,      // maximum, e.g., for labels or empty-space maps
+  kDownsampleMin = 2       // minimum
+};
+
+/// @brief Whether Downsample2x supports the format with the filter.
+bool IsDownsamplingSupported(Format format,
+                             DownsampleFilter filter = kDownsampleAverage);
+
+/// @brief Halves a tightly packed box along every axis with a 2x2x2 filter.
+/// Odd extents repeat their last texel. Uses SSE2/NEON where available.
+/// Averages support R8_UINT, R16_UINT and R32F; averaging integer label
+/// volumes would not be meaningful. Maxima and minima also support R16UI and
+/// R32UI.
+/// @param dst receives DownsampledExtent(width) x DownsampledExtent(height) x
+/// DownsampledExtent(depth) tightly packed texels
+/// @param first_slice first output slice to compute, so that several threads
+/// can share the work
+/// @param slice_count number of output slices to compute
+/// @return false if the format is not supported
+bool Downsample2x(const void* src, int32_t width, int32_t height,
+                  int32_t depth, Format format, void* dst,
+                  int32_t first_slice, int32_t slice_count,
+                  DownsampleFilter filter = kDownsampleAverage);
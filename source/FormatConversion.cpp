@@ -0,0 +1,541 @@
+#include "FormatConversion.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define CONVERSION_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONVERSION_SSE2 1
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CONVERSION_NEON 1
+#include <arm_neon.h>
+#endif
+
+// AVX2/F16C kernels are compiled for their instruction set regardless of the
+// compiler flags and only called if the CPU supports it
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CONVERSION_TARGET(isa)
+#else
+#define CONVERSION_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// offsets outside this range map every int16 to 0 or 65535 anyway, clamping
+// them keeps the 32-bit sums from overflowing
+static const int32_t kMaxOffset = 1 << 17;
+
+static int32_t ClampOffset(int32_t offset) {
+  return offset < -kMaxOffset ? -kMaxOffset
+                              : (offset > kMaxOffset ? kMaxOffset : offset);
+}
+
+/// @brief Scale and bias mapping [low, high] onto [0, 255].
+static void WindowScaleBias(uint16_t low, uint16_t high, float& scale,
+                            float& bias) {
+  float range = high > low ? (float)(high - low) : 1.0f;
+  scale = 255.0f / range;
+  bias = -(float)low * scale;
+}
+
+//
+// Scalar kernels, also used for the tails of the SIMD kernels
+//
+
+static void Int16ToUInt16Scalar(const int16_t* src, uint16_t* dst,
+                                size_t count, int32_t offset) {
+  for (size_t i = 0; i < count; ++i) {
+    int32_t v = (int32_t)src[i] + offset;
+    dst[i] = (uint16_t)(v < 0 ? 0 : (v > 65535 ? 65535 : v));
+  }
+}
+
+static void WindowScalar(const uint16_t* src, uint8_t* dst, size_t count,
+                         float scale, float bias) {
+  for (size_t i = 0; i < count; ++i) {
+    float v = (float)src[i] * scale + bias;
+    dst[i] = (uint8_t)(v <= 0.0f ? 0 : (v >= 255.0f ? 255 : lrintf(v)));
+  }
+}
+
+static uint16_t FloatToHalf(float value) {
+  uint32_t f;
+  memcpy(&f, &value, sizeof(f));
+  uint32_t sign = (f >> 16) & 0x8000;
+  uint32_t abs = f & 0x7FFFFFFF;
+
+  // infinity and NaN (quieted, keeping the upper payload bits)
+  if (abs >= 0x7F800000)
+    return (uint16_t)(sign | 0x7C00 |
+                      (abs > 0x7F800000 ? 0x200 | ((abs >> 13) & 0x3FF) : 0));
+  // at least 65520 rounds to infinity
+  if (abs >= 0x477FF000) return (uint16_t)(sign | 0x7C00);
+
+  uint32_t half, remainder, halfway;
+  if (abs < 0x38800000) {
+    // subnormal half, at most 2^-25 rounds to zero
+    if (abs <= 0x33000000) return (uint16_t)sign;
+    uint32_t mantissa = (abs & 0x7FFFFF) | 0x800000;
+    uint32_t shift = 126 - (abs >> 23);
+    half = mantissa >> shift;
+    remainder = mantissa & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  } else {
+    // rebias the exponent from 127 to 15, a carry of the rounding into the
+    // exponent is intended
+    half = (abs - 0x38000000) >> 13;
+    remainder = abs & 0x1FFF;
+    halfway = 0x1000;
+  }
+  if (remainder > halfway || (remainder == halfway && (half & 1))) ++half;
+  return (uint16_t)(sign | half);
+}
+
+static void Float32ToFloat16Scalar(const float* src, uint16_t* dst,
+                                   size_t count) {
+  for (size_t i = 0; i < count; ++i) dst[i] = FloatToHalf(src[i]);
+}
+
+static void UInt32ToUInt16Scalar(const uint32_t* src, uint16_t* dst,
+                                 size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = (uint16_t)(src[i] > 65535 ? 65535 : src[i]);
+}
+
+static void ByteSwap16Scalar(const uint8_t* src, uint8_t* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    uint16_t v;
+    memcpy(&v, src + 2 * i, sizeof(v));
+    v = (uint16_t)((v << 8) | (v >> 8));
+    memcpy(dst + 2 * i, &v, sizeof(v));
+  }
+}
+
+static void ByteSwap32Scalar(const uint8_t* src, uint8_t* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t v;
+    memcpy(&v, src + 4 * i, sizeof(v));
+    v = (v << 24) | ((v << 8) & 0xFF0000) | ((v >> 8) & 0xFF00) | (v >> 24);
+    memcpy(dst + 4 * i, &v, sizeof(v));
+  }
+}
+
+//
+// SSE2 kernels
+//
+
+#if CONVERSION_SSE2
+static void Int16ToUInt16SSE2(const int16_t* src, uint16_t* dst, size_t count,
+                              int32_t offset) {
+  // widen to 32 bits, shift by -32768 so that the signed saturation of
+  // packs_epi32 clamps to [0, 65535] and flip the sign bit back
+  __m128i bias = _mm_set1_epi32(offset - 32768);
+  __m128i flip = _mm_set1_epi16((short)0x8000);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    lo = _mm_add_epi32(lo, bias);
+    hi = _mm_add_epi32(hi, bias);
+    __m128i r = _mm_xor_si128(_mm_packs_epi32(lo, hi), flip);
+    _mm_storeu_si128((__m128i*)(dst + i), r);
+  }
+  Int16ToUInt16Scalar(src + i, dst + i, count - i, offset);
+}
+
+/// @brief Windows 8 R16 texels into 8 int16 values (saturated to int16).
+static inline __m128i Window8SSE2(__m128i v, __m128 scale, __m128 bias) {
+  __m128i zero = _mm_setzero_si128();
+  __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+  __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+  lo = _mm_add_ps(_mm_mul_ps(lo, scale), bias);
+  hi = _mm_add_ps(_mm_mul_ps(hi, scale), bias);
+  return _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+}
+
+static void WindowSSE2(const uint16_t* src, uint8_t* dst, size_t count,
+                       float scale, float bias) {
+  __m128 vscale = _mm_set1_ps(scale);
+  __m128 vbias = _mm_set1_ps(bias);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 8));
+    __m128i r = _mm_packus_epi16(Window8SSE2(a, vscale, vbias),
+                                 Window8SSE2(b, vscale, vbias));
+    _mm_storeu_si128((__m128i*)(dst + i), r);
+  }
+  WindowScalar(src + i, dst + i, count - i, scale, bias);
+}
+
+static void UInt32ToUInt16SSE2(const uint32_t* src, uint16_t* dst,
+                               size_t count) {
+  // SSE2 has neither unsigned 32-bit compares nor packus_epi32: saturate
+  // through a signed compare of the sign-flipped values, then pack like
+  // Int16ToUInt16SSE2
+  __m128i sign = _mm_set1_epi32((int)0x80000000);
+  __m128i limit = _mm_set1_epi32((int)(0x80000000 | 0xFFFF));
+  __m128i max = _mm_set1_epi32(0xFFFF);
+  __m128i bias = _mm_set1_epi32(32768);
+  __m128i flip = _mm_set1_epi16((short)0x8000);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v[2];
+    for (int h = 0; h < 2; ++h) {
+      __m128i x = _mm_loadu_si128((const __m128i*)(src + i + 4 * h));
+      __m128i over = _mm_cmpgt_epi32(_mm_xor_si128(x, sign), limit);
+      x = _mm_or_si128(_mm_andnot_si128(over, x), _mm_and_si128(over, max));
+      v[h] = _mm_sub_epi32(x, bias);
+    }
+    __m128i r = _mm_xor_si128(_mm_packs_epi32(v[0], v[1]), flip);
+    _mm_storeu_si128((__m128i*)(dst + i), r);
+  }
+  UInt32ToUInt16Scalar(src + i, dst + i, count - i);
+}
+
+static void ByteSwap16SSE2(const uint8_t* src, uint8_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128((__m128i*)(dst + 2 * i), v);
+  }
+  ByteSwap16Scalar(src + 2 * i, dst + 2 * i, count - i);
+}
+
+static void ByteSwap32SSE2(const uint8_t* src, uint8_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    // swap the bytes of both 16-bit halves, then swap the halves
+    __m128i v = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16));
+    _mm_storeu_si128((__m128i*)(dst + 4 * i), v);
+  }
+  ByteSwap32Scalar(src + 4 * i, dst + 4 * i, count - i);
+}
+#endif
+
+//
+// AVX2 and F16C kernels. 256-bit unpack/pack instructions operate on each
+// 128-bit lane separately: unpacking and packing back restores the order,
+// packing two vectors interleaves their lanes which a permute undoes.
+//
+
+#if CONVERSION_X86
+CONVERSION_TARGET("avx2")
+static void Int16ToUInt16AVX2(const int16_t* src, uint16_t* dst, size_t count,
+                              int32_t offset) {
+  __m256i bias = _mm256_set1_epi32(offset - 32768);
+  __m256i flip = _mm256_set1_epi16((short)0x8000);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i lo = _mm256_srai_epi32(_mm256_unpacklo_epi16(v, v), 16);
+    __m256i hi = _mm256_srai_epi32(_mm256_unpackhi_epi16(v, v), 16);
+    lo = _mm256_add_epi32(lo, bias);
+    hi = _mm256_add_epi32(hi, bias);
+    __m256i r = _mm256_xor_si256(_mm256_packs_epi32(lo, hi), flip);
+    _mm256_storeu_si256((__m256i*)(dst + i), r);
+  }
+  Int16ToUInt16Scalar(src + i, dst + i, count - i, offset);
+}
+
+CONVERSION_TARGET("avx2")
+static inline __m256i Window16AVX2(__m256i v, __m256 scale, __m256 bias) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256 lo = _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(v, zero));
+  __m256 hi = _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(v, zero));
+  lo = _mm256_add_ps(_mm256_mul_ps(lo, scale), bias);
+  hi = _mm256_add_ps(_mm256_mul_ps(hi, scale), bias);
+  return _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+}
+
+CONVERSION_TARGET("avx2")
+static void WindowAVX2(const uint16_t* src, uint8_t* dst, size_t count,
+                       float scale, float bias) {
+  __m256 vscale = _mm256_set1_ps(scale);
+  __m256 vbias = _mm256_set1_ps(bias);
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+    __m256i r = _mm256_packus_epi16(Window16AVX2(a, vscale, vbias),
+                                    Window16AVX2(b, vscale, vbias));
+    r = _mm256_permute4x64_epi64(r, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i*)(dst + i), r);
+  }
+  WindowScalar(src + i, dst + i, count - i, scale, bias);
+}
+
+CONVERSION_TARGET("avx2")
+static void UInt32ToUInt16AVX2(const uint32_t* src, uint16_t* dst,
+                               size_t count) {
+  __m256i max = _mm256_set1_epi32(0xFFFF);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+    __m256i r = _mm256_packus_epi32(_mm256_min_epu32(a, max),
+                                    _mm256_min_epu32(b, max));
+    r = _mm256_permute4x64_epi64(r, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i*)(dst + i), r);
+  }
+  UInt32ToUInt16Scalar(src + i, dst + i, count - i);
+}
+
+CONVERSION_TARGET("avx2")
+static void ByteSwap16AVX2(const uint8_t* src, uint8_t* dst, size_t count) {
+  __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13,
+                                  12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8,
+                                  11, 10, 13, 12, 15, 14);
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(src + 2 * i));
+    _mm256_storeu_si256((__m256i*)(dst + 2 * i), _mm256_shuffle_epi8(v, mask));
+  }
+  ByteSwap16Scalar(src + 2 * i, dst + 2 * i, count - i);
+}
+
+CONVERSION_TARGET("avx2")
+static void ByteSwap32AVX2(const uint8_t* src, uint8_t* dst, size_t count) {
+  __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15,
+                                  14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10,
+                                  9, 8, 15, 14, 13, 12);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(src + 4 * i));
+    _mm256_storeu_si256((__m256i*)(dst + 4 * i), _mm256_shuffle_epi8(v, mask));
+  }
+  ByteSwap32Scalar(src + 4 * i, dst + 4 * i, count - i);
+}
+
+CONVERSION_TARGET("avx,f16c")
+static void Float32ToFloat16F16C(const float* src, uint16_t* dst,
+                                 size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i r = _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128((__m128i*)(dst + i), r);
+  }
+  Float32ToFloat16Scalar(src + i, dst + i, count - i);
+}
+#endif
+
+//
+// AArch64 NEON kernels
+//
+
+#if CONVERSION_NEON
+static void Int16ToUInt16NEON(const int16_t* src, uint16_t* dst, size_t count,
+                              int32_t offset) {
+  int32x4_t bias = vdupq_n_s32(offset);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t v = vld1q_s16(src + i);
+    int32x4_t lo = vaddq_s32(vmovl_s16(vget_low_s16(v)), bias);
+    int32x4_t hi = vaddq_s32(vmovl_s16(vget_high_s16(v)), bias);
+    vst1q_u16(dst + i, vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi)));
+  }
+  Int16ToUInt16Scalar(src + i, dst + i, count - i, offset);
+}
+
+static void WindowNEON(const uint16_t* src, uint8_t* dst, size_t count,
+                       float scale, float bias) {
+  float32x4_t vscale = vdupq_n_f32(scale);
+  float32x4_t vbias = vdupq_n_f32(bias);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t v = vld1q_u16(src + i);
+    float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));
+    float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(v)));
+    lo = vaddq_f32(vmulq_f32(lo, vscale), vbias);
+    hi = vaddq_f32(vmulq_f32(hi, vscale), vbias);
+    int16x8_t r = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(lo)),
+                               vqmovn_s32(vcvtnq_s32_f32(hi)));
+    vst1_u8(dst + i, vqmovun_s16(r));
+  }
+  WindowScalar(src + i, dst + i, count - i, scale, bias);
+}
+
+static void Float32ToFloat16NEON(const float* src, uint16_t* dst,
+                                 size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    float16x4_t r = vcvt_f16_f32(vld1q_f32(src + i));
+    vst1_u16(dst + i, vreinterpret_u16_f16(r));
+  }
+  Float32ToFloat16Scalar(src + i, dst + i, count - i);
+}
+
+static void UInt32ToUInt16NEON(const uint32_t* src, uint16_t* dst,
+                               size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint16x4_t lo = vqmovn_u32(vld1q_u32(src + i));
+    uint16x4_t hi = vqmovn_u32(vld1q_u32(src + i + 4));
+    vst1q_u16(dst + i, vcombine_u16(lo, hi));
+  }
+  UInt32ToUInt16Scalar(src + i, dst + i, count - i);
+}
+
+static void ByteSwap16NEON(const uint8_t* src, uint8_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+    vst1q_u8(dst + 2 * i, vrev16q_u8(vld1q_u8(src + 2 * i)));
+  ByteSwap16Scalar(src + 2 * i, dst + 2 * i, count - i);
+}
+
+static void ByteSwap32NEON(const uint8_t* src, uint8_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+    vst1q_u8(dst + 4 * i, vrev32q_u8(vld1q_u8(src + 4 * i)));
+  ByteSwap32Scalar(src + 4 * i, dst + 4 * i, count - i);
+}
+#endif
+
+//
+// Runtime dispatch
+//
+
+struct ConversionKernels {
+  ConversionISA isa;
+  void (*int16_to_uint16)(const int16_t*, uint16_t*, size_t, int32_t);
+  void (*window)(const uint16_t*, uint8_t*, size_t, float, float);
+  void (*float32_to_float16)(const float*, uint16_t*, size_t);
+  void (*uint32_to_uint16)(const uint32_t*, uint16_t*, size_t);
+  void (*byte_swap16)(const uint8_t*, uint8_t*, size_t);
+  void (*byte_swap32)(const uint8_t*, uint8_t*, size_t);
+};
+
+#if CONVERSION_X86
+struct CpuFeatures {
+  bool avx2;
+  bool f16c;
+};
+
+static CpuFeatures DetectCpuFeatures() {
+  CpuFeatures features = {false, false};
+  unsigned int regs[4];
+#if defined(_MSC_VER)
+  __cpuid((int*)regs, 0);
+#else
+  __cpuid(0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+  unsigned int max_leaf = regs[0];
+  if (max_leaf < 1) return features;
+
+#if defined(_MSC_VER)
+  __cpuid((int*)regs, 1);
+#else
+  __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+  bool osxsave = (regs[2] & (1u << 27)) != 0;
+  bool avx = (regs[2] & (1u << 28)) != 0;
+  bool f16c = (regs[2] & (1u << 29)) != 0;
+  if (!osxsave || !avx) return features;
+
+  // the OS must save the YMM registers on context switches
+#if defined(_MSC_VER)
+  unsigned long long xcr0 = _xgetbv(0);
+#else
+  unsigned int xcr0_lo, xcr0_hi;
+  __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  unsigned long long xcr0 = ((unsigned long long)xcr0_hi << 32) | xcr0_lo;
+#endif
+  if ((xcr0 & 0x6) != 0x6) return features;
+
+  features.f16c = f16c;
+  if (max_leaf >= 7) {
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, 7, 0);
+#else
+    __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    features.avx2 = (regs[1] & (1u << 5)) != 0;
+  }
+  return features;
+}
+#endif
+
+static ConversionKernels SelectKernels() {
+  ConversionKernels kernels = {kConversionScalar,      Int16ToUInt16Scalar,
+                               WindowScalar,           Float32ToFloat16Scalar,
+                               UInt32ToUInt16Scalar,   ByteSwap16Scalar,
+                               ByteSwap32Scalar};
+#if CONVERSION_SSE2
+  kernels.isa = kConversionSSE2;
+  kernels.int16_to_uint16 = Int16ToUInt16SSE2;
+  kernels.window = WindowSSE2;
+  kernels.uint32_to_uint16 = UInt32ToUInt16SSE2;
+  kernels.byte_swap16 = ByteSwap16SSE2;
+  kernels.byte_swap32 = ByteSwap32SSE2;
+#endif
+#if CONVERSION_X86
+  CpuFeatures features = DetectCpuFeatures();
+  if (features.f16c) kernels.float32_to_float16 = Float32ToFloat16F16C;
+  if (features.avx2) {
+    kernels.isa = kConversionAVX2;
+    kernels.int16_to_uint16 = Int16ToUInt16AVX2;
+    kernels.window = WindowAVX2;
+    kernels.uint32_to_uint16 = UInt32ToUInt16AVX2;
+    kernels.byte_swap16 = ByteSwap16AVX2;
+    kernels.byte_swap32 = ByteSwap32AVX2;
+  }
+#elif CONVERSION_NEON
+  kernels.isa = kConversionNEON;
+  kernels.int16_to_uint16 = Int16ToUInt16NEON;
+  kernels.window = WindowNEON;
+  kernels.float32_to_float16 = Float32ToFloat16NEON;
+  kernels.uint32_to_uint16 = UInt32ToUInt16NEON;
+  kernels.byte_swap16 = ByteSwap16NEON;
+  kernels.byte_swap32 = ByteSwap32NEON;
+#endif
+  return kernels;
+}
+
+static const ConversionKernels& Kernels() {
+  // thread-safe initialization on first use
+  static const ConversionKernels kernels = SelectKernels();
+  return kernels;
+}
+
+ConversionISA GetConversionISA() { return Kernels().isa; }
+
+void ConvertInt16ToUInt16(const int16_t* src, uint16_t* dst, size_t count,
+                          int32_t offset) {
+  Kernels().int16_to_uint16(src, dst, count, ClampOffset(offset));
+}
+
+void ConvertUInt16ToUInt8Window(const uint16_t* src, uint8_t* dst,
+                                size_t count, uint16_t low, uint16_t high) {
+  float scale, bias;
+  WindowScaleBias(low, high, scale, bias);
+  Kernels().window(src, dst, count, scale, bias);
+}
+
+void ConvertFloat32ToFloat16(const float* src, uint16_t* dst, size_t count) {
+  Kernels().float32_to_float16(src, dst, count);
+}
+
+void ConvertUInt32ToUInt16(const uint32_t* src, uint16_t* dst, size_t count) {
+  Kernels().uint32_to_uint16(src, dst, count);
+}
+
+void ByteSwap16(const void* src, void* dst, size_t count) {
+  Kernels().byte_swap16((const uint8_t*)src, (uint8_t*)dst, count);
+}
+
+void ByteSwap32(const void* src, void* dst, size_t count) {
+  Kernels().byte_swap32((const uint8_t*)src, (uint8_t*)dst, count);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Texel conversion kernels meant to be run by producer threads before the
+// converted data is handed to the upload functions. The best implementation
+// for the executing CPU (AVX2/F16C, SSE2, AArch64 NEON or scalar) is selected
+// at runtime on first use. All kernels support src == dst (in-place) as long as
+// the destination texels are not larger than the source texels.
+
+/// @brief Instruction set used by the conversion kernels.
+enum ConversionISA {
+  kConversionScalar = 0,
+  kConversionSSE2 = 1,
+  kConversionAVX2 = 2,
+  kConversionNEON = 3
+};
+
+/// @brief Instruction set selected for the executing CPU.
+ConversionISA GetConversionISA();
+
+/// @brief dst = clamp(src + offset, 0, 65535). Typically used to shift signed
+/// CT Hounsfield units (e.g., offset 1024) into an R16 texture.
+void ConvertInt16ToUInt16(const int16_t* src, uint16_t* dst, size_t count,
+                          int32_t offset);
+
+/// @brief Windows (and quantizes) R16 texels into R8 texels: low maps to 0,
+/// high maps to 255 and values are clamped in between.
+void ConvertUInt16ToUInt8Window(const uint16_t* src, uint8_t* dst,
+                                size_t count, uint16_t low, uint16_t high);
+
+/// @brief Converts 32-bit floats to IEEE 754 half floats (round to nearest
+/// even), e.g., for R16F textures.
+void ConvertFloat32ToFloat16(const float* src, uint16_t* dst, size_t count);
+
+/// @brief dst = min(src, 65535). Typically used for 32-bit label volumes that
+/// are known to hold less than 65536 labels.
+void ConvertUInt32ToUInt16(const uint32_t* src, uint16_t* dst, size_t count);
+
+/// @brief Reverses the byte order of count 16-bit values (big endian data).
+void ByteSwap16(const void* src, void* dst, size_t count);
+
+/// @brief Reverses the byte order of count 32-bit values (big endian data).
+void ByteSwap32(const void* src, void* dst, size_t count);
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Table of the supported texture formats. Every row lists:
+//   name, value (as passed by the C# side), bytes per block, block size
+//   (texels along x and y, 1 for uncompressed formats), channels, kind,
+//   OpenGL internal format, OpenGL pixel format, OpenGL pixel type,
+//   DXGI format, VkFormat
+// Each backend expands the table with a macro that only picks its own columns
+// so that the tokens of the other graphics APIs never have to be defined.
+//
+// R8_UINT and R16_UINT are unsigned *normalized* formats (sampled as floats
+// in [0, 1]), their names are kept for compatibility. R16UI and R32UI are
+// unsigned integer formats (e.g., for label volumes) that have to be sampled
+// through usampler3D (resp. Texture3D<uint>).
+#define TEXTURE_FORMATS(X)                                                 \
+  X(R8_UINT, 0, 1, 1, 1, kFormatUnorm, GL_R8, GL_RED, GL_UNSIGNED_BYTE,    \
+    DXGI_FORMAT_R8_UNORM, VK_FORMAT_R8_UNORM)                              \
+  X(R16_UINT, 1, 2, 1, 1, kFormatUnorm, GL_R16, GL_RED, GL_UNSIGNED_SHORT, \
+    DXGI_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM)                            \
+  X(R16F, 2, 2, 1, 1, kFormatFloat, GL_R16F, GL_RED, GL_HALF_FLOAT,        \
+    DXGI_FORMAT_R16_FLOAT, VK_FORMAT_R16_SFLOAT)                           \
+  X(R32F, 3, 4, 1, 1, kFormatFloat, GL_R32F, GL_RED, GL_FLOAT,             \
+    DXGI_FORMAT_R32_FLOAT, VK_FORMAT_R32_SFLOAT)                           \
+  X(RG8, 4, 2, 1, 2, kFormatUnorm, GL_RG8, GL_RG, GL_UNSIGNED_BYTE,        \
+    DXGI_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8_UNORM)                          \
+  X(RG16, 5, 4, 1, 2, kFormatUnorm, GL_RG16, GL_RG, GL_UNSIGNED_SHORT,     \
+    DXGI_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_UNORM)                      \
+  X(RGBA8, 6, 4, 1, 4, kFormatUnorm, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE,  \
+    DXGI_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM)                  \
+  X(R16_SNORM, 7, 2, 1, 1, kFormatSnorm, GL_R16_SNORM, GL_RED, GL_SHORT,   \
+    DXGI_FORMAT_R16_SNORM, VK_FORMAT_R16_SNORM)                            \
+  X(R16UI, 8, 2, 1, 1, kFormatUint, GL_R16UI, GL_RED_INTEGER,              \
+    GL_UNSIGNED_SHORT, DXGI_FORMAT_R16_UINT, VK_FORMAT_R16_UINT)           \
+  X(R32UI, 9, 4, 1, 1, kFormatUint, GL_R32UI, GL_RED_INTEGER,              \
+    GL_UNSIGNED_INT, DXGI_FORMAT_R32_UINT, VK_FORMAT_R32_UINT)             \
+  X(BC4_UNORM, 10, 8, 4, 1, kFormatUnorm, GL_COMPRESSED_RED_RGTC1, GL_RED, \
+    GL_UNSIGNED_BYTE, DXGI_FORMAT_BC4_UNORM, VK_FORMAT_BC4_UNORM_BLOCK)
+
+/// @brief How the texels of a format are interpreted by shaders.
+enum FormatKind {
+  kFormatUnorm = 0,  // unsigned normalized, sampled as floats in [0, 1]
+  kFormatSnorm = 1,  // signed normalized, sampled as floats in [-1, 1]
+  kFormatFloat = 2,  // floating point
+  kFormatUint = 3    // unsigned integer, not filterable
+};
+
+#define TEXTURE_FORMAT_ENUM(name, value, bytes, block, channels, kind, \
+                            gl_internal, gl_format, gl_type, dxgi, vk) \
+  name = value,
+enum Format { TEXTURE_FORMATS(TEXTURE_FORMAT_ENUM) };
+#undef TEXTURE_FORMAT_ENUM
+
+#define TEXTURE_FORMAT_COUNT(name, value, bytes, block, channels, kind, \
+                             gl_internal, gl_format, gl_type, dxgi, vk) \
+  +1
+/// @brief Number of formats. Format values are 0 ... kFormatCount - 1 so
+/// that backends can index their tables with them.
+static const uint32_t kFormatCount = 0 TEXTURE_FORMATS(TEXTURE_FORMAT_COUNT);
+#undef TEXTURE_FORMAT_COUNT
+
+#define TEXTURE_FORMAT_NAME(name, value, bytes, block, channels, kind, \
+                            gl_internal, gl_format, gl_type, dxgi, vk) \
+  name,
+constexpr Format kFormatRows[kFormatCount] = {
+    TEXTURE_FORMATS(TEXTURE_FORMAT_NAME)};
+#undef TEXTURE_FORMAT_NAME
+
+constexpr bool FormatRowsAreSorted(uint32_t row) {
+  return row == kFormatCount ||
+         ((uint32_t)kFormatRows[row] == row && FormatRowsAreSorted(row + 1));
+}
+static_assert(FormatRowsAreSorted(0),
+              "TEXTURE_FORMATS rows must be sorted by value, starting at 0");
+
+/// @brief API independent properties of a format.
+struct FormatInfo {
+  uint32_t bytes_per_block;
+  uint32_t block_size;
+  uint32_t channels;
+  FormatKind kind;
+};
+
+#define TEXTURE_FORMAT_INFO(name, value, bytes, block, channels, kind, \
+                            gl_internal, gl_format, gl_type, dxgi, vk) \
+  {bytes, block, channels, kind},
+static const FormatInfo kFormatInfos[kFormatCount] = {
+    TEXTURE_FORMATS(TEXTURE_FORMAT_INFO)};
+#undef TEXTURE_FORMAT_INFO
+
+/// @brief Whether format is one of the supported formats.
+inline bool IsValidFormat(Format format) {
+  return (uint32_t)format < kFormatCount;
+}
+
+/// @brief Whether format is block-compressed (blocks of block_size x
+/// block_size x 1 texels).
+inline bool IsCompressedFormat(Format format) {
+  return IsValidFormat(format) && kFormatInfos[format].block_size > 1;
+}
+
+/// @brief Size in bytes of a single texel of the provided format.
+/// @return 0 for unknown and block-compressed formats
+inline uint32_t BytesPerTexel(Format format) {
+  return IsValidFormat(format) && kFormatInfos[format].block_size == 1
+             ? kFormatInfos[format].bytes_per_block
+             : 0;
+}
+
+/// @brief Size in bytes of the tightly packed texels of a box. Boxes of
+/// block-compressed formats are rounded up to whole blocks in x and y.
+/// @return 0 for unknown formats
+inline size_t TextureDataSize(Format format, int32_t width, int32_t height,
+                              int32_t depth) {
+  if (!IsValidFormat(format)) return 0;
+  const FormatInfo& info = kFormatInfos[format];
+  size_t blocks_x = (width + info.block_size - 1) / info.block_size;
+  size_t blocks_y = (height + info.block_size - 1) / info.block_size;
+  return blocks_x * blocks_y * (size_t)depth * info.bytes_per_block;
+}
+
+/// @brief Extent of a mip level along an axis: halved (rounded down) per
+/// level, at least 1, as OpenGL and Direct3D define it.
+inline int32_t MipExtent(int32_t extent, int32_t level) {
+  int32_t mip = extent >> level;
+  return mip > 0 ? mip : 1;
+}
+
+/// @brief Number of levels of a full mip chain, down to 1x1x1.
+inline int32_t MipLevelCount(int32_t width, int32_t height, int32_t depth) {
+  int32_t largest = width > height ? width : height;
+  largest = largest > depth ? largest : depth;
+  int32_t levels = 1;
+  while (largest >> levels > 0) ++levels;
+  return levels;
+}
+
+/// @brief Size in bytes of the first levels of a mip chain.
+inline size_t MipChainDataSize(Format format, int32_t width, int32_t height,
+                               int32_t depth, int32_t levels) {
+  size_t size = 0;
+  for (int32_t level = 0; level < levels; ++level) {
+    size += TextureDataSize(format, MipExtent(width, level),
+                            MipExtent(height, level), MipExtent(depth, level));
+  }
+  return size;
+}
@@ -0,0 +1,81 @@
+#include "GpuMemoryBudget.h"
+
+#include <string.h>
+
+#include <sstream>
+
+#include "RenderAPI.h"
+
+GpuMemoryBudget::GpuMemoryBudget() : m_DeviceKnown(false) {
+  memset(&m_Statistics, 0, sizeof(m_Statistics));
+}
+
+void GpuMemoryBudget::SetBudget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Statistics.budget_bytes = bytes;
+}
+
+void GpuMemoryBudget::SetDeviceMemory(bool device_known, uint64_t total_bytes,
+                                      uint64_t available_bytes,
+                                      uint64_t internal_bytes) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_DeviceKnown = device_known;
+  m_Statistics.device_total_bytes = device_known ? total_bytes : 0;
+  m_Statistics.device_available_bytes = device_known ? available_bytes : 0;
+  m_Statistics.internal_bytes = internal_bytes;
+}
+
+bool GpuMemoryBudget::Admit(size_t size) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  uint64_t used = m_Statistics.texture_bytes + m_Statistics.internal_bytes;
+  bool over_budget = m_Statistics.budget_bytes > 0 &&
+                     used + size > m_Statistics.budget_bytes;
+  // the driver's available memory already excludes the plugin's textures
+  bool over_device =
+      m_DeviceKnown && size > m_Statistics.device_available_bytes;
+  if (!over_budget && !over_device) return true;
+
+  ++m_Statistics.refused;
+  std::ostringstream ss;
+  ss << __FUNCTION__ << ": refused a texture of " << size
+     << " bytes, the plugin uses " << used << " bytes";
+  if (over_budget) ss << " of its " << m_Statistics.budget_bytes << " budget";
+  if (over_device) {
+    ss << ", the device has " << m_Statistics.device_available_bytes
+       << " bytes available";
+  }
+  UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  return false;
+}
+
+void GpuMemoryBudget::Register(void* texture_handle, size_t size) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  size_t& recorded = m_Textures[texture_handle];
+  m_Statistics.texture_bytes = m_Statistics.texture_bytes - recorded + size;
+  recorded = size;
+  m_Statistics.texture_count = m_Textures.size();
+  if (m_Statistics.texture_bytes > m_Statistics.peak_texture_bytes)
+    m_Statistics.peak_texture_bytes = m_Statistics.texture_bytes;
+}
+
+void GpuMemoryBudget::Unregister(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<void*, size_t>::iterator it =
+      m_Textures.find(texture_handle);
+  if (it == m_Textures.end()) return;
+  m_Statistics.texture_bytes -= it->second;
+  m_Textures.erase(it);
+  m_Statistics.texture_count = m_Textures.size();
+}
+
+size_t GpuMemoryBudget::size(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<void*, size_t>::const_iterator it =
+      m_Textures.find(texture_handle);
+  return it == m_Textures.end() ? 0 : it->second;
+}
+
+GpuMemoryStatistics GpuMemoryBudget::statistics() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Statistics;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <unordered_map>
+
+/// @brief Counters of a GpuMemoryBudget, see GetGpuMemoryStatistics.
+struct GpuMemoryStatistics {
+  // textures created by the plugin and not cleared yet
+  uint64_t texture_bytes;
+  uint64_t peak_texture_bytes;
+  uint64_t texture_count;
+  // buffers of the graphics backend (e.g., GPU decoding)
+  uint64_t internal_bytes;
+  // configured budget, 0 if none
+  uint64_t budget_bytes;
+  // video memory reported by the driver, 0 if it does not report it
+  uint64_t device_total_bytes;
+  uint64_t device_available_bytes;
+  // creations refused because they would have exceeded the budget
+  uint64_t refused;
+};
+
+/// @brief Accounting of the GPU memory owned by the plugin.
+///
+/// Every texture created through the CreateTexture3D event is recorded with
+/// its size and released by the ClearTexture3D event. Creations are admitted
+/// only if the plugin's total stays within the configured budget and, where
+/// the driver reports it, within the video memory currently available.
+/// Refused creations return a NULL texture, so callers can lower their level
+/// of detail (or clear textures) before the driver starts paging.
+class GpuMemoryBudget {
+ public:
+  GpuMemoryBudget();
+
+  /// @param bytes maximum size of the plugin's textures and buffers, 0 for
+  /// no limit other than the device's
+  void SetBudget(size_t bytes);
+
+  /// @brief Updates the numbers reported by the graphics backend.
+  /// @param device_known whether the driver reports its video memory
+  void SetDeviceMemory(bool device_known, uint64_t total_bytes,
+                       uint64_t available_bytes, uint64_t internal_bytes);
+
+  /// @brief Whether a texture of size bytes may be created. Counts and logs
+  /// refusals.
+  bool Admit(size_t size);
+
+  void Register(void* texture_handle, size_t size);
+
+  void Unregister(void* texture_handle);
+
+  /// @return the recorded size of a texture, 0 if it is not registered
+  size_t size(void* texture_handle);
+
+  GpuMemoryStatistics statistics();
+
+ private:
+  std::mutex m_Mutex;
+  std::unordered_map<void*, size_t> m_Textures;
+  bool m_DeviceKnown;
+  GpuMemoryStatistics m_Statistics;
+};
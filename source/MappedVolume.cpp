@@ -0,0 +1,205 @@
+#include "MappedVolume.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <sstream>
+
+#include "BrickHalo.h"
+#include "PlatformBase.h"
+#include "RenderAPI.h"
+
+#if UNITY_WIN
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define MAPPED_VOLUME_SUPPORTED 1
+#elif UNITY_METRO || UNITY_WEBGL
+#define MAPPED_VOLUME_SUPPORTED 0
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_VOLUME_SUPPORTED 1
+#endif
+
+MappedVolume::MappedVolume()
+    : m_Mapping(NULL),
+      m_MappingSize(0),
+      m_Texels(NULL),
+      m_Width(0),
+      m_Height(0),
+      m_Depth(0),
+      m_Format(R8_UINT),
+      m_BytesPerTexel(0),
+      m_File(NULL),
+      m_FileMapping(NULL) {}
+
+MappedVolume::~MappedVolume() { Close(); }
+
+bool MappedVolume::Open(const char* path, int32_t width, int32_t height,
+                        int32_t depth, Format format, uint64_t header_offset) {
+  Close();
+  std::ostringstream ss;
+  ss << __FUNCTION__ << ": " << path << ": ";
+  if (width <= 0 || height <= 0 || depth <= 0 || BytesPerTexel(format) == 0) {
+    ss << "invalid extents " << width << "x" << height << "x" << depth
+       << " or format " << format;
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  uint64_t required = header_offset + TextureDataSize(format, width, height,
+                                                      depth);
+  uint64_t file_size = 0;
+
+#if !MAPPED_VOLUME_SUPPORTED
+  ss << "memory-mapped volumes are not supported on this platform";
+  UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  return false;
+#else
+#if UNITY_WIN
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+  LARGE_INTEGER size;
+  if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) {
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    ss << "cannot open file (error " << GetLastError() << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  file_size = (uint64_t)size.QuadPart;
+  if (file_size < required || (uint64_t)(size_t)file_size != file_size) {
+    CloseHandle(file);
+    ss << "file has " << file_size << " bytes, expected at least " << required;
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  void* view =
+      mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+  if (!view) {
+    ss << "cannot map file (error " << GetLastError() << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  m_File = file;
+  m_FileMapping = mapping;
+#else
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) close(fd);
+    ss << "cannot open file (" << strerror(errno) << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  file_size = (uint64_t)st.st_size;
+  if (file_size < required || (uint64_t)(size_t)file_size != file_size) {
+    close(fd);
+    ss << "file has " << file_size << " bytes, expected at least " << required;
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  // the mapping stays valid after the descriptor is closed
+  void* view = mmap(NULL, (size_t)file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (view == MAP_FAILED) {
+    ss << "cannot map file (" << strerror(errno) << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  // bricks are read in no particular order, the kernel's sequential
+  // read-ahead would mostly read pages of other bricks
+  madvise(view, (size_t)file_size, MADV_RANDOM);
+#endif
+  m_Mapping = view;
+  m_MappingSize = (size_t)file_size;
+  m_Texels = (const uint8_t*)view + header_offset;
+  m_Width = width;
+  m_Height = height;
+  m_Depth = depth;
+  m_Format = format;
+  m_BytesPerTexel = BytesPerTexel(format);
+  return true;
+#endif  // #if !MAPPED_VOLUME_SUPPORTED
+}
+
+void MappedVolume::Close() {
+  if (!m_Mapping) return;
+#if UNITY_WIN
+  UnmapViewOfFile(m_Mapping);
+  CloseHandle((HANDLE)m_FileMapping);
+  CloseHandle((HANDLE)m_File);
+  m_File = m_FileMapping = NULL;
+#elif MAPPED_VOLUME_SUPPORTED
+  munmap(m_Mapping, m_MappingSize);
+#endif
+  m_Mapping = NULL;
+  m_MappingSize = 0;
+  m_Texels = NULL;
+}
+
+bool MappedVolume::Contains(int32_t x, int32_t y, int32_t z, int32_t width,
+                            int32_t height, int32_t depth) const {
+  return m_Texels && x >= 0 && y >= 0 && z >= 0 && width > 0 && height > 0 &&
+         depth > 0 && width <= m_Width - x && height <= m_Height - y &&
+         depth <= m_Depth - z;
+}
+
+void MappedVolume::WillNeed(int32_t x, int32_t y, int32_t z, int32_t width,
+                            int32_t height, int32_t depth) const {
+  if (!Contains(x, y, z, width, height, depth)) return;
+#if MAPPED_VOLUME_SUPPORTED && !UNITY_WIN
+  // one range per slice, from the box's first to its last texel
+  static const uintptr_t kPageMask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+  for (int32_t k = 0; k < depth; ++k) {
+    const uint8_t* first = m_Texels + TexelOffset(x, y, z + k);
+    const uint8_t* last =
+        m_Texels + TexelOffset(x + width - 1, y + height - 1, z + k) +
+        m_BytesPerTexel;
+    // madvise requires a page-aligned address
+    uintptr_t begin = (uintptr_t)first & ~kPageMask;
+    madvise((void*)begin, (uintptr_t)last - begin, MADV_WILLNEED);
+  }
+#elif UNITY_WIN && defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+  // PrefetchVirtualMemory requires Windows 8
+  WIN32_MEMORY_RANGE_ENTRY ranges[64];
+  for (int32_t k = 0; k < depth;) {
+    ULONG_PTR count = 0;
+    for (; k < depth && count < 64; ++k, ++count) {
+      const uint8_t* first = m_Texels + TexelOffset(x, y, z + k);
+      const uint8_t* last =
+          m_Texels + TexelOffset(x + width - 1, y + height - 1, z + k) +
+          m_BytesPerTexel;
+      ranges[count].VirtualAddress = (PVOID)first;
+      ranges[count].NumberOfBytes = (SIZE_T)(last - first);
+    }
+    PrefetchVirtualMemory(GetCurrentProcess(), count, ranges, 0);
+  }
+#endif
+}
+
+void MappedVolume::Gather(int32_t x, int32_t y, int32_t z, int32_t width,
+                          int32_t height, int32_t depth, void* dst) const {
+  size_t row_size = (size_t)width * m_BytesPerTexel;
+  uint8_t* out = (uint8_t*)dst;
+  for (int32_t k = 0; k < depth; ++k) {
+    // full-width boxes are contiguous per slice
+    if (width == m_Width) {
+      memcpy(out, m_Texels + TexelOffset(0, y, z + k), row_size * height);
+      out += row_size * height;
+      continue;
+    }
+    for (int32_t j = 0; j < height; ++j, out += row_size)
+      memcpy(out, m_Texels + TexelOffset(x, y + j, z + k), row_size);
+  }
+}
+
+void MappedVolume::GatherPadded(int32_t x, int32_t y, int32_t z,
+                                int32_t width, int32_t height, int32_t depth,
+                                int32_t halo, void* dst) const {
+  GatherPaddedBox(m_Texels, m_Width, m_Height, m_Depth, m_BytesPerTexel, x, y,
+                  z, width, height, depth, halo, dst);
+}
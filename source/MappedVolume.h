@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Formats.h"
+
+/// @brief Read-only memory mapping of a raw volume file (texels of a single
+/// format, x fastest, then y, then z, optionally preceded by a header) so that
+/// bricks can be read from the page cache without passing through C#.
+///
+/// Uses mmap/madvise on POSIX platforms and file mappings on Windows. Not
+/// supported on UWP and WebGL.
+class MappedVolume {
+ public:
+  MappedVolume();
+  ~MappedVolume();
+
+  /// @brief Maps a volume file.
+  /// @param header_offset offset in bytes of the first texel within the file
+  /// @return false (and logs an error) if the file cannot be mapped or is
+  /// smaller than header_offset plus the size of the texels
+  bool Open(const char* path, int32_t width, int32_t height, int32_t depth,
+            Format format, uint64_t header_offset);
+
+  /// @brief Unmaps the file.
+  void Close();
+
+  /// @brief Whether the box lies within the volume.
+  bool Contains(int32_t x, int32_t y, int32_t z, int32_t width,
+                int32_t height, int32_t depth) const;
+
+  /// @brief Asks the OS to start reading the pages of a box (read-ahead)
+  /// without blocking, e.g., for bricks that are about to be gathered.
+  void WillNeed(int32_t x, int32_t y, int32_t z, int32_t width,
+                int32_t height, int32_t depth) const;
+
+  /// @brief Copies the rows of a box into tightly packed texels. Blocks on
+  /// page faults if the pages are not resident. Thread-safe.
+  void Gather(int32_t x, int32_t y, int32_t z, int32_t width, int32_t height,
+              int32_t depth, void* dst) const;
+
+  /// @brief Same as Gather, but the box is grown by halo texels on every side
+  /// and clamped to the volume (see GatherPaddedBox).
+  void GatherPadded(int32_t x, int32_t y, int32_t z, int32_t width,
+                    int32_t height, int32_t depth, int32_t halo,
+                    void* dst) const;
+
+  Format format() const { return m_Format; }
+
+ private:
+  MappedVolume(const MappedVolume&);
+  MappedVolume& operator=(const MappedVolume&);
+
+  /// @brief Offset in bytes of a texel relative to the first texel.
+  size_t TexelOffset(int32_t x, int32_t y, int32_t z) const {
+    return (((size_t)z * m_Height + y) * m_Width + x) * m_BytesPerTexel;
+  }
+
+  void* m_Mapping;
+  size_t m_MappingSize;
+  const uint8_t* m_Texels;
+  int32_t m_Width;
+  int32_t m_Height;
+  int32_t m_Depth;
+  Format m_Format;
+  uint32_t m_BytesPerTexel;
+  // file and file mapping handles, only used on Windows
+  void* m_File;
+  void* m_FileMapping;
+};
@@ -0,0 +1,351 @@
+#include "MipChain.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "StagingAllocator.h"
+
+typedef MipChainTable::Box Box;
+
+static bool SameBox(const Box& a, const Box& b) {
+  return a.x == b.x && a.y == b.y && a.z == b.z && a.width == b.width &&
+         a.height == b.height && a.depth == b.depth;
+}
+
+static int32_t Clamp(int32_t value, int32_t low, int32_t high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+/// @brief Copies the texels of dst_box from src, which holds src_box, to dst.
+/// Texels of dst_box outside src_box are clamped to src_box's border.
+/// @param src texel (src_box.x, src_box.y, src_box.z)
+/// @param dst texel (dst_box.x, dst_box.y, dst_box.z)
+static void CopyBox(const uint8_t* src, const Box& src_box,
+                    size_t src_row_pitch, size_t src_slice_pitch, uint8_t* dst,
+                    const Box& dst_box, size_t dst_row_pitch,
+                    size_t dst_slice_pitch, uint32_t bytes_per_texel) {
+  int32_t x0 = std::max(dst_box.x, src_box.x);
+  int32_t x1 = std::min(dst_box.x + dst_box.width, src_box.x + src_box.width);
+  for (int32_t z = 0; z < dst_box.depth; ++z) {
+    int32_t src_z = Clamp(dst_box.z + z, src_box.z,
+                          src_box.z + src_box.depth - 1) -
+                    src_box.z;
+    for (int32_t y = 0; y < dst_box.height; ++y) {
+      int32_t src_y = Clamp(dst_box.y + y, src_box.y,
+                            src_box.y + src_box.height - 1) -
+                      src_box.y;
+      const uint8_t* in = src + src_z * src_slice_pitch + src_y * src_row_pitch;
+      uint8_t* out = dst + z * dst_slice_pitch + y * dst_row_pitch;
+      for (int32_t x = dst_box.x; x < x0; ++x) {
+        memcpy(out + (size_t)(x - dst_box.x) * bytes_per_texel, in,
+               bytes_per_texel);
+      }
+      memcpy(out + (size_t)(x0 - dst_box.x) * bytes_per_texel,
+             in + (size_t)(x0 - src_box.x) * bytes_per_texel,
+             (size_t)(x1 - x0) * bytes_per_texel);
+      for (int32_t x = x1; x < dst_box.x + dst_box.width; ++x) {
+        memcpy(out + (size_t)(x - dst_box.x) * bytes_per_texel,
+               in + (size_t)(src_box.width - 1) * bytes_per_texel,
+               bytes_per_texel);
+      }
+    }
+  }
+}
+
+bool MipChainTable::Register(void* texture_handle, int32_t width,
+                             int32_t height, int32_t depth, Format format,
+                             int32_t levels, DownsampleFilter filter,
+                             bool on_gpu) {
+  // support on the GPU is checked by the caller
+  if (!on_gpu && !IsDownsamplingSupported(format, filter)) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": filter " << filter
+       << " does not support format " << format
+       << ", the coarser levels of texture " << texture_handle
+       << " have to be uploaded";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  std::shared_ptr<Chain> chain(new Chain());
+  chain->level_count = levels;
+  chain->format = format;
+  chain->filter = filter;
+  chain->on_gpu = on_gpu;
+  chain->levels.reset(new Level[levels]);
+  chain->dirty.resize(levels);
+  for (int32_t i = 0; i < levels; ++i) {
+    chain->levels[i].width = MipExtent(width, i);
+    chain->levels[i].height = MipExtent(height, i);
+    chain->levels[i].depth = MipExtent(depth, i);
+  }
+  // the coarsest level is never downsampled, the GPU reads the texture's
+  // own levels
+  size_t mirrored = 0;
+  for (int32_t i = levels - 2; i >= 0 && !on_gpu; --i) {
+    Level& level = chain->levels[i];
+    size_t size =
+        TextureDataSize(format, level.width, level.height, level.depth);
+    if (mirrored + size > kMirrorBudget) break;
+    level.mirror.assign(size, 0);
+    mirrored += size;
+  }
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Chains[texture_handle] = chain;
+  return true;
+}
+
+void MipChainTable::Unregister(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Chains.erase(texture_handle);
+}
+
+void MipChainTable::Clear() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Chains.clear();
+  m_Dirty.clear();
+}
+
+bool MipChainTable::IsDownsampledOnHost(void* texture_handle) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<void*, std::shared_ptr<Chain> >::const_iterator it =
+      m_Chains.find(texture_handle);
+  return it != m_Chains.end() && !it->second->on_gpu;
+}
+
+bool MipChainTable::ParentBox(const Box& box, const Level& parent_level,
+                              Box& parent) {
+  parent.x = box.x / 2;
+  parent.y = box.y / 2;
+  parent.z = box.z / 2;
+  parent.width =
+      std::min((box.x + box.width + 1) / 2, parent_level.width) - parent.x;
+  parent.height =
+      std::min((box.y + box.height + 1) / 2, parent_level.height) - parent.y;
+  parent.depth =
+      std::min((box.z + box.depth + 1) / 2, parent_level.depth) - parent.z;
+  return parent.width > 0 && parent.height > 0 && parent.depth > 0;
+}
+
+bool MipChainTable::Downsample(const UploadCommand& cmd,
+                               std::vector<UploadCommand>& uploads) {
+  std::shared_ptr<Chain> chain;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::unordered_map<void*, std::shared_ptr<Chain> >::const_iterator it =
+        m_Chains.find(cmd.texture_handle);
+    if (it == m_Chains.end() || it->second->on_gpu) return false;
+    chain = it->second;
+  }
+  if (cmd.format != chain->format || !cmd.data_ptr || cmd.level < 0 ||
+      cmd.level >= chain->level_count)
+    return false;
+  const Level& finest = chain->levels[cmd.level];
+  if (cmd.xoffset < 0 || cmd.yoffset < 0 || cmd.zoffset < 0 ||
+      cmd.width <= 0 || cmd.height <= 0 || cmd.depth <= 0 ||
+      cmd.xoffset + cmd.width > finest.width ||
+      cmd.yoffset + cmd.height > finest.height ||
+      cmd.zoffset + cmd.depth > finest.depth)
+    return false;
+
+  uint32_t bytes_per_texel = BytesPerTexel(cmd.format);
+  Box box = {cmd.xoffset, cmd.yoffset, cmd.zoffset,
+             cmd.width,   cmd.height,  cmd.depth};
+  const uint8_t* data = SourceOrigin(cmd.data_ptr, cmd.layout, cmd.width,
+                                     cmd.height, bytes_per_texel);
+  size_t row_pitch = SourceRowPitch(cmd.layout, cmd.width, bytes_per_texel);
+  size_t slice_pitch =
+      SourceSlicePitch(cmd.layout, cmd.width, cmd.height, bytes_per_texel);
+  size_t first = uploads.size();
+  for (int32_t level = cmd.level + 1; level < chain->level_count; ++level) {
+    Level& child = chain->levels[level - 1];
+    Box parent;
+    if (!ParentBox(box, chain->levels[level], parent)) break;
+    Box children;
+    children.x = 2 * parent.x;
+    children.y = 2 * parent.y;
+    children.z = 2 * parent.z;
+    children.width =
+        std::min(2 * (parent.x + parent.width), child.width) - children.x;
+    children.height =
+        std::min(2 * (parent.y + parent.height), child.height) - children.y;
+    children.depth =
+        std::min(2 * (parent.z + parent.depth), child.depth) - children.z;
+
+    size_t packed_row = (size_t)children.width * bytes_per_texel;
+    size_t packed_slice = packed_row * children.height;
+    const uint8_t* src = data;
+    std::shared_ptr<uint8_t> gathered;
+    if (!child.mirror.empty()) {
+      gathered = g_StagingAllocator.Allocate(packed_slice * children.depth);
+      if (!gathered) break;
+      size_t level_row = (size_t)child.width * bytes_per_texel;
+      size_t level_slice = level_row * child.height;
+      Box whole = {0, 0, 0, child.width, child.height, child.depth};
+      std::lock_guard<std::mutex> lock(child.mutex);
+      uint8_t* mirror = &child.mirror[0];
+      CopyBox(data, box, row_pitch, slice_pitch,
+              mirror + box.z * level_slice + box.y * level_row +
+                  (size_t)box.x * bytes_per_texel,
+              box, level_row, level_slice, bytes_per_texel);
+      CopyBox(mirror, whole, level_row, level_slice, gathered.get(), children,
+              packed_row, packed_slice, bytes_per_texel);
+      src = gathered.get();
+    } else if (!SameBox(box, children) || row_pitch != packed_row ||
+               slice_pitch != packed_slice) {
+      gathered = g_StagingAllocator.Allocate(packed_slice * children.depth);
+      if (!gathered) break;
+      CopyBox(data, box, row_pitch, slice_pitch, gathered.get(), children,
+              packed_row, packed_slice, bytes_per_texel);
+      src = gathered.get();
+    }
+
+    std::shared_ptr<uint8_t> output = g_StagingAllocator.Allocate(
+        TextureDataSize(cmd.format, parent.width, parent.height,
+                        parent.depth));
+    if (!output) break;
+    Downsample2x(src, children.width, children.height, children.depth,
+                 cmd.format, output.get(), 0, parent.depth, chain->filter);
+
+    UploadCommand upload;
+    upload.texture_handle = cmd.texture_handle;
+    upload.xoffset = parent.x;
+    upload.yoffset = parent.y;
+    upload.zoffset = parent.z;
+    upload.width = parent.width;
+    upload.height = parent.height;
+    upload.depth = parent.depth;
+    upload.data_ptr = output.get();
+    upload.layout = PackedSourceLayout();
+    upload.level = level;
+    upload.format = cmd.format;
+    upload.ticket = 0;
+    upload.storage = output;
+    uploads.push_back(upload);
+
+    // the parents are the children of the next level
+    box = parent;
+    data = output.get();
+    row_pitch = (size_t)parent.width * bytes_per_texel;
+    slice_pitch = row_pitch * parent.height;
+  }
+  std::reverse(uploads.begin() + first, uploads.end());
+  return true;
+}
+
+void MipChainTable::AddDirtyBox(std::vector<Box>& boxes, const Box& box) {
+  int64_t volume = (int64_t)box.width * box.height * box.depth;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    Box& dirty = boxes[i];
+    int32_t x0 = std::min(dirty.x, box.x), y0 = std::min(dirty.y, box.y);
+    int32_t z0 = std::min(dirty.z, box.z);
+    int32_t x1 = std::max(dirty.x + dirty.width, box.x + box.width);
+    int32_t y1 = std::max(dirty.y + dirty.height, box.y + box.height);
+    int32_t z1 = std::max(dirty.z + dirty.depth, box.z + box.depth);
+    // merged if the union is not larger than both boxes together (e.g., one
+    // contains the other or both are neighbouring bricks of the same row)
+    int64_t merged = (int64_t)(x1 - x0) * (y1 - y0) * (z1 - z0);
+    if (merged <= (int64_t)dirty.width * dirty.height * dirty.depth + volume) {
+      Box united = {x0, y0, z0, x1 - x0, y1 - y0, z1 - z0};
+      dirty = united;
+      return;
+    }
+  }
+  if (boxes.size() < kMaxDirtyBoxes) {
+    boxes.push_back(box);
+    return;
+  }
+  Box bounds = box;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    int32_t x1 = std::max(bounds.x + bounds.width, boxes[i].x + boxes[i].width);
+    int32_t y1 =
+        std::max(bounds.y + bounds.height, boxes[i].y + boxes[i].height);
+    int32_t z1 = std::max(bounds.z + bounds.depth, boxes[i].z + boxes[i].depth);
+    bounds.x = std::min(bounds.x, boxes[i].x);
+    bounds.y = std::min(bounds.y, boxes[i].y);
+    bounds.z = std::min(bounds.z, boxes[i].z);
+    bounds.width = x1 - bounds.x;
+    bounds.height = y1 - bounds.y;
+    bounds.depth = z1 - bounds.z;
+  }
+  boxes.assign(1, bounds);
+}
+
+void MipChainTable::MarkDirty(void* texture_handle, int32_t xoffset,
+                              int32_t yoffset, int32_t zoffset, int32_t width,
+                              int32_t height, int32_t depth, int32_t level) {
+  std::shared_ptr<Chain> chain;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::unordered_map<void*, std::shared_ptr<Chain> >::const_iterator it =
+        m_Chains.find(texture_handle);
+    if (it == m_Chains.end() || !it->second->on_gpu) return;
+    chain = it->second;
+  }
+  // the coarsest level has no parents
+  if (level < 0 || level >= chain->level_count - 1 || width <= 0 ||
+      height <= 0 || depth <= 0)
+    return;
+  bool clean = true;
+  for (int32_t i = 0; i < chain->level_count && clean; ++i)
+    clean = chain->dirty[i].empty();
+  if (clean) m_Dirty.push_back(texture_handle);
+  Box box = {xoffset, yoffset, zoffset, width, height, depth};
+  AddDirtyBox(chain->dirty[level], box);
+}
+
+void MipChainTable::Regenerate(RenderAPI* api,
+                               std::vector<UploadCommand>& regenerated) {
+  for (size_t t = 0; t < m_Dirty.size(); ++t) {
+    std::shared_ptr<Chain> chain;
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      std::unordered_map<void*, std::shared_ptr<Chain> >::const_iterator it =
+          m_Chains.find(m_Dirty[t]);
+      if (it == m_Chains.end()) continue;
+      chain = it->second;
+    }
+    // each level is complete before its parents are computed from it
+    bool failed = false;
+    for (int32_t level = 1; level < chain->level_count; ++level) {
+      std::vector<Box>& boxes = chain->dirty[level - 1];
+      for (size_t i = 0; i < boxes.size(); ++i) {
+        Box parent;
+        if (!ParentBox(boxes[i], chain->levels[level], parent)) continue;
+        if (!api->DownsampleTexture3D(m_Dirty[t], parent.x, parent.y,
+                                      parent.z, parent.width, parent.height,
+                                      parent.depth, level, chain->format,
+                                      chain->filter)) {
+          std::ostringstream ss;
+          ss << __FUNCTION__ << ": the backend cannot downsample level "
+             << level << " of texture " << m_Dirty[t];
+          UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+          failed = true;
+          break;
+        }
+        UploadCommand box;
+        box.texture_handle = m_Dirty[t];
+        box.xoffset = parent.x;
+        box.yoffset = parent.y;
+        box.zoffset = parent.z;
+        box.width = parent.width;
+        box.height = parent.height;
+        box.depth = parent.depth;
+        box.data_ptr = NULL;
+        box.layout = PackedSourceLayout();
+        box.level = level;
+        box.format = chain->format;
+        box.ticket = 0;
+        regenerated.push_back(box);
+        if (level + 1 < chain->level_count)
+          AddDirtyBox(chain->dirty[level], parent);
+      }
+      boxes.clear();
+      if (failed) break;
+    }
+    for (int32_t level = 0; level < chain->level_count; ++level)
+      chain->dirty[level].clear();
+  }
+  m_Dirty.clear();
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Downsample.h"
+#include "RenderAPI.h"
+#include "UploadQueue.h"
+
+/// @brief Textures created with several mip levels whose coarser levels are
+/// generated from the uploads to their finer levels.
+///
+/// Every upload to a registered texture is downsampled (see Downsample2x) on
+/// the thread that prepares it into uploads of the same region of each
+/// coarser level, which are queued ahead of it so that a low-resolution
+/// preview of the region is shown first.
+///
+/// Parent texels are computed from whole 2x2x2 blocks of children. Blocks
+/// that an upload only partly covers (uploads at odd offsets, or at offsets
+/// that are not multiples of the brick size on coarser levels) are completed
+/// from host copies of the levels, kept for the coarsest levels that fit into
+/// kMirrorBudget. On levels without a copy, the missing children are clamped
+/// to the upload's box, so bricks at offsets that are multiples of 2^k yield
+/// exact parents on the k levels above theirs.
+///
+/// Textures registered for GPU regeneration are not downsampled on the host.
+/// Instead, the boxes written by executed uploads are recorded as dirty and
+/// Regenerate recomputes only their footprint on each coarser level with
+/// RenderAPI::DownsampleTexture3D, so the cost of an edit scales with the
+/// edited region instead of the texture (as with glGenerateMipmap).
+class MipChainTable {
+ public:
+  /// @brief Maximum size of the host copies of the levels of a texture.
+  static const size_t kMirrorBudget = 64 << 20;
+
+  /// @brief Number of dirty boxes per level above which they are merged
+  /// into their bounding box.
+  static const size_t kMaxDirtyBoxes = 64;
+
+  /// @brief Box of a level, in texels.
+  struct Box {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    int32_t width;
+    int32_t height;
+    int32_t depth;
+  };
+
+  /// @brief Starts generating the coarser levels of a texture.
+  /// @param levels number of levels of the texture
+  /// @param on_gpu whether the levels are regenerated by Regenerate instead
+  /// of being downsampled on the host
+  /// @return false (and logs an error) if the host filter does not support
+  /// the format
+  bool Register(void* texture_handle, int32_t width, int32_t height,
+                int32_t depth, Format format, int32_t levels,
+                DownsampleFilter filter, bool on_gpu);
+
+  void Unregister(void* texture_handle);
+
+  void Clear();
+
+  /// @brief Whether uploads to the texture have to be passed to Downsample.
+  bool IsDownsampledOnHost(void* texture_handle);
+
+  /// @brief Downsamples an upload to a registered texture into uploads of
+  /// the coarser levels, whose sources are staging buffers owned by them.
+  /// @param uploads receives the uploads, coarsest level first
+  /// @return false if the texture is not registered or the upload's format
+  /// is not the texture's
+  bool Downsample(const UploadCommand& cmd,
+                  std::vector<UploadCommand>& uploads);
+
+  /// @brief Records a box written to a level of a texture regenerated on the
+  /// GPU. Ignores other textures. Called on the render thread.
+  void MarkDirty(void* texture_handle, int32_t xoffset, int32_t yoffset,
+                 int32_t zoffset, int32_t width, int32_t height, int32_t depth,
+                 int32_t level);
+
+  /// @brief Regenerates the footprints of the dirty boxes on the coarser
+  /// levels, finest level first. Called on the render thread.
+  /// @param regenerated receives the rewritten boxes (without source data)
+  void Regenerate(RenderAPI* api, std::vector<UploadCommand>& regenerated);
+
+ private:
+  struct Level {
+    int32_t width;
+    int32_t height;
+    int32_t depth;
+    // tightly packed copy of the level, empty if not kept
+    std::vector<uint8_t> mirror;
+    std::mutex mutex;
+  };
+
+  struct Chain {
+    int32_t level_count;
+    Format format;
+    DownsampleFilter filter;
+    bool on_gpu;
+    std::unique_ptr<Level[]> levels;
+    // boxes written per level since the last Regenerate, only accessed on
+    // the render thread
+    std::vector<std::vector<Box> > dirty;
+  };
+
+  /// @brief Computes the parents of a box of a level, the last texel of odd
+  /// extents having none.
+  /// @return false if the box has no parents
+  static bool ParentBox(const Box& box, const Level& parent_level,
+                        Box& parent);
+
+  /// @brief Adds a box to the dirty boxes of a level, merging it with a box
+  /// it extends into a larger box.
+  static void AddDirtyBox(std::vector<Box>& boxes, const Box& box);
+
+  std::mutex m_Mutex;
+  std::unordered_map<void*, std::shared_ptr<Chain> > m_Chains;
+  // textures with dirty boxes, only accessed on the render thread
+  std::vector<void*> m_Dirty;
+};
@@ -0,0 +1,121 @@
+#include "PartitionedVolume.h"
+
+#include <algorithm>
+
+// texels shared by neighbouring partitions
+static const int32_t kOverlap = 1;
+
+/// @brief Extent of the largest of count partitions along an axis.
+static int64_t PartitionSize(int32_t extent, int32_t count) {
+  int64_t covered = (int64_t)extent + (int64_t)(count - 1) * kOverlap;
+  return (covered + count - 1) / count;
+}
+
+PartitionedVolume::PartitionedVolume()
+    : m_Width(0), m_Height(0), m_Depth(0), m_Format(R8_UINT) {}
+
+bool PartitionedVolume::Layout(int32_t width, int32_t height, int32_t depth,
+                               Format format, int32_t max_dimension,
+                               uint64_t max_bytes) {
+  if (!IsValidFormat(format) || IsCompressedFormat(format) || width <= 0 ||
+      height <= 0 || depth <= 0 || max_dimension <= kOverlap + 1)
+    return false;
+  m_Width = width;
+  m_Height = height;
+  m_Depth = depth;
+  m_Format = format;
+
+  int32_t extents[3] = {width, height, depth};
+  int32_t counts[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    counts[axis] = 1;
+    while (PartitionSize(extents[axis], counts[axis]) > max_dimension)
+      ++counts[axis];
+  }
+  for (;;) {
+    int64_t sizes[3];
+    for (int axis = 0; axis < 3; ++axis)
+      sizes[axis] = PartitionSize(extents[axis], counts[axis]);
+    if (TextureDataSize(format, (int32_t)sizes[0], (int32_t)sizes[1],
+                        (int32_t)sizes[2]) <= max_bytes)
+      break;
+    int longest = 0;
+    for (int axis = 1; axis < 3; ++axis) {
+      if (sizes[axis] > sizes[longest]) longest = axis;
+    }
+    // partitions of two texels only hold overlap
+    if (sizes[longest] <= kOverlap + 1) return false;
+    ++counts[longest];
+  }
+
+  // extents differ by at most one texel
+  for (int axis = 0; axis < 3; ++axis) {
+    m_Starts[axis].clear();
+    m_Sizes[axis].clear();
+    int64_t covered =
+        (int64_t)extents[axis] + (int64_t)(counts[axis] - 1) * kOverlap;
+    int32_t base = (int32_t)(covered / counts[axis]);
+    int32_t remainder = (int32_t)(covered % counts[axis]);
+    int32_t start = 0;
+    for (int32_t i = 0; i < counts[axis]; ++i) {
+      int32_t size = base + (i < remainder ? 1 : 0);
+      m_Starts[axis].push_back(start);
+      m_Sizes[axis].push_back(size);
+      start += size - kOverlap;
+    }
+  }
+
+  m_Partitions.clear();
+  for (int32_t z = 0; z < counts[2]; ++z) {
+    for (int32_t y = 0; y < counts[1]; ++y) {
+      for (int32_t x = 0; x < counts[0]; ++x) {
+        VolumePartition partition;
+        partition.texture_handle = NULL;
+        partition.x = m_Starts[0][x];
+        partition.y = m_Starts[1][y];
+        partition.z = m_Starts[2][z];
+        partition.width = m_Sizes[0][x];
+        partition.height = m_Sizes[1][y];
+        partition.depth = m_Sizes[2][z];
+        m_Partitions.push_back(partition);
+      }
+    }
+  }
+  return true;
+}
+
+void PartitionedVolume::Route(const UploadCommand& cmd,
+                              std::vector<UploadCommand>& routed) const {
+  routed.clear();
+  for (size_t i = 0; i < m_Partitions.size(); ++i) {
+    const VolumePartition& partition = m_Partitions[i];
+    int32_t x0 = std::max(cmd.xoffset, partition.x);
+    int32_t y0 = std::max(cmd.yoffset, partition.y);
+    int32_t z0 = std::max(cmd.zoffset, partition.z);
+    int32_t x1 =
+        std::min(cmd.xoffset + cmd.width, partition.x + partition.width);
+    int32_t y1 =
+        std::min(cmd.yoffset + cmd.height, partition.y + partition.height);
+    int32_t z1 =
+        std::min(cmd.zoffset + cmd.depth, partition.z + partition.depth);
+    if (x0 >= x1 || y0 >= y1 || z0 >= z1) continue;
+
+    UploadCommand sub = cmd;
+    sub.texture_handle = partition.texture_handle;
+    sub.xoffset = x0 - partition.x;
+    sub.yoffset = y0 - partition.y;
+    sub.zoffset = z0 - partition.z;
+    sub.width = x1 - x0;
+    sub.height = y1 - y0;
+    sub.depth = z1 - z0;
+    // the source of the sub-box is a sub-box of cmd's source
+    sub.layout.row_length =
+        cmd.layout.row_length > 0 ? cmd.layout.row_length : cmd.width;
+    sub.layout.image_height =
+        cmd.layout.image_height > 0 ? cmd.layout.image_height : cmd.height;
+    sub.layout.skip_texels += x0 - cmd.xoffset;
+    sub.layout.skip_rows += y0 - cmd.yoffset;
+    sub.layout.skip_images += z0 - cmd.zoffset;
+    routed.push_back(sub);
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "Formats.h"
+#include "UploadQueue.h"
+
+/// @brief A native texture holding a box of a partitioned volume.
+struct VolumePartition {
+  void* texture_handle;
+  // box of the volume held by the texture, in texels
+  int32_t x;
+  int32_t y;
+  int32_t z;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+};
+
+/// @brief A logical volume split into several native textures because it
+/// exceeds the device's limits (GL_MAX_3D_TEXTURE_SIZE, the 2GB resource
+/// limit of Direct3D 11).
+///
+/// Partitions form a grid (x fastest) and neighbouring partitions overlap by
+/// one texel, so that a position can be filtered (trilinearly) within the
+/// single partition whose box contains its 2x2x2 footprint: partition i along
+/// an axis covers [start_i, start_i + size_i) with start_(i+1) = start_i +
+/// size_i - 1. Uploads in volume coordinates are routed to every partition
+/// they intersect, overlapping texels being uploaded to both partitions.
+class PartitionedVolume {
+ public:
+  PartitionedVolume();
+
+  /// @brief Computes the partition grid: as few partitions as possible along
+  /// each axis so that none exceeds the limits, splitting the longest
+  /// partition extent first. Texture handles are NULL until set.
+  /// @param max_dimension maximum extent of a native texture along an axis
+  /// @param max_bytes maximum size of a native texture
+  /// @return false if the volume cannot be split within the limits or the
+  /// format is block-compressed (partitions would not be block aligned)
+  bool Layout(int32_t width, int32_t height, int32_t depth, Format format,
+              int32_t max_dimension, uint64_t max_bytes);
+
+  /// @brief Splits an upload in volume coordinates into uploads to the
+  /// partitions it intersects, whose sources are sub-boxes of cmd's source.
+  /// @param routed receives the uploads
+  void Route(const UploadCommand& cmd,
+             std::vector<UploadCommand>& routed) const;
+
+  int32_t width() const { return m_Width; }
+  int32_t height() const { return m_Height; }
+  int32_t depth() const { return m_Depth; }
+  Format format() const { return m_Format; }
+
+  /// @brief Number of partitions along an axis (0: x, 1: y, 2: z).
+  int32_t count(int axis) const { return (int32_t)m_Starts[axis].size(); }
+
+  std::vector<VolumePartition>& partitions() { return m_Partitions; }
+  const std::vector<VolumePartition>& partitions() const {
+    return m_Partitions;
+  }
+
+ private:
+  int32_t m_Width;
+  int32_t m_Height;
+  int32_t m_Depth;
+  Format m_Format;
+  // start and extent of the partitions along each axis
+  std::vector<int32_t> m_Starts[3];
+  std::vector<int32_t> m_Sizes[3];
+  std::vector<VolumePartition> m_Partitions;
+};
@@ -0,0 +1,286 @@
+#include "ReadQueue.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "PlatformBase.h"
+
+#if UNITY_LINUX
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// IORING_OP_READ has been added along with IORING_FEAT_RW_CUR_POS (5.6)
+#if UNITY_LINUX && defined(__NR_io_uring_setup) && \
+    defined(IORING_FEAT_RW_CUR_POS)
+#define READ_QUEUE_SUPPORTED 1
+#else
+#define READ_QUEUE_SUPPORTED 0
+#endif
+
+// user_data of the no-op that wakes the completion thread up, reads use their
+// slot + 1
+static const uint64_t kWakeUp = ~0ull;
+
+ReadQueue::ReadQueue()
+    : m_Ring(-1),
+      m_Stopping(false),
+      m_SqRing(NULL),
+      m_SqRingSize(0),
+      m_CqRing(NULL),
+      m_CqRingSize(0),
+      m_Sqes(NULL),
+      m_SqesSize(0),
+      m_SqTail(NULL),
+      m_SqMask(0),
+      m_SqArray(NULL),
+      m_Unsubmitted(0),
+      m_InFlight(0),
+      m_CqHead(NULL),
+      m_CqTail(NULL),
+      m_CqMask(0),
+      m_Cqes(NULL) {}
+
+ReadQueue::~ReadQueue() { Shutdown(); }
+
+bool ReadQueue::IsRunning() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Ring >= 0 && !m_Stopping;
+}
+
+#if !READ_QUEUE_SUPPORTED
+bool ReadQueue::Start(uint32_t queue_depth) { return false; }
+
+void ReadQueue::Shutdown() {}
+
+void ReadQueue::Read(int fd, uint64_t offset, void* dst, size_t size,
+                     size_t min_size, const Callback& callback) {
+  callback(false);
+}
+#else
+bool ReadQueue::Start(uint32_t queue_depth) {
+  Shutdown();
+  if (queue_depth == 0) return false;
+
+  // one more entry for the wake-up no-op
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring = (int)syscall(__NR_io_uring_setup, queue_depth + 1, &params);
+  if (ring < 0) return false;
+
+  m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+  }
+  m_SqRing = mmap(NULL, m_SqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+  m_CqRing = single_mmap ? m_SqRing
+                         : mmap(NULL, m_CqRingSize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring,
+                                IORING_OFF_CQ_RING);
+  m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  m_Sqes = mmap(NULL, m_SqesSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+  if (m_SqRing == MAP_FAILED || m_CqRing == MAP_FAILED ||
+      m_Sqes == MAP_FAILED) {
+    if (m_Sqes != MAP_FAILED) munmap(m_Sqes, m_SqesSize);
+    if (!single_mmap && m_CqRing != MAP_FAILED) munmap(m_CqRing, m_CqRingSize);
+    if (m_SqRing != MAP_FAILED) munmap(m_SqRing, m_SqRingSize);
+    close(ring);
+    m_SqRing = m_CqRing = m_Sqes = NULL;
+    return false;
+  }
+
+  uint8_t* sq = (uint8_t*)m_SqRing;
+  m_SqTail = (uint32_t*)(sq + params.sq_off.tail);
+  m_SqMask = *(uint32_t*)(sq + params.sq_off.ring_mask);
+  m_SqArray = (uint32_t*)(sq + params.sq_off.array);
+  uint8_t* cq = (uint8_t*)m_CqRing;
+  m_CqHead = (uint32_t*)(cq + params.cq_off.head);
+  m_CqTail = (uint32_t*)(cq + params.cq_off.tail);
+  m_CqMask = *(uint32_t*)(cq + params.cq_off.ring_mask);
+  m_Cqes = cq + params.cq_off.cqes;
+  m_Unsubmitted = 0;
+  m_InFlight = 0;
+
+  m_Slots.assign(queue_depth, Request());
+  m_FreeSlots.clear();
+  for (uint32_t slot = queue_depth; slot > 0; --slot)
+    m_FreeSlots.push_back(slot - 1);
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stopping = false;
+    m_Ring = ring;
+  }
+  m_Thread = std::thread(&ReadQueue::Run, this);
+  return true;
+}
+
+void ReadQueue::Shutdown() {
+  std::deque<Request> backlog;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Ring < 0 || m_Stopping) return;
+    m_Stopping = true;
+    backlog.swap(m_Backlog);
+    SubmitWakeUp();
+  }
+  for (size_t i = 0; i < backlog.size(); ++i) backlog[i].callback(false);
+  m_Thread.join();
+
+  munmap(m_Sqes, m_SqesSize);
+  if (m_CqRing != m_SqRing) munmap(m_CqRing, m_CqRingSize);
+  munmap(m_SqRing, m_SqRingSize);
+  close(m_Ring);
+  m_SqRing = m_CqRing = m_Sqes = NULL;
+  m_Slots.clear();
+  m_FreeSlots.clear();
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Ring = -1;
+  m_Stopping = false;
+}
+
+void ReadQueue::Read(int fd, uint64_t offset, void* dst, size_t size,
+                     size_t min_size, const Callback& callback) {
+  Request request;
+  request.fd = fd;
+  request.offset = offset;
+  request.dst = (uint8_t*)dst;
+  request.size = size;
+  request.min_size = min_size;
+  request.done = 0;
+  request.callback = callback;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Ring >= 0 && !m_Stopping) {
+      if (m_FreeSlots.empty()) {
+        m_Backlog.push_back(request);
+      } else {
+        uint32_t slot = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+        m_Slots[slot] = request;
+        SubmitSlot(slot);
+      }
+      return;
+    }
+  }
+  callback(false);
+}
+
+/// @brief Returns the next free submission queue entry. Every read and the
+/// wake-up hold a slot, so the queue cannot be full.
+static io_uring_sqe* NextSqe(void* sqes, uint32_t tail, uint32_t mask) {
+  io_uring_sqe* sqe = (io_uring_sqe*)sqes + (tail & mask);
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void ReadQueue::SubmitSlot(uint32_t slot) {
+  const Request& request = m_Slots[slot];
+  uint32_t tail = *m_SqTail;
+  io_uring_sqe* sqe = NextSqe(m_Sqes, tail, m_SqMask);
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = request.fd;
+  sqe->off = request.offset + request.done;
+  sqe->addr = (uint64_t)(uintptr_t)(request.dst + request.done);
+  sqe->len = (uint32_t)(request.size - request.done);
+  sqe->user_data = slot + 1;
+  m_SqArray[tail & m_SqMask] = tail & m_SqMask;
+  __atomic_store_n(m_SqTail, tail + 1, __ATOMIC_RELEASE);
+  ++m_Unsubmitted;
+  Enter(0);
+}
+
+void ReadQueue::SubmitWakeUp() {
+  uint32_t tail = *m_SqTail;
+  io_uring_sqe* sqe = NextSqe(m_Sqes, tail, m_SqMask);
+  sqe->opcode = IORING_OP_NOP;
+  sqe->user_data = kWakeUp;
+  m_SqArray[tail & m_SqMask] = tail & m_SqMask;
+  __atomic_store_n(m_SqTail, tail + 1, __ATOMIC_RELEASE);
+  ++m_Unsubmitted;
+  Enter(0);
+}
+
+void ReadQueue::Enter(uint32_t min_complete) {
+  uint32_t to_submit = min_complete == 0 ? m_Unsubmitted : 0;
+  uint32_t flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+  for (;;) {
+    int submitted = (int)syscall(__NR_io_uring_enter, m_Ring, to_submit,
+                                 min_complete, flags, NULL, 0);
+    if (submitted >= 0) {
+      if (min_complete == 0) {
+        m_Unsubmitted -= (uint32_t)submitted;
+        m_InFlight += (uint32_t)submitted;
+      }
+      return;
+    }
+    if (errno == EINTR) continue;
+    // entries the kernel cannot take yet (EAGAIN: short of resources, EBUSY:
+    // completions to reap first) are submitted again by the completion
+    // thread, which only wakes up if entries are in flight
+    if (min_complete > 0 || (errno != EAGAIN && errno != EBUSY) ||
+        m_InFlight > 0)
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void ReadQueue::Run() {
+  bool poll = false;
+  for (;;) {
+    // completions are polled while entries wait to be submitted again
+    if (poll) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } else {
+      Enter(1);
+    }
+    uint32_t head = *m_CqHead;
+    uint32_t tail = __atomic_load_n(m_CqTail, __ATOMIC_ACQUIRE);
+    uint32_t reaped = tail - head;
+    for (; head != tail; ++head) {
+      const io_uring_cqe* cqe = (const io_uring_cqe*)m_Cqes + (head & m_CqMask);
+      uint64_t user_data = cqe->user_data;
+      int32_t result = cqe->res;
+      __atomic_store_n(m_CqHead, head + 1, __ATOMIC_RELEASE);
+      if (user_data != kWakeUp) Complete((uint32_t)(user_data - 1), result);
+    }
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_InFlight -= reaped;
+    if (m_Unsubmitted > 0) Enter(0);
+    poll = m_Unsubmitted > 0;
+    if (m_Stopping && m_FreeSlots.size() == m_Slots.size() && !poll) return;
+  }
+}
+
+void ReadQueue::Complete(uint32_t slot, int32_t result) {
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  Request& request = m_Slots[slot];
+  if (result > 0) {
+    request.done += (size_t)result;
+    if (request.done < request.min_size) {
+      SubmitSlot(slot);
+      return;
+    }
+  }
+  bool success = result >= 0 && request.done >= request.min_size;
+  Callback callback;
+  callback.swap(request.callback);
+  if (m_Backlog.empty()) {
+    m_FreeSlots.push_back(slot);
+  } else {
+    request = m_Backlog.front();
+    m_Backlog.pop_front();
+    SubmitSlot(slot);
+  }
+  lock.unlock();
+  callback(success);
+}
+#endif  // #if !READ_QUEUE_SUPPORTED
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Asynchronous positional file reads through io_uring (Linux 5.6+),
+/// issued with raw system calls so that no liburing is needed.
+///
+/// Up to queue_depth reads are kept in flight, the following ones wait in a
+/// backlog until a slot is free. Reads are submitted on the calling thread
+/// and a single native thread reaps their completions and calls their
+/// callbacks, so a single thread keeps the device busy without a thread per
+/// outstanding read. Files opened with O_DIRECT are read without going
+/// through the page cache if the offsets, sizes and buffers are aligned to
+/// the device's logical block size.
+///
+/// Not supported on other platforms or kernels (or if io_uring is disabled,
+/// e.g., by seccomp on Android): Start returns false and callers fall back
+/// to blocking reads.
+class ReadQueue {
+ public:
+  /// @brief Called on the completion thread once a read completed.
+  /// @param success whether at least min_size bytes have been read
+  typedef std::function<void(bool success)> Callback;
+
+  ReadQueue();
+  ~ReadQueue();
+
+  /// @brief Creates the ring and starts the completion thread. Stops a
+  /// running queue first.
+  /// @return false if io_uring is not available
+  bool Start(uint32_t queue_depth);
+
+  /// @brief Waits for the reads in flight, fails the reads of the backlog
+  /// and stops the completion thread.
+  void Shutdown();
+
+  /// @brief Whether the queue has been started. Reads of a queue that is not
+  /// running fail right away.
+  bool IsRunning();
+
+  /// @brief Queues a read of size bytes at offset of the file descriptor fd
+  /// into dst. Reads shorter than size (e.g., aligned O_DIRECT reads past the
+  /// end of the file) succeed if at least min_size bytes are read. fd and dst
+  /// must stay valid until the callback is called. Can be called from any
+  /// thread once started.
+  void Read(int fd, uint64_t offset, void* dst, size_t size, size_t min_size,
+            const Callback& callback);
+
+ private:
+  struct Request {
+    int fd;
+    uint64_t offset;
+    uint8_t* dst;
+    size_t size;
+    size_t min_size;
+    // bytes read by previous (short) reads
+    size_t done;
+    Callback callback;
+  };
+
+  ReadQueue(const ReadQueue&);
+  ReadQueue& operator=(const ReadQueue&);
+
+  /// @brief Writes the read of the remaining bytes of slot to the submission
+  /// queue and submits it. m_Mutex must be held.
+  void SubmitSlot(uint32_t slot);
+
+  /// @brief Submits a no-op that wakes the completion thread up. m_Mutex must
+  /// be held.
+  void SubmitWakeUp();
+
+  /// @brief Submits the entries not yet submitted (min_complete == 0,
+  /// m_Mutex must be held) or waits for min_complete completions.
+  void Enter(uint32_t min_complete);
+
+  /// @brief Reaps completions until stopped with no read in flight, and
+  /// submits again the entries the kernel could not take.
+  void Run();
+
+  /// @brief Handles the completion of a read. Reads it again from where it
+  /// stopped if it is short.
+  void Complete(uint32_t slot, int32_t result);
+
+  std::mutex m_Mutex;
+  // ring file descriptor, -1 if not started
+  int m_Ring;
+  std::thread m_Thread;
+  bool m_Stopping;
+
+  // memory mappings of the ring (the completion ring shares the submission
+  // ring's mapping on kernels with IORING_FEAT_SINGLE_MMAP)
+  void* m_SqRing;
+  size_t m_SqRingSize;
+  void* m_CqRing;
+  size_t m_CqRingSize;
+  void* m_Sqes;
+  size_t m_SqesSize;
+  // pointers into the mappings (struct io_uring_sqe/io_uring_cqe arrays)
+  uint32_t* m_SqTail;
+  uint32_t m_SqMask;
+  uint32_t* m_SqArray;
+  // entries written to the submission queue but not yet submitted
+  uint32_t m_Unsubmitted;
+  // entries submitted whose completions have not been reaped yet
+  uint32_t m_InFlight;
+  uint32_t* m_CqHead;
+  uint32_t* m_CqTail;
+  uint32_t m_CqMask;
+  void* m_Cqes;
+
+  std::vector<Request> m_Slots;
+  std::vector<uint32_t> m_FreeSlots;
+  std::deque<Request> m_Backlog;
+};
@@ -3,12 +3,58 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "Downsample.h"
+#include "Formats.h"
 #include "Unity/IUnityGraphics.h"
 #include "Unity/IUnityLog.h"
 
 struct IUnityInterfaces;
 
-enum Format { R8_UINT = 0, R16_UINT = 1 };
+/// @brief Layout of the source texels of an upload in host memory. Allows
+/// uploading any sub-box of a larger host volume without repacking it first.
+/// Same semantics as GL_UNPACK_ROW_LENGTH, GL_UNPACK_IMAGE_HEIGHT and
+/// GL_UNPACK_SKIP_*: a row_length (resp. image_height) of 0 means that rows
+/// (resp. slices) are tightly packed, i.e., of the upload's width (resp.
+/// height).
+struct SourceLayout {
+  int32_t row_length;    // texels per row of the host volume
+  int32_t image_height;  // rows per slice of the host volume
+  int32_t skip_texels;   // x offset of the sub-box within the host volume
+  int32_t skip_rows;     // y offset of the sub-box within the host volume
+  int32_t skip_images;   // z offset of the sub-box within the host volume
+};
+
+/// @brief Layout of a tightly packed source (i.e., all members set to 0).
+inline SourceLayout PackedSourceLayout() {
+  SourceLayout layout = {0, 0, 0, 0, 0};
+  return layout;
+}
+
+/// @brief Distance in bytes between two consecutive source rows.
+inline size_t SourceRowPitch(const SourceLayout& layout, int32_t width,
+                             uint32_t bytes_per_texel) {
+  return (size_t)(layout.row_length > 0 ? layout.row_length : width) *
+         bytes_per_texel;
+}
+
+/// @brief Distance in bytes between two consecutive source slices.
+inline size_t SourceSlicePitch(const SourceLayout& layout, int32_t width,
+                               int32_t height, uint32_t bytes_per_texel) {
+  return SourceRowPitch(layout, width, bytes_per_texel) *
+         (size_t)(layout.image_height > 0 ? layout.image_height : height);
+}
+
+/// @brief Address of the first source texel of the sub-box, i.e., data_ptr
+/// advanced by the layout's skip offsets.
+inline const uint8_t* SourceOrigin(const void* data_ptr,
+                                   const SourceLayout& layout, int32_t width,
+                                   int32_t height, uint32_t bytes_per_texel) {
+  return (const uint8_t*)data_ptr +
+         layout.skip_images *
+             SourceSlicePitch(layout, width, height, bytes_per_texel) +
+         layout.skip_rows * SourceRowPitch(layout, width, bytes_per_texel) +
+         (size_t)layout.skip_texels * bytes_per_texel;
+}
 
 extern IUnityInterfaces* g_UnityInterfaces;
 extern IUnityGraphics* g_Graphics;
@@ -18,8 +64,11 @@ class RenderAPI {
  public:
   virtual ~RenderAPI() {}
 
+  /// @brief Creates a 3D texture with mip_levels levels (see MipExtent),
+  /// texture is NULL if it cannot be created.
   virtual void CreateTexture3D(uint32_t width, uint32_t height, uint32_t depth,
-                               Format format, void*& texture) = 0;
+                               Format format, uint32_t mip_levels,
+                               void*& texture) = 0;
 
   virtual void ClearTexture3D(void* texture_handle) = 0;
 
@@ -52,6 +101,9 @@ class RenderAPI {
   /// @param height height of the source data
   /// @param depth depth of the source data
   /// @param data_ptr pointer to the data array in memory
+  /// @param layout layout of the source data within data_ptr. Maps to the
+  /// GL_UNPACK_* pixel store parameters on OpenGL and to the row/depth
+  /// pitches of UpdateSubresource on Direct3D 11.
   /// @param level will be provided to glTextureSubImage2D's level parameter.
   /// Only used in case graphics API is OpenGL.
   /// @param format will be provided to glTextureSubImage2D's format parameter.
@@ -59,8 +111,75 @@ class RenderAPI {
   virtual void TextureSubImage3D(void* texture_handle, int32_t xoffset,
                                  int32_t yoffset, int32_t zoffset,
                                  int32_t width, int32_t height, int32_t depth,
-                                 void* data_ptr, int32_t level,
-                                 Format format) = 0;
+                                 void* data_ptr, const SourceLayout& layout,
+                                 int32_t level, Format format) = 0;
+
+  /// @brief Decodes a brick encoded with the delta codec (see DeltaCodec.h)
+  /// on the GPU and writes it into a sub-region of a 3D texture, so that only
+  /// the bit-packed payload has to be transferred. The extents of the
+  /// sub-region are the brick's.
+  /// @param encoded_ptr encoded brick, only read during the call
+  /// @param format R16_UINT or R16UI
+  /// @return false if the backend cannot decode the brick on the GPU, the
+  /// caller then has to decode it on the CPU
+  virtual bool TextureSubImage3DDeltaR16(void* texture_handle, int32_t xoffset,
+                                         int32_t yoffset, int32_t zoffset,
+                                         const void* encoded_ptr,
+                                         size_t encoded_size, int32_t level,
+                                         Format format) {
+    return false;
+  }
+
+  /// @brief Windows a sub-region of a 16-bit 3D texture into the same
+  /// sub-region of an R8_UINT 3D texture on the GPU (see
+  /// ConvertUInt16ToUInt8Window): low maps to 0, high maps to 255.
+  /// @param src_format R16_UINT or R16UI, format of src_handle
+  /// @return false if the backend cannot window on the GPU
+  virtual bool WindowTexture3D(void* src_handle, void* dst_handle,
+                               int32_t xoffset, int32_t yoffset,
+                               int32_t zoffset, int32_t width, int32_t height,
+                               int32_t depth, int32_t level, Format src_format,
+                               uint16_t low, uint16_t high) {
+    return false;
+  }
+
+  /// @brief Whether DownsampleTexture3D supports a format and filter.
+  virtual bool SupportsDownsampling(Format format, DownsampleFilter filter) {
+    return false;
+  }
+
+  /// @brief Recomputes a box of a mip level of a 3D texture from the level
+  /// below it on the GPU (see Downsample2x): every texel combines its 2x2x2
+  /// children, clamped to the extents of the finer level.
+  /// @param level level to write, at least 1
+  /// @return false if the backend cannot downsample on the GPU
+  virtual bool DownsampleTexture3D(void* texture_handle, int32_t xoffset,
+                                   int32_t yoffset, int32_t zoffset,
+                                   int32_t width, int32_t height,
+                                   int32_t depth, int32_t level, Format format,
+                                   DownsampleFilter filter) {
+    return false;
+  }
+
+  /// @brief Queries the video memory of the device through driver
+  /// extensions (GL_NVX_gpu_memory_info, GL_ATI_meminfo, DXGI 1.4).
+  /// @param total_bytes dedicated video memory, 0 if not reported
+  /// @param available_bytes video memory currently available
+  /// @return false if the driver does not report its memory
+  virtual bool QueryVideoMemory(uint64_t& total_bytes,
+                                uint64_t& available_bytes) {
+    return false;
+  }
+
+  /// @brief Maximum extent of a 3D texture along an axis.
+  virtual int32_t MaxTexture3DSize() { return 2048; }
+
+  /// @brief Maximum size in bytes of a single texture.
+  virtual uint64_t MaxTextureBytes() { return UINT64_MAX; }
+
+  /// @brief Size in bytes of the GPU buffers the backend allocated for
+  /// itself (e.g., for GPU decoding).
+  virtual uint64_t InternalMemorySize() { return 0; }
 
   /// @brief to process general events like initialization,	shutdown, device
   /// loss/reset etc.
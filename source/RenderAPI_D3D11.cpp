@@ -5,7 +5,9 @@
 
 #include <assert.h>
 #include <d3d11.h>
+#include <dxgi1_4.h>
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -21,7 +23,8 @@ class RenderAPI_D3D11 : public RenderAPI {
                                   IUnityInterfaces* interfaces);
 
   virtual void CreateTexture3D(uint32_t width, uint32_t height, uint32_t depth,
-                               Format format, void*& texture);
+                               Format format, uint32_t mip_levels,
+                               void*& texture);
 
   virtual void ClearTexture3D(void* texture_handle);
 
@@ -32,12 +35,28 @@ class RenderAPI_D3D11 : public RenderAPI {
   virtual void TextureSubImage3D(void* texture_handle, int32_t xoffset,
                                  int32_t yoffset, int32_t zoffset,
                                  int32_t width, int32_t height, int32_t depth,
-                                 void* data_ptr, int32_t level, Format format);
+                                 void* data_ptr, const SourceLayout& layout,
+                                 int32_t level, Format format);
+
+  virtual bool QueryVideoMemory(uint64_t& total_bytes,
+                                uint64_t& available_bytes);
+
+  virtual int32_t MaxTexture3DSize();
+
+  virtual uint64_t MaxTextureBytes();
 
  private:
   ID3D11Device* m_Device;
 };
 
+#define DXGI_FORMAT_ENTRY(name, value, bytes, block, channels, kind, \
+                          gl_internal, gl_format, gl_type, dxgi, vk) \
+  dxgi,
+/// @brief DXGI equivalents of the Format values.
+static const DXGI_FORMAT kDXGIFormats[kFormatCount] = {
+    TEXTURE_FORMATS(DXGI_FORMAT_ENTRY)};
+#undef DXGI_FORMAT_ENTRY
+
 RenderAPI* CreateRenderAPI_D3D11() { return new RenderAPI_D3D11(); }
 
 RenderAPI_D3D11::RenderAPI_D3D11() : m_Device(NULL) {}
@@ -57,19 +76,10 @@ void RenderAPI_D3D11::TextureSubImage2D(void* texture_handle, int32_t xoffset,
                                         int32_t yoffset, int32_t width,
                                         int32_t height, void* data_ptr,
                                         int32_t level, Format format) {
-  // determine row pitch/depth from provided format
-  uint32_t row_pitch;
-  switch (format) {
-    case Format::R8_UINT:
-      row_pitch = width;  // width * sizeof(uint8_t)
-      break;
-    case Format::R16_UINT:
-      row_pitch = width * 2;  // width * sizeof(uint16_t)
-      break;
-    default:
-      return;
-      break;
-  }
+  // determine row pitch from provided format
+  uint32_t bytes_per_texel = BytesPerTexel(format);
+  if (bytes_per_texel == 0) return;
+  uint32_t row_pitch = width * bytes_per_texel;
 
   ID3D11Texture2D* d3dtex = (ID3D11Texture2D*)texture_handle;
   assert(d3dtex);
@@ -94,22 +104,25 @@ void RenderAPI_D3D11::TextureSubImage3D(void* texture_handle, int32_t xoffset,
                                         int32_t yoffset, int32_t zoffset,
                                         int32_t width, int32_t height,
                                         int32_t depth, void* data_ptr,
+                                        const SourceLayout& layout,
                                         int32_t level, Format format) {
-  // determine row pitch/depth from provided format
-  uint32_t row_pitch;
-  switch (format) {
-    case Format::R8_UINT:
-      row_pitch = width;  // width * sizeof(uint8_t)
-      break;
-    case Format::R16_UINT:
-      row_pitch = width * 2;  // width * sizeof(uint16_t)
-      break;
-    default:
-      return;
-      break;
+  // determine row pitch/depth from provided format and source layout.
+  // Sources of block-compressed formats are tightly packed rows of blocks.
+  uint32_t row_pitch, depth_pitch;
+  const uint8_t* src;
+  if (IsCompressedFormat(format)) {
+    row_pitch = (uint32_t)TextureDataSize(format, width, 1, 1);
+    depth_pitch = (uint32_t)TextureDataSize(format, width, height, 1);
+    src = (const uint8_t*)data_ptr;
+  } else {
+    uint32_t bytes_per_texel = BytesPerTexel(format);
+    if (bytes_per_texel == 0) return;
+    row_pitch = (uint32_t)SourceRowPitch(layout, width, bytes_per_texel);
+    depth_pitch =
+        (uint32_t)SourceSlicePitch(layout, width, height, bytes_per_texel);
+    src = SourceOrigin(data_ptr, layout, width, height, bytes_per_texel);
   }
 
-  uint32_t depth_pitch = height * row_pitch;
   ID3D11Texture2D* d3dtex = (ID3D11Texture2D*)texture_handle;
   assert(d3dtex);
   ID3D11DeviceContext* ctx = NULL;
@@ -123,46 +136,45 @@ void RenderAPI_D3D11::TextureSubImage3D(void* texture_handle, int32_t xoffset,
   box.bottom = yoffset + height;
   box.back = zoffset + depth;
 
-  ctx->UpdateSubresource(d3dtex, 0, &box, data_ptr, row_pitch, depth_pitch);
+  // the subresources of a 3D texture are its mip levels
+  ctx->UpdateSubresource(d3dtex, (UINT)level, &box, src, row_pitch,
+                         depth_pitch);
   ctx->Release();
 }
 
 // google: direct3d 11 resources limits
 void RenderAPI_D3D11::CreateTexture3D(uint32_t width, uint32_t height,
                                       uint32_t depth, Format format,
-                                      void*& texture) {
-  uint32_t size_in_bytes;
+                                      uint32_t mip_levels, void*& texture) {
+  uint64_t size_in_bytes;
   D3D11_TEXTURE3D_DESC desc;
   desc.Width = width;
   desc.Height = height;
   desc.Depth = depth;
-  desc.MipLevels = 1;
-  switch (format) {
-    case R8_UINT:
-      desc.Format = DXGI_FORMAT_R8_UNORM;
-      size_in_bytes = width * height * depth;
-      break;
-    case R16_UINT:
-      desc.Format = DXGI_FORMAT_R16_UNORM;
-      size_in_bytes = width * height * depth * 2;
-      break;
-    default:
-      texture = NULL;
-      return;
-      break;
+  desc.MipLevels = mip_levels;
+  if (!IsValidFormat(format) || mip_levels == 0) {
+    texture = NULL;
+    return;
   }
+  desc.Format = kDXGIFormats[format];
+  size_in_bytes = MipChainDataSize(format, (int32_t)width, (int32_t)height,
+                                   (int32_t)depth, (int32_t)mip_levels);
   desc.Usage = D3D11_USAGE_DEFAULT;
   desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
   desc.CPUAccessFlags = 0;
   desc.MiscFlags = 0;
 
-  if (size_in_bytes > D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM) {
+  if (size_in_bytes > MaxTextureBytes() ||
+      width > D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION ||
+      height > D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION ||
+      depth > D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION) {
     std::ostringstream msg;
     msg << "Texture size exceeds Direct3D 11/12 max resource size. Texture "
            "Size: "
         << size_in_bytes / (1024 * 1024) << "MB"
-        << " Max: " << D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM
-        << "MB";
+        << " Max: " << MaxTextureBytes() / (1024 * 1024) << "MB and "
+        << D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION
+        << " texels per axis, create a partitioned texture instead";
     UNITY_LOG_ERROR(g_Log, msg.str().c_str());
     texture = NULL;
     return;
@@ -191,8 +203,58 @@ void RenderAPI_D3D11::CreateTexture3D(uint32_t width, uint32_t height,
 void RenderAPI_D3D11::ClearTexture3D(void* texture_handle) {
   ID3D11Texture3D* d3dtex = (ID3D11Texture3D*)texture_handle;
   assert(d3dtex);
-  // TODO: is this the correct way to release a resource in Direct3D 11?
-  // d3dtex->Release();
+  // drops the only reference, taken by CreateTexture3D (the GPU memory
+  // budget counts the texture's bytes as free from now on)
+  d3dtex->Release();
+}
+
+bool RenderAPI_D3D11::QueryVideoMemory(uint64_t& total_bytes,
+                                       uint64_t& available_bytes) {
+  if (!m_Device) return false;
+  IDXGIDevice* dxgi_device = NULL;
+  IDXGIAdapter* adapter = NULL;
+  IDXGIAdapter3* adapter3 = NULL;
+  bool reported = false;
+  // DXGI 1.4 (Windows 10) reports the process' video memory budget
+  if (SUCCEEDED(m_Device->QueryInterface(__uuidof(IDXGIDevice),
+                                         (void**)&dxgi_device)) &&
+      SUCCEEDED(dxgi_device->GetAdapter(&adapter)) &&
+      SUCCEEDED(adapter->QueryInterface(__uuidof(IDXGIAdapter3),
+                                        (void**)&adapter3))) {
+    DXGI_ADAPTER_DESC desc;
+    DXGI_QUERY_VIDEO_MEMORY_INFO info;
+    if (SUCCEEDED(adapter3->GetDesc(&desc)) &&
+        SUCCEEDED(adapter3->QueryVideoMemoryInfo(
+            0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info))) {
+      total_bytes = desc.DedicatedVideoMemory;
+      available_bytes =
+          info.Budget > info.CurrentUsage ? info.Budget - info.CurrentUsage : 0;
+      reported = true;
+    }
+  }
+  if (adapter3) adapter3->Release();
+  if (adapter) adapter->Release();
+  if (dxgi_device) dxgi_device->Release();
+  return reported;
+}
+
+int32_t RenderAPI_D3D11::MaxTexture3DSize() {
+  return D3D11_REQ_TEXTURE3D_U_V_OR_W_DIMENSION;
+}
+
+uint64_t RenderAPI_D3D11::MaxTextureBytes() {
+  // max(128MB, min(a quarter of the video memory, 2048MB))
+  uint64_t megabytes = D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_B_TERM;
+  uint64_t total_bytes = 0, available_bytes = 0;
+  if (QueryVideoMemory(total_bytes, available_bytes) && total_bytes > 0) {
+    uint64_t quarter =
+        (uint64_t)(D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_A_TERM *
+                   (total_bytes / (1024 * 1024)));
+    megabytes = std::max<uint64_t>(
+        D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM,
+        std::min<uint64_t>(quarter, megabytes));
+  }
+  return megabytes * 1024 * 1024;
 }
 
 #endif  // #if SUPPORT_D3D11
@@ -1,6 +1,10 @@
+#include <string.h>
+
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "DeltaCodec.h"
 #include "PlatformBase.h"
 #include "RenderAPI.h"
 
@@ -36,6 +40,14 @@
 #error Unknown platform
 #endif
 
+// compute shaders, shader storage buffers and image load/store (GL 4.3) are
+// only declared by the desktop GL headers
+#if defined(GL_COMPUTE_SHADER) && defined(GL_SHADER_STORAGE_BUFFER)
+#define SUPPORT_GL_COMPUTE 1
+#else
+#define SUPPORT_GL_COMPUTE 0
+#endif
+
 class RenderAPI_OpenGLCoreES : public RenderAPI {
  public:
   RenderAPI_OpenGLCoreES(UnityGfxRenderer apiType);
@@ -45,7 +57,8 @@ class RenderAPI_OpenGLCoreES : public RenderAPI {
                                   IUnityInterfaces* interfaces);
 
   virtual void CreateTexture3D(uint32_t width, uint32_t height, uint32_t depth,
-                               Format format, void*& texture);
+                               Format format, uint32_t mip_levels,
+                               void*& texture);
 
   virtual void ClearTexture3D(void* texture_handle);
 
@@ -56,18 +69,106 @@ class RenderAPI_OpenGLCoreES : public RenderAPI {
   virtual void TextureSubImage3D(void* texture_handle, int32_t xoffset,
                                  int32_t yoffset, int32_t zoffset,
                                  int32_t width, int32_t height, int32_t depth,
-                                 void* data_ptr, int32_t level, Format format);
+                                 void* data_ptr, const SourceLayout& layout,
+                                 int32_t level, Format format);
+
+  virtual bool TextureSubImage3DDeltaR16(void* texture_handle, int32_t xoffset,
+                                         int32_t yoffset, int32_t zoffset,
+                                         const void* encoded_ptr,
+                                         size_t encoded_size, int32_t level,
+                                         Format format);
+
+  virtual bool WindowTexture3D(void* src_handle, void* dst_handle,
+                               int32_t xoffset, int32_t yoffset,
+                               int32_t zoffset, int32_t width, int32_t height,
+                               int32_t depth, int32_t level, Format src_format,
+                               uint16_t low, uint16_t high);
+
+  virtual bool SupportsDownsampling(Format format, DownsampleFilter filter);
+
+  virtual bool DownsampleTexture3D(void* texture_handle, int32_t xoffset,
+                                   int32_t yoffset, int32_t zoffset,
+                                   int32_t width, int32_t height,
+                                   int32_t depth, int32_t level, Format format,
+                                   DownsampleFilter filter);
+
+  virtual bool QueryVideoMemory(uint64_t& total_bytes,
+                                uint64_t& available_bytes);
+
+  virtual uint64_t InternalMemorySize();
+
+  virtual int32_t MaxTexture3DSize();
 
  private:
+  // compute programs, one per 16-bit format of the image they read or write
+  enum ComputeProgram {
+    kDecodeR16 = 0,
+    kDecodeR16UI = 1,
+    kWindowR16 = 2,
+    kWindowR16UI = 3,
+    kComputeProgramCount = 4
+  };
+
+  /// @brief Compiles the compute programs on first use.
+  /// @return whether the context supports compute shaders
+  bool InitializeCompute();
+
+  /// @brief Deletes the compute programs and buffers.
+  void ReleaseCompute();
+
+  /// @brief Whether the context exposes an extension.
+  bool HasExtension(const char* name);
+
+  // driver extension reporting the video memory
+  enum MemoryInfo {
+    kMemoryInfoUnknown = 0,
+    kMemoryInfoNone = 1,
+    kMemoryInfoNVX = 2,
+    kMemoryInfoATI = 3
+  };
+
   UnityGfxRenderer m_APIType;
+
+  // compute programs (GPU decoding and windowing), set up on first use
+  bool m_ComputeInitialized;
+  bool m_ComputeSupported;
+  GLuint m_ComputePrograms[kComputeProgramCount];
+  // mip downsampling programs per format and filter, compiled on first use
+  GLuint m_DownsamplePrograms[kFormatCount][3];
+  GLuint m_DecodeBuffers[2];  // payload and scratch shader storage buffers
+  size_t m_DecodeBufferSizes[2];
+  std::vector<uint32_t> m_BlockOffsets;
+  MemoryInfo m_MemoryInfo;
 };
 
+/// @brief OpenGL equivalent of a Format.
+struct GLFormat {
+  GLint internal_format;
+  GLenum format;
+  GLenum type;
+};
+
+#define GL_FORMAT_ENTRY(name, value, bytes, block, channels, kind, \
+                        gl_internal, gl_format, gl_type, dxgi, vk) \
+  {gl_internal, gl_format, gl_type},
+static const GLFormat kGLFormats[kFormatCount] = {
+    TEXTURE_FORMATS(GL_FORMAT_ENTRY)};
+#undef GL_FORMAT_ENTRY
+
 RenderAPI* CreateRenderAPI_OpenGLCoreES(UnityGfxRenderer apiType) {
   return new RenderAPI_OpenGLCoreES(apiType);
 }
 
 RenderAPI_OpenGLCoreES::RenderAPI_OpenGLCoreES(UnityGfxRenderer apiType)
-    : m_APIType(apiType) {}
+    : m_APIType(apiType),
+      m_ComputeInitialized(false),
+      m_ComputeSupported(false),
+      m_MemoryInfo(kMemoryInfoUnknown) {
+  for (int i = 0; i < kComputeProgramCount; ++i) m_ComputePrograms[i] = 0;
+  memset(m_DownsamplePrograms, 0, sizeof(m_DownsamplePrograms));
+  m_DecodeBuffers[0] = m_DecodeBuffers[1] = 0;
+  m_DecodeBufferSizes[0] = m_DecodeBufferSizes[1] = 0;
+}
 
 void RenderAPI_OpenGLCoreES::ProcessDeviceEvent(UnityGfxDeviceEventType type,
                                                 IUnityInterfaces* interfaces) {
@@ -95,6 +196,7 @@ void RenderAPI_OpenGLCoreES::ProcessDeviceEvent(UnityGfxDeviceEventType type,
 #ifdef DEBUG
     UNITY_LOG(g_Log, "kUnityGfxDeviceEventShutdown");
 #endif
+    ReleaseCompute();
   } else if (type == kUnityGfxDeviceEventAfterReset) {
 #ifdef DEBUG
     UNITY_LOG(g_Log, "kUnityGfxDeviceEventAfterReset");
@@ -102,43 +204,554 @@ void RenderAPI_OpenGLCoreES::ProcessDeviceEvent(UnityGfxDeviceEventType type,
   }
 }
 
+/// @brief glTexSubImage3D with the unpack state set up for the source layout.
+static void TextureSubImage3DUncompressed(GLuint gltex, int32_t xoffset,
+                                          int32_t yoffset, int32_t zoffset,
+                                          int32_t width, int32_t height,
+                                          int32_t depth, void* data_ptr,
+                                          const SourceLayout& layout,
+                                          int32_t level, Format format) {
+  const GLFormat& glformat = kGLFormats[format];
+
+  // only touch the unpack state if needed, it is reset to the GL defaults (0)
+  // afterwards so that it does not leak into Unity's own uploads
+  bool strided = layout.row_length != 0 || layout.image_height != 0 ||
+                 layout.skip_texels != 0 || layout.skip_rows != 0 ||
+                 layout.skip_images != 0;
+  if (strided) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, layout.row_length);
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, layout.image_height);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, layout.skip_texels);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, layout.skip_rows);
+    glPixelStorei(GL_UNPACK_SKIP_IMAGES, layout.skip_images);
+  }
+  // rows of e.g. odd widths of 2-byte formats are not 4-byte aligned (the
+  // default GL_UNPACK_ALIGNMENT)
+  bool unaligned =
+      SourceRowPitch(layout, width, BytesPerTexel(format)) % 4 != 0;
+  if (unaligned) glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  glBindTexture(GL_TEXTURE_3D, gltex);
+  glTexSubImage3D(GL_TEXTURE_3D, level, xoffset, yoffset, zoffset, width,
+                  height, depth, glformat.format, glformat.type, data_ptr);
+
+  if (strided) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0);
+  }
+  if (unaligned) glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
 void RenderAPI_OpenGLCoreES::TextureSubImage3D(void* texture_handle,
                                                int32_t xoffset, int32_t yoffset,
                                                int32_t zoffset, int32_t width,
                                                int32_t height, int32_t depth,
-                                               void* data_ptr, int32_t level,
-                                               Format format) {
+                                               void* data_ptr,
+                                               const SourceLayout& layout,
+                                               int32_t level, Format format) {
   GLuint gltex = (GLuint)(size_t)(texture_handle);
 
-  GLenum gltype;
+  if (!IsValidFormat(format)) return;
+  const GLFormat& glformat = kGLFormats[format];
+
+  if (IsCompressedFormat(format)) {
+    // compressed textures are 2D arrays (GL does not allow RGTC in 3D
+    // textures) and their sources are tightly packed blocks
+    glBindTexture(GL_TEXTURE_2D_ARRAY, gltex);
+    glCompressedTexSubImage3D(
+        GL_TEXTURE_2D_ARRAY, level, xoffset, yoffset, zoffset, width, height,
+        depth, glformat.internal_format,
+        (GLsizei)TextureDataSize(format, width, height, depth), data_ptr);
+  } else {
+    TextureSubImage3DUncompressed(gltex, xoffset, yoffset, zoffset, width,
+                                  height, depth, data_ptr, layout, level,
+                                  format);
+  }
+
+  GLenum err;
+  if ((err = glGetError()) != GL_NO_ERROR) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << " error(s): 0x" << std::hex << err;
+    while ((err = glGetError()) != GL_NO_ERROR) {
+      ss << " 0x" << err;
+    }
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return;
+  }
+}
+
+#if SUPPORT_GL_COMPUTE
+
+// Decodes a delta-coded brick (see DeltaCodec.h) in three passes, each
+// invocation integrating one line of texels: pass 0 unpacks the residuals of
+// a row and sums them along x into the scratch buffer, pass 1 sums the
+// columns along y in place and pass 2 sums along z and writes the texels into
+// the image. The payload buffer holds the word offsets of the blocks (one more
+// than there are blocks, so that bit widths are offset differences) followed
+// by the packed blocks.
+static const char* kDecodeShaderSource = R"(
+layout(local_size_x = 64) in;
+layout(std430, binding = 0) readonly buffer Payload { uint payload[]; };
+layout(std430, binding = 1) buffer Scratch { uint scratch[]; };
+layout(binding = 0, IMAGE_FORMAT) writeonly uniform IMAGE_TYPE volume;
+uniform uvec3 u_Size;
+uniform ivec3 u_Offset;
+uniform int u_Pass;
+uniform uint u_Blocks;
+
+uint Word(uint w) {
+  uint u = payload[u_Blocks + 1u + (w >> 1)];
+  return (w & 1u) != 0u ? u >> 16 : u & 0xFFFFu;
+}
+
+uint Residual(uint i) {
+  uint block = i >> 7, j = i & 127u;
+  uint offset = payload[block];
+  uint bits = (payload[block + 1u] - offset) >> 3;
+  if (bits == 0u) return 0u;
+  uint bit = (j >> 3) * bits, shift = bit & 15u;
+  uint w = offset + 8u * (bit >> 4) + (j & 7u);
+  uint v = Word(w) >> shift;
+  if (shift + bits > 16u) v |= Word(w + 8u) << (16u - shift);
+  v &= (1u << bits) - 1u;
+  return (v >> 1) ^ (0u - (v & 1u));
+}
+
+void main() {
+  uint id = gl_GlobalInvocationID.x;
+  uint w = u_Size.x, h = u_Size.y, d = u_Size.z;
+  uint sum = 0u;
+  if (u_Pass == 0) {
+    if (id >= h * d) return;
+    for (uint x = 0u; x < w; ++x) {
+      sum += Residual(id * w + x);
+      scratch[id * w + x] = sum & 0xFFFFu;
+    }
+  } else if (u_Pass == 1) {
+    if (id >= w * d) return;
+    uint i = (id / w) * w * h + id % w;
+    for (uint y = 0u; y < h; ++y, i += w) {
+      sum += scratch[i];
+      scratch[i] = sum & 0xFFFFu;
+    }
+  } else {
+    if (id >= w * h) return;
+    ivec3 texel = u_Offset + ivec3(int(id % w), int(id / w), 0);
+    for (uint z = 0u; z < d; ++z, ++texel.z) {
+      sum += scratch[z * w * h + id];
+      imageStore(volume, texel, STORE(sum & 0xFFFFu));
+    }
+  }
+}
+)";
+
+// Windows a box of a 16-bit image into an r8 image, with the scale and bias
+// of ConvertUInt16ToUInt8Window. Each invocation windows one texel.
+static const char* kWindowShaderSource = R"(
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+layout(binding = 1, IMAGE_FORMAT) readonly uniform IMAGE_TYPE source;
+layout(binding = 0, r8) writeonly uniform image3D windowed;
+uniform uvec3 u_Size;
+uniform ivec3 u_Offset;
+uniform float u_Scale;
+uniform float u_Bias;
+
+void main() {
+  if (any(greaterThanEqual(gl_GlobalInvocationID, u_Size))) return;
+  ivec3 texel = u_Offset + ivec3(gl_GlobalInvocationID);
+  float v = float(LOAD(imageLoad(source, texel).r)) * u_Scale + u_Bias;
+  imageStore(windowed, texel, vec4(clamp(roundEven(v), 0.0, 255.0) / 255.0));
+}
+)";
+
+// Recomputes a box of a mip level from the level below it (bound as
+// children). Each invocation combines the 2x2x2 children of one texel,
+// clamped to the extents of the finer level.
+static const char* kDownsampleShaderSource = R"(
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+layout(binding = 1, IMAGE_FORMAT) readonly uniform IMAGE_TYPE children;
+layout(binding = 0, IMAGE_FORMAT) writeonly uniform IMAGE_TYPE parents;
+uniform uvec3 u_Size;
+uniform ivec3 u_Offset;
+
+void main() {
+  if (any(greaterThanEqual(gl_GlobalInvocationID, u_Size))) return;
+  ivec3 texel = u_Offset + ivec3(gl_GlobalInvocationID);
+  ivec3 first = 2 * texel, last = imageSize(children) - 1;
+  TEXEL result = imageLoad(children, first);
+  for (int i = 1; i < 8; ++i) {
+    ivec3 child = min(first + ivec3(i & 1, (i >> 1) & 1, i >> 2), last);
+    result = COMBINE(result, imageLoad(children, child));
+  }
+  imageStore(parents, texel, STORE(result));
+}
+)";
+
+static const uint32_t kDecodeGroupSize = 64;
+static const uint32_t kWindowGroupSize = 4;
+static const uint32_t kDownsampleGroupSize = 4;
+
+// marks downsampling programs that failed to compile
+static const GLuint kFailedProgram = ~0u;
+
+/// @brief GLSL image format qualifier of an uncompressed format.
+/// @return NULL for block-compressed formats
+static const char* ImageFormatQualifier(Format format) {
   switch (format) {
-    case Format::R8_UINT:
-      gltype = GL_UNSIGNED_BYTE;
-      break;
-    case Format::R16_UINT:
-      gltype = GL_UNSIGNED_SHORT;
-      break;
+    case R8_UINT:
+      return "r8";
+    case R16_UINT:
+      return "r16";
+    case R16F:
+      return "r16f";
+    case R32F:
+      return "r32f";
+    case RG8:
+      return "rg8";
+    case RG16:
+      return "rg16";
+    case RGBA8:
+      return "rgba8";
+    case R16_SNORM:
+      return "r16_snorm";
+    case R16UI:
+      return "r16ui";
+    case R32UI:
+      return "r32ui";
     default:
-      return;
-      break;
+      return NULL;
   }
+}
 
-  glBindTexture(GL_TEXTURE_3D, gltex);
-  glTexSubImage3D(GL_TEXTURE_3D, level, xoffset, yoffset, zoffset, width,
-                  height, depth, GL_RED, gltype, data_ptr);
+/// @brief Compiles a compute program for an image format.
+/// @param store expression converting uint v to a texel of the image
+/// @param load expression converting texel v of the image to uint
+/// @param defines additional preprocessor definitions, one per line
+/// @return 0 (and logs the info log) on failure
+static GLuint CompileComputeProgram(const char* source,
+                                    const char* image_format,
+                                    const char* image_type, const char* store,
+                                    const char* load,
+                                    const char* defines = "") {
+  std::ostringstream header;
+  header << "#version 430\n"
+         << "#define IMAGE_FORMAT " << image_format << "\n"
+         << "#define IMAGE_TYPE " << image_type << "\n"
+         << "#define STORE(v) " << store << "\n"
+         << "#define LOAD(v) " << load << "\n"
+         << defines;
+  std::string prefix = header.str();
+  const char* sources[2] = {prefix.c_str(), source};
+
+  GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+  glShaderSource(shader, 2, sources, NULL);
+  glCompileShader(shader);
+  GLuint program = glCreateProgram();
+  glAttachShader(program, shader);
+  glLinkProgram(program);
+  glDeleteShader(shader);
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    GLchar log[1024] = {0};
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": " << image_format << " program: " << log;
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+bool RenderAPI_OpenGLCoreES::InitializeCompute() {
+  if (m_ComputeInitialized) return m_ComputeSupported;
+  m_ComputeInitialized = true;
+
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (m_APIType != kUnityGfxRendererOpenGLCore ||
+      major * 10 + minor < 43) {
+    return false;
+  }
+
+  // r16 images are loaded/stored as normalized floats
+  const char* kUnormStore = "vec4(float(v) / 65535.0)";
+  const char* kUnormLoad = "uint(round(v * 65535.0))";
+  m_ComputePrograms[kDecodeR16] = CompileComputeProgram(
+      kDecodeShaderSource, "r16", "image3D", kUnormStore, kUnormLoad);
+  m_ComputePrograms[kDecodeR16UI] = CompileComputeProgram(
+      kDecodeShaderSource, "r16ui", "uimage3D", "uvec4(v)", "v");
+  m_ComputePrograms[kWindowR16] = CompileComputeProgram(
+      kWindowShaderSource, "r16", "image3D", kUnormStore, kUnormLoad);
+  m_ComputePrograms[kWindowR16UI] = CompileComputeProgram(
+      kWindowShaderSource, "r16ui", "uimage3D", "uvec4(v)", "v");
+  for (int i = 0; i < kComputeProgramCount; ++i) {
+    if (!m_ComputePrograms[i]) {
+      ReleaseCompute();
+      m_ComputeInitialized = true;
+      return false;
+    }
+  }
+  glGenBuffers(2, m_DecodeBuffers);
+  m_ComputeSupported = true;
+  return true;
+}
 
+void RenderAPI_OpenGLCoreES::ReleaseCompute() {
+  for (int i = 0; i < kComputeProgramCount; ++i) {
+    if (m_ComputePrograms[i]) glDeleteProgram(m_ComputePrograms[i]);
+    m_ComputePrograms[i] = 0;
+  }
+  for (uint32_t f = 0; f < kFormatCount; ++f) {
+    for (int i = 0; i < 3; ++i) {
+      GLuint program = m_DownsamplePrograms[f][i];
+      if (program && program != kFailedProgram) glDeleteProgram(program);
+      m_DownsamplePrograms[f][i] = 0;
+    }
+  }
+  if (m_DecodeBuffers[0]) glDeleteBuffers(2, m_DecodeBuffers);
+  m_DecodeBuffers[0] = m_DecodeBuffers[1] = 0;
+  m_DecodeBufferSizes[0] = m_DecodeBufferSizes[1] = 0;
+  m_ComputeInitialized = false;
+  m_ComputeSupported = false;
+}
+
+/// @brief Logs (and clears) the pending GL errors.
+static void LogComputeErrors(const char* function) {
   GLenum err;
   if ((err = glGetError()) != GL_NO_ERROR) {
     std::ostringstream ss;
-    ss << __FUNCTION__ << " error(s): 0x" << std::hex << err;
+    ss << function << " error(s): 0x" << std::hex << err;
     while ((err = glGetError()) != GL_NO_ERROR) {
       ss << " 0x" << err;
     }
     UNITY_LOG_ERROR(g_Log, ss.str().c_str());
-    return;
   }
 }
 
+bool RenderAPI_OpenGLCoreES::TextureSubImage3DDeltaR16(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    const void* encoded_ptr, size_t encoded_size, int32_t level,
+    Format format) {
+  if (format != R16_UINT && format != R16UI) return false;
+  DeltaCodecHeader header;
+  size_t data_offset;
+  if (!ReadDeltaR16Header(encoded_ptr, encoded_size, header, data_offset))
+    return false;
+  if (!InitializeCompute()) return false;
+
+  // word offsets of the blocks, the packed blocks follow them
+  const uint8_t* widths = (const uint8_t*)encoded_ptr + sizeof(header);
+  uint32_t width = header.width, height = header.height, depth = header.depth;
+  size_t texels = (size_t)width * height * depth;
+  size_t blocks = (texels + kDeltaCodecBlockSize - 1) / kDeltaCodecBlockSize;
+  m_BlockOffsets.resize(blocks + 1);
+  m_BlockOffsets[0] = 0;
+  for (size_t b = 0; b < blocks; ++b)
+    m_BlockOffsets[b + 1] = m_BlockOffsets[b] + 8 * widths[b];
+  size_t offsets_size = m_BlockOffsets.size() * sizeof(uint32_t);
+  size_t packed_size = encoded_size - data_offset;
+
+  // the payload buffer is orphaned for every brick, the scratch buffer only
+  // grows
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_DecodeBuffers[0]);
+  m_DecodeBufferSizes[0] = offsets_size + packed_size + sizeof(uint32_t);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, m_DecodeBufferSizes[0], NULL,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, offsets_size,
+                  &m_BlockOffsets[0]);
+  if (packed_size > 0) {
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, offsets_size, packed_size,
+                    (const uint8_t*)encoded_ptr + data_offset);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_DecodeBuffers[1]);
+  if (m_DecodeBufferSizes[1] < texels * sizeof(uint32_t)) {
+    m_DecodeBufferSizes[1] = texels * sizeof(uint32_t);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_DecodeBufferSizes[1], NULL,
+                 GL_DYNAMIC_COPY);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  GLint previous_program = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+  GLuint program =
+      m_ComputePrograms[format == R16UI ? kDecodeR16UI : kDecodeR16];
+  glUseProgram(program);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_DecodeBuffers[0]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_DecodeBuffers[1]);
+  glBindImageTexture(0, (GLuint)(size_t)texture_handle, level, GL_TRUE, 0,
+                     GL_WRITE_ONLY, kGLFormats[format].internal_format);
+  glUniform3ui(glGetUniformLocation(program, "u_Size"), width, height, depth);
+  glUniform3i(glGetUniformLocation(program, "u_Offset"), xoffset, yoffset,
+              zoffset);
+  glUniform1ui(glGetUniformLocation(program, "u_Blocks"), (GLuint)blocks);
+  GLint pass = glGetUniformLocation(program, "u_Pass");
+
+  // lines integrated by each pass: rows, columns along y, columns along z
+  size_t lines[3] = {(size_t)height * depth, (size_t)width * depth,
+                     (size_t)width * height};
+  for (int i = 0; i < 3; ++i) {
+    glUniform1i(pass, i);
+    glDispatchCompute(
+        (GLuint)((lines[i] + kDecodeGroupSize - 1) / kDecodeGroupSize), 1, 1);
+    glMemoryBarrier(i < 2 ? GL_SHADER_STORAGE_BARRIER_BIT
+                          : GL_TEXTURE_FETCH_BARRIER_BIT |
+                                GL_TEXTURE_UPDATE_BARRIER_BIT |
+                                GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  }
+
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+  glUseProgram((GLuint)previous_program);
+
+  LogComputeErrors(__FUNCTION__);
+  return true;
+}
+
+bool RenderAPI_OpenGLCoreES::WindowTexture3D(
+    void* src_handle, void* dst_handle, int32_t xoffset, int32_t yoffset,
+    int32_t zoffset, int32_t width, int32_t height, int32_t depth,
+    int32_t level, Format src_format, uint16_t low, uint16_t high) {
+  if (src_format != R16_UINT && src_format != R16UI) return false;
+  if (!InitializeCompute()) return false;
+  if (width <= 0 || height <= 0 || depth <= 0) return true;
+
+  GLint previous_program = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+  GLuint program =
+      m_ComputePrograms[src_format == R16UI ? kWindowR16UI : kWindowR16];
+  glUseProgram(program);
+  glBindImageTexture(0, (GLuint)(size_t)dst_handle, level, GL_TRUE, 0,
+                     GL_WRITE_ONLY, GL_R8);
+  glBindImageTexture(1, (GLuint)(size_t)src_handle, level, GL_TRUE, 0,
+                     GL_READ_ONLY, kGLFormats[src_format].internal_format);
+  // same mapping as the CPU kernels
+  float range = high > low ? (float)(high - low) : 1.0f;
+  float scale = 255.0f / range;
+  glUniform3ui(glGetUniformLocation(program, "u_Size"), width, height, depth);
+  glUniform3i(glGetUniformLocation(program, "u_Offset"), xoffset, yoffset,
+              zoffset);
+  glUniform1f(glGetUniformLocation(program, "u_Scale"), scale);
+  glUniform1f(glGetUniformLocation(program, "u_Bias"), -(float)low * scale);
+  glDispatchCompute((width + kWindowGroupSize - 1) / kWindowGroupSize,
+                    (height + kWindowGroupSize - 1) / kWindowGroupSize,
+                    (depth + kWindowGroupSize - 1) / kWindowGroupSize);
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT |
+                  GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8);
+  glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R8);
+  glUseProgram((GLuint)previous_program);
+
+  LogComputeErrors(__FUNCTION__);
+  return true;
+}
+
+bool RenderAPI_OpenGLCoreES::SupportsDownsampling(Format format,
+                                                  DownsampleFilter filter) {
+  if (!ImageFormatQualifier(format) || filter < kDownsampleAverage ||
+      filter > kDownsampleMin)
+    return false;
+  // labels are not averaged
+  bool integer = kFormatInfos[format].kind == kFormatUint;
+  if (integer && filter == kDownsampleAverage) return false;
+  if (!InitializeCompute()) return false;
+
+  GLuint& program = m_DownsamplePrograms[format][filter];
+  if (!program) {
+    const char* defines[3] = {
+        "#define COMBINE(a, b) ((a) + (b))\n",
+        "#define COMBINE(a, b) max(a, b)\n",
+        "#define COMBINE(a, b) min(a, b)\n",
+    };
+    std::string texel = integer ? "#define TEXEL uvec4\n"
+                                : "#define TEXEL vec4\n";
+    program = CompileComputeProgram(
+        kDownsampleShaderSource, ImageFormatQualifier(format),
+        integer ? "uimage3D" : "image3D",
+        filter == kDownsampleAverage ? "(v * 0.125)" : "v", "v",
+        (texel + defines[filter]).c_str());
+    if (!program) program = kFailedProgram;
+  }
+  return program != kFailedProgram;
+}
+
+bool RenderAPI_OpenGLCoreES::DownsampleTexture3D(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, int32_t level,
+    Format format, DownsampleFilter filter) {
+  if (level < 1 || !SupportsDownsampling(format, filter)) return false;
+  if (width <= 0 || height <= 0 || depth <= 0) return true;
+
+  GLint previous_program = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+  GLuint program = m_DownsamplePrograms[format][filter];
+  GLuint gltex = (GLuint)(size_t)texture_handle;
+  GLenum internal_format = kGLFormats[format].internal_format;
+  glUseProgram(program);
+  glBindImageTexture(0, gltex, level, GL_TRUE, 0, GL_WRITE_ONLY,
+                     internal_format);
+  glBindImageTexture(1, gltex, level - 1, GL_TRUE, 0, GL_READ_ONLY,
+                     internal_format);
+  glUniform3ui(glGetUniformLocation(program, "u_Size"), width, height, depth);
+  glUniform3i(glGetUniformLocation(program, "u_Offset"), xoffset, yoffset,
+              zoffset);
+  glDispatchCompute((width + kDownsampleGroupSize - 1) / kDownsampleGroupSize,
+                    (height + kDownsampleGroupSize - 1) / kDownsampleGroupSize,
+                    (depth + kDownsampleGroupSize - 1) / kDownsampleGroupSize);
+  // the next coarser level is computed from this one
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT |
+                  GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8);
+  glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R8);
+  glUseProgram((GLuint)previous_program);
+
+  LogComputeErrors(__FUNCTION__);
+  return true;
+}
+
+#else
+
+bool RenderAPI_OpenGLCoreES::InitializeCompute() { return false; }
+
+void RenderAPI_OpenGLCoreES::ReleaseCompute() {}
+
+bool RenderAPI_OpenGLCoreES::TextureSubImage3DDeltaR16(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    const void* encoded_ptr, size_t encoded_size, int32_t level,
+    Format format) {
+  return false;
+}
+
+bool RenderAPI_OpenGLCoreES::WindowTexture3D(
+    void* src_handle, void* dst_handle, int32_t xoffset, int32_t yoffset,
+    int32_t zoffset, int32_t width, int32_t height, int32_t depth,
+    int32_t level, Format src_format, uint16_t low, uint16_t high) {
+  return false;
+}
+
+bool RenderAPI_OpenGLCoreES::SupportsDownsampling(Format format,
+                                                  DownsampleFilter filter) {
+  return false;
+}
+
+bool RenderAPI_OpenGLCoreES::DownsampleTexture3D(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, int32_t level,
+    Format format, DownsampleFilter filter) {
+  return false;
+}
+
+#endif  // #if SUPPORT_GL_COMPUTE
+
 void RenderAPI_OpenGLCoreES::TextureSubImage2D(void* texture_handle,
                                                int32_t xoffset, int32_t yoffset,
                                                int32_t width, int32_t height,
@@ -146,71 +759,67 @@ void RenderAPI_OpenGLCoreES::TextureSubImage2D(void* texture_handle,
                                                Format format) {
   GLuint gltex = (GLuint)(size_t)(texture_handle);
 
-  GLenum gltype;
-  switch (format) {
-    case Format::R8_UINT:
-      gltype = GL_UNSIGNED_BYTE;
-      break;
-    case Format::R16_UINT:
-      gltype = GL_UNSIGNED_SHORT;
-      break;
-    default:
-      return;
-      break;
-  }
+  if (!IsValidFormat(format)) return;
+  const GLFormat& glformat = kGLFormats[format];
+
+  bool unaligned = (size_t)width * BytesPerTexel(format) % 4 != 0;
+  if (unaligned) glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
   glBindTexture(GL_TEXTURE_2D, gltex);
-  glTexSubImage2D(GL_TEXTURE_2D, level, xoffset, yoffset, width, height, GL_RED,
-                  gltype, data_ptr);
+  glTexSubImage2D(GL_TEXTURE_2D, level, xoffset, yoffset, width, height,
+                  glformat.format, glformat.type, data_ptr);
+
+  if (unaligned) glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
 void RenderAPI_OpenGLCoreES::CreateTexture3D(uint32_t width, uint32_t height,
                                              uint32_t depth, Format format,
+                                             uint32_t mip_levels,
                                              void*& texture) {
-  int MAX_DIM_SIZE;
-  glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &MAX_DIM_SIZE);
-  {
-    std::ostringstream ss;
-    ss << "GL_MAX_3D_TEXTURE_SIZE: " << MAX_DIM_SIZE;
-    UNITY_LOG(g_Log, ss.str().c_str());
+  if (!IsValidFormat(format) || mip_levels == 0) {
+    texture = NULL;
+    return;
   }
 
-  GLint internal_format;
-  GLenum type;
-  switch (format) {
-    case R8_UINT:
-      internal_format = GL_R8;
-      type = GL_UNSIGNED_BYTE;
-      break;
-    case R16_UINT:
-      internal_format = GL_R16;
-      type = GL_UNSIGNED_SHORT;
-      break;
-    default:
-      texture = NULL;
-      return;
-      break;
+  uint32_t max_size = (uint32_t)MaxTexture3DSize();
+  if (!IsCompressedFormat(format) &&
+      (width > max_size || height > max_size || depth > max_size)) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": " << width << "x" << height << "x" << depth
+       << " exceeds GL_MAX_3D_TEXTURE_SIZE (" << max_size
+       << "), create a partitioned texture instead";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    texture = NULL;
+    return;
   }
 
+  // block-compressed textures are created as 2D arrays since GL does not
+  // allow RGTC in 3D textures. Slices are not filtered across.
+  GLenum target =
+      IsCompressedFormat(format) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_3D;
+
   GLuint gl_texture;
   glGenTextures(1, &gl_texture);
-  glBindTexture(GL_TEXTURE_3D, gl_texture);
+  glBindTexture(target, gl_texture);
 
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER,
+                  mip_levels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)mip_levels - 1);
 
   {
     std::ostringstream ss;
     ss << "supplied width: " << width << " height: " << height
-       << " depth: " << depth;
+       << " depth: " << depth << " levels: " << mip_levels;
     UNITY_LOG(g_Log, ss.str().c_str());
   }
 
-  glTexStorage3D(GL_TEXTURE_3D, 1, internal_format, width, height, depth);
+  glTexStorage3D(target, (GLsizei)mip_levels,
+                 kGLFormats[format].internal_format, width, height, depth);
 
   GLenum err;
   if ((err = glGetError()) != GL_NO_ERROR) {
@@ -237,4 +846,76 @@ void RenderAPI_OpenGLCoreES::ClearTexture3D(void* texture_handle) {
   glDeleteTextures(1, (GLuint*)&texture_handle);
 }
 
+// GL_NVX_gpu_memory_info and GL_ATI_meminfo, in KiB
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#endif
+#ifndef GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+bool RenderAPI_OpenGLCoreES::HasExtension(const char* name) {
+#if defined(GL_NUM_EXTENSIONS)
+  // core profiles do not report the extensions through glGetString
+  if (m_APIType == kUnityGfxRendererOpenGLCore) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+      const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+      if (extension && strcmp(extension, name) == 0) return true;
+    }
+    return false;
+  }
+#endif
+  const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+  if (!extensions) return false;
+  size_t length = strlen(name);
+  for (const char* found = strstr(extensions, name); found;
+       found = strstr(found + length, name)) {
+    if ((found == extensions || found[-1] == ' ') &&
+        (found[length] == ' ' || found[length] == '\0'))
+      return true;
+  }
+  return false;
+}
+
+bool RenderAPI_OpenGLCoreES::QueryVideoMemory(uint64_t& total_bytes,
+                                              uint64_t& available_bytes) {
+  if (m_MemoryInfo == kMemoryInfoUnknown) {
+    m_MemoryInfo = HasExtension("GL_NVX_gpu_memory_info") ? kMemoryInfoNVX
+                   : HasExtension("GL_ATI_meminfo")       ? kMemoryInfoATI
+                                                          : kMemoryInfoNone;
+  }
+  if (m_MemoryInfo == kMemoryInfoNVX) {
+    GLint total = 0, available = 0;
+    glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &total);
+    glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+    total_bytes = (uint64_t)total * 1024;
+    available_bytes = (uint64_t)available * 1024;
+    return true;
+  }
+  if (m_MemoryInfo == kMemoryInfoATI) {
+    // total free, largest free block, total and largest free auxiliary
+    GLint free[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, free);
+    total_bytes = 0;
+    available_bytes = (uint64_t)free[0] * 1024;
+    return true;
+  }
+  return false;
+}
+
+int32_t RenderAPI_OpenGLCoreES::MaxTexture3DSize() {
+  GLint max_size = 0;
+  glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max_size);
+  return max_size;
+}
+
+uint64_t RenderAPI_OpenGLCoreES::InternalMemorySize() {
+  return m_DecodeBufferSizes[0] + m_DecodeBufferSizes[1];
+}
+
 #endif  // #if SUPPORT_OPENGL_UNIFIED
@@ -0,0 +1,137 @@
+#include "SliceRepacker.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "RenderAPI.h"
+#include "StagingAllocator.h"
+
+SliceRepacker::SliceRepacker()
+    : m_TextureHandle(NULL),
+      m_Width(0),
+      m_Height(0),
+      m_Depth(0),
+      m_Format(R8_UINT),
+      m_BytesPerTexel(0),
+      m_BrickSize(0),
+      m_Level(0) {}
+
+bool SliceRepacker::Configure(void* texture_handle, int32_t width,
+                              int32_t height, int32_t depth, Format format,
+                              int32_t brick_size, int32_t level) {
+  if (BytesPerTexel(format) == 0 || width <= 0 || height <= 0 || depth <= 0 ||
+      brick_size <= 0) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": cannot repack the slices of a " << width << "x"
+       << height << "x" << depth << " volume of format " << format
+       << " into bricks of size " << brick_size;
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  m_TextureHandle = texture_handle;
+  m_Width = width;
+  m_Height = height;
+  m_Depth = depth;
+  m_Format = format;
+  m_BytesPerTexel = BytesPerTexel(format);
+  m_BrickSize = brick_size;
+  m_Level = level;
+  return true;
+}
+
+bool SliceRepacker::AddSlice(int32_t z, const void* slice, Slab& completed,
+                             bool& complete) {
+  complete = false;
+  size_t slice_size = (size_t)m_Width * m_Height * m_BytesPerTexel;
+  int32_t index = z / m_BrickSize;
+  uint8_t* dst = NULL;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (z >= 0 && z < m_Depth && slice) {
+      PendingSlab& pending = m_Pending[index];
+      if (!pending.slab.texels) {
+        pending.slab.z = index * m_BrickSize;
+        pending.slab.depth = std::min(m_BrickSize, m_Depth - pending.slab.z);
+        pending.slab.texels =
+            g_StagingAllocator.Allocate(slice_size * pending.slab.depth);
+        pending.added.assign(pending.slab.depth, false);
+        pending.added_count = 0;
+      }
+      int32_t k = z - pending.slab.z;
+      if (pending.slab.texels && !pending.added[k]) {
+        pending.added[k] = true;
+        dst = pending.slab.texels.get() + slice_size * k;
+      } else if (!pending.slab.texels) {
+        m_Pending.erase(index);
+      }
+    }
+  }
+  if (!dst) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": slice " << z << " lies outside the volume of "
+       << m_Depth << " slices, was already added or no staging buffer is "
+       << "available for its slab";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+
+  // slices of a slab are copied concurrently, it is complete once all copies
+  // are
+  memcpy(dst, slice, slice_size);
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  PendingSlab& pending = m_Pending[index];
+  if (++pending.added_count == pending.slab.depth) {
+    completed = pending.slab;
+    complete = true;
+    m_Pending.erase(index);
+  }
+  return true;
+}
+
+bool SliceRepacker::CutBrickRow(const Slab& slab, int32_t row,
+                                std::vector<UploadCommand>& bricks) const {
+  int32_t y = row * m_BrickSize;
+  int32_t height = std::min(m_BrickSize, m_Height - y);
+  size_t first = bricks.size();
+  for (int32_t x = 0; x < m_Width; x += m_BrickSize) {
+    UploadCommand brick;
+    brick.texture_handle = m_TextureHandle;
+    brick.xoffset = x;
+    brick.yoffset = y;
+    brick.zoffset = slab.z;
+    brick.width = std::min(m_BrickSize, m_Width - x);
+    brick.height = height;
+    brick.depth = slab.depth;
+    brick.layout = PackedSourceLayout();
+    brick.level = m_Level;
+    brick.format = m_Format;
+    std::shared_ptr<uint8_t> staging = g_StagingAllocator.Allocate(
+        TextureDataSize(m_Format, brick.width, height, slab.depth));
+    if (!staging) {
+      bricks.resize(first);
+      return false;
+    }
+    brick.data_ptr = staging.get();
+    brick.storage = staging;
+    bricks.push_back(brick);
+  }
+
+  size_t row_size = (size_t)m_Width * m_BytesPerTexel;
+  const uint8_t* src = slab.texels.get() + row_size * y;
+  for (int32_t k = 0; k < slab.depth; ++k, src += row_size * m_Height) {
+    for (int32_t j = 0; j < height; ++j) {
+      const uint8_t* src_row = src + row_size * j;
+      for (size_t b = first; b < bricks.size(); ++b) {
+        UploadCommand& brick = bricks[b];
+        size_t brick_row_size = (size_t)brick.width * m_BytesPerTexel;
+        memcpy((uint8_t*)brick.data_ptr +
+                   brick_row_size * ((size_t)k * height + j),
+               src_row + (size_t)brick.xoffset * m_BytesPerTexel,
+               brick_row_size);
+      }
+    }
+  }
+  return true;
+}
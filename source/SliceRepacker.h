@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Formats.h"
+#include "UploadQueue.h"
+
+/// @brief Repacks a stream of z-slices (full xy planes, e.g., from an
+/// acquisition pipeline) into bricks of a texture.
+///
+/// Slices are copied into the slab of brick depth they belong to, a staging
+/// buffer allocated with its first slice. Slices can arrive in any order and
+/// from several threads, so slabs complete independently. A completed slab
+/// is cut into tightly packed bricks one row of bricks at a time (see
+/// CutBrickRow), so that rows can be cut in parallel. Bricks land at their
+/// coordinates within the volume; bricks at the upper borders are smaller if
+/// the extents are not multiples of the brick size.
+class SliceRepacker {
+ public:
+  /// @brief Slab whose slices have all been added.
+  struct Slab {
+    // tightly packed slices
+    std::shared_ptr<uint8_t> texels;
+    int32_t z;
+    int32_t depth;
+  };
+
+  SliceRepacker();
+
+  /// @return false (and logs an error) if the format is block-compressed or
+  /// an extent is not positive
+  bool Configure(void* texture_handle, int32_t width, int32_t height,
+                 int32_t depth, Format format, int32_t brick_size,
+                 int32_t level);
+
+  /// @brief Copies a tightly packed slice into its slab. Thread-safe.
+  /// @param completed receives the slab if the slice was its last one
+  /// @param complete whether completed was set
+  /// @return false (and logs an error) if z is outside the volume, the slice
+  /// was already added or no staging buffer is available
+  bool AddSlice(int32_t z, const void* slice, Slab& completed,
+                bool& complete);
+
+  /// @brief Number of rows of bricks (along y) of a slab.
+  int32_t brick_rows() const {
+    return (m_Height + m_BrickSize - 1) / m_BrickSize;
+  }
+
+  /// @brief Cuts a row of bricks of a completed slab into uploads whose
+  /// sources are tightly packed bricks in staging buffers owned by them. The
+  /// rows of the slab are read sequentially and scattered into the bricks of
+  /// the row. Thread-safe.
+  /// @return false if no staging buffer is available
+  bool CutBrickRow(const Slab& slab, int32_t row,
+                   std::vector<UploadCommand>& bricks) const;
+
+ private:
+  SliceRepacker(const SliceRepacker&);
+  SliceRepacker& operator=(const SliceRepacker&);
+
+  struct PendingSlab {
+    Slab slab;
+    std::vector<bool> added;
+    int32_t added_count;
+  };
+
+  void* m_TextureHandle;
+  int32_t m_Width;
+  int32_t m_Height;
+  int32_t m_Depth;
+  Format m_Format;
+  uint32_t m_BytesPerTexel;
+  int32_t m_BrickSize;
+  int32_t m_Level;
+
+  std::mutex m_Mutex;
+  // slabs with some of their slices added, by index
+  std::unordered_map<int32_t, PendingSlab> m_Pending;
+};
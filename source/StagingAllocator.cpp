@@ -0,0 +1,243 @@
+#include "StagingAllocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "PlatformBase.h"
+
+#if UNITY_WIN
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+StagingAllocator g_StagingAllocator;
+
+static const size_t kPageSize = 4096;
+static const size_t kHugePageSize = 2 << 20;
+static const size_t kDefaultMaxPooledBytes = 128 << 20;
+
+/// @brief Capacity of the blocks serving requests of size bytes: the next
+/// multiple of a quarter of the largest power of two not above size, at least
+/// a page.
+static size_t SizeClass(size_t size) {
+  if (size <= kPageSize) return kPageSize;
+  size_t power = kPageSize;
+  while (power <= size / 2) power *= 2;
+  size_t step = power / 4;
+  return (size + step - 1) / step * step;
+}
+
+StagingAllocator::StagingAllocator()
+    : m_MemoryManager(NULL),
+      m_Allocator(NULL),
+      m_AllocatorBlocks(0),
+      m_MaxPooledBytes(kDefaultMaxPooledBytes),
+      m_HugePages(false),
+      m_Prefault(false) {
+  memset(&m_Statistics, 0, sizeof(m_Statistics));
+}
+
+StagingAllocator::~StagingAllocator() { Shutdown(); }
+
+void StagingAllocator::Initialize(IUnityInterfaces* interfaces) {
+  // pooled blocks come from the previous backing
+  Shutdown();
+  IUnityMemoryManager* memory_manager =
+      interfaces ? interfaces->Get<IUnityMemoryManager>() : NULL;
+  UnityAllocator* allocator =
+      memory_manager
+          ? memory_manager->CreateAllocator("TextureSubPlugin", "Staging")
+          : NULL;
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_MemoryManager = memory_manager;
+  m_Allocator = allocator;
+  m_AllocatorBlocks = 0;
+}
+
+void StagingAllocator::Shutdown() {
+  std::map<size_t, std::vector<uint8_t*> > pools;
+  UnityAllocator* backing;
+  UnityAllocator* destroyed = NULL;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    pools.swap(m_Pools);
+    m_Statistics.pooled_bytes = 0;
+    backing = m_Allocator;
+    if (m_Allocator && m_AllocatorBlocks > 0) {
+      // destroyed once the last of its blocks is released
+      m_RetiredAllocators[m_Allocator] = m_AllocatorBlocks;
+    } else {
+      destroyed = m_Allocator;
+    }
+    m_Allocator = NULL;
+    m_AllocatorBlocks = 0;
+  }
+  for (std::map<size_t, std::vector<uint8_t*> >::iterator it = pools.begin();
+       it != pools.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); ++i)
+      FreeBlock(it->second[i], backing);
+  }
+  if (destroyed) m_MemoryManager->DestroyAllocator(destroyed);
+}
+
+void StagingAllocator::Configure(size_t max_pooled_bytes, bool huge_pages,
+                                 bool prefault) {
+  std::vector<uint8_t*> freed;
+  UnityAllocator* backing;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_MaxPooledBytes = max_pooled_bytes;
+    m_HugePages = huge_pages;
+    m_Prefault = prefault;
+    Trim(freed);
+    backing = m_Allocator;
+  }
+  for (size_t i = 0; i < freed.size(); ++i) FreeBlock(freed[i], backing);
+}
+
+std::shared_ptr<uint8_t> StagingAllocator::Allocate(size_t size) {
+  size_t capacity = SizeClass(size);
+  uint8_t* block = NULL;
+  UnityAllocator* backing;
+  bool huge_pages, prefault;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    backing = m_Allocator;
+    huge_pages = m_HugePages;
+    prefault = m_Prefault;
+    std::map<size_t, std::vector<uint8_t*> >::iterator pool =
+        m_Pools.find(capacity);
+    if (pool != m_Pools.end() && !pool->second.empty()) {
+      block = pool->second.back();
+      pool->second.pop_back();
+      m_Statistics.pooled_bytes -= capacity;
+      ++m_Statistics.pool_hits;
+    } else {
+      ++m_Statistics.pool_misses;
+    }
+    m_Statistics.in_use_bytes += capacity;
+    if (m_Statistics.in_use_bytes > m_Statistics.peak_in_use_bytes)
+      m_Statistics.peak_in_use_bytes = m_Statistics.in_use_bytes;
+    if (backing) ++m_AllocatorBlocks;
+  }
+
+  if (!block) {
+    block = AllocateBlock(capacity, backing, huge_pages, prefault);
+    if (!block) {
+      UnityAllocator* destroyed = NULL;
+      {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Statistics.in_use_bytes -= capacity;
+        // Shutdown may have retired backing in the meantime
+        if (backing) destroyed = ForgetBlock(backing);
+      }
+      if (destroyed) m_MemoryManager->DestroyAllocator(destroyed);
+      return std::shared_ptr<uint8_t>();
+    }
+  }
+  Deleter deleter = {this, capacity, backing};
+  return std::shared_ptr<uint8_t>(block, deleter);
+}
+
+void StagingAllocator::Reserve(size_t size, uint32_t count) {
+  std::vector<std::shared_ptr<uint8_t> > blocks;
+  for (uint32_t i = 0; i < count; ++i) blocks.push_back(Allocate(size));
+  // released into the pools
+}
+
+StagingStatistics StagingAllocator::statistics() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Statistics;
+}
+
+void StagingAllocator::Deleter::operator()(uint8_t* block) const {
+  allocator->Release(block, capacity, backing);
+}
+
+uint8_t* StagingAllocator::AllocateBlock(size_t capacity,
+                                         UnityAllocator* backing,
+                                         bool huge_pages, bool prefault) {
+  size_t alignment =
+      huge_pages && capacity >= kHugePageSize ? kHugePageSize : kPageSize;
+  void* block = NULL;
+  if (backing) {
+    block = m_MemoryManager->Allocate(backing, capacity, alignment, __FILE__,
+                                      __LINE__);
+  } else {
+#if UNITY_WIN
+    block = _aligned_malloc(capacity, alignment);
+#else
+    if (posix_memalign(&block, alignment, capacity) != 0) block = NULL;
+#endif
+  }
+  if (!block) return NULL;
+
+#if defined(MADV_HUGEPAGE)
+  if (alignment == kHugePageSize) madvise(block, capacity, MADV_HUGEPAGE);
+#endif
+  if (prefault) {
+    volatile uint8_t* pages = (volatile uint8_t*)block;
+    for (size_t offset = 0; offset < capacity; offset += kPageSize)
+      pages[offset] = 0;
+  }
+  return (uint8_t*)block;
+}
+
+void StagingAllocator::FreeBlock(uint8_t* block, UnityAllocator* backing) {
+  if (backing) {
+    m_MemoryManager->Deallocate(backing, block, __FILE__, __LINE__);
+  } else {
+#if UNITY_WIN
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+  }
+}
+
+void StagingAllocator::Release(uint8_t* block, size_t capacity,
+                               UnityAllocator* backing) {
+  UnityAllocator* destroyed = NULL;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Statistics.in_use_bytes -= capacity;
+    if (backing) destroyed = ForgetBlock(backing);
+    if (backing == m_Allocator &&
+        m_Statistics.pooled_bytes + capacity <= m_MaxPooledBytes) {
+      m_Pools[capacity].push_back(block);
+      m_Statistics.pooled_bytes += capacity;
+      return;
+    }
+  }
+  FreeBlock(block, backing);
+  if (destroyed) m_MemoryManager->DestroyAllocator(destroyed);
+}
+
+UnityAllocator* StagingAllocator::ForgetBlock(UnityAllocator* backing) {
+  if (backing == m_Allocator) {
+    --m_AllocatorBlocks;
+    return NULL;
+  }
+  std::map<UnityAllocator*, uint64_t>::iterator retired =
+      m_RetiredAllocators.find(backing);
+  if (retired == m_RetiredAllocators.end() || --retired->second != 0)
+    return NULL;
+  m_RetiredAllocators.erase(retired);
+  return backing;
+}
+
+void StagingAllocator::Trim(std::vector<uint8_t*>& blocks) {
+  // largest blocks first
+  while (m_Statistics.pooled_bytes > m_MaxPooledBytes && !m_Pools.empty()) {
+    std::map<size_t, std::vector<uint8_t*> >::iterator pool = m_Pools.end();
+    --pool;
+    if (pool->second.empty()) {
+      m_Pools.erase(pool);
+      continue;
+    }
+    blocks.push_back(pool->second.back());
+    pool->second.pop_back();
+    m_Statistics.pooled_bytes -= pool->first;
+  }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Unity/IUnityInterface.h"
+#include "Unity/IUnityMemoryManager.h"
+
+/// @brief Counters of the staging allocator, see GetStagingStatistics.
+struct StagingStatistics {
+  // capacity of the blocks in use
+  uint64_t in_use_bytes;
+  uint64_t peak_in_use_bytes;
+  // capacity of the free blocks kept in the pools
+  uint64_t pooled_bytes;
+  // allocations served from the pools
+  uint64_t pool_hits;
+  // allocations of new blocks
+  uint64_t pool_misses;
+};
+
+/// @brief Pools of transient staging buffers (decompressed and gathered
+/// bricks, encoded blocks, ...) so that the upload paths do not call malloc
+/// for every brick.
+///
+/// Requests are rounded up to size classes (four per power of two, at least
+/// one page) and released blocks are kept in per-class free lists up to a
+/// budget in bytes. Blocks come from an allocator of IUnityMemoryManager if
+/// Unity provides one, so that they show up in Unity's memory profiler, and
+/// from the C runtime otherwise. Blocks are page aligned (suitable for
+/// O_DIRECT reads); with huge pages, blocks of 2 MiB or more are 2 MiB
+/// aligned and backed by transparent huge pages (Linux). With prefaulting,
+/// new blocks are touched by the allocating (worker) thread so that their
+/// page faults do not happen while the render thread reads them.
+class StagingAllocator {
+ public:
+  StagingAllocator();
+  ~StagingAllocator();
+
+  /// @brief Allocates new blocks through IUnityMemoryManager from now on if
+  /// Unity provides it.
+  void Initialize(IUnityInterfaces* interfaces);
+
+  /// @brief Frees the pooled blocks and releases the Unity allocator (once
+  /// the blocks in use are released). New blocks come from the C runtime.
+  void Shutdown();
+
+  /// @param max_pooled_bytes maximum capacity of the free blocks kept, 0
+  /// frees released blocks right away
+  /// @param huge_pages whether to back large blocks with huge pages
+  /// @param prefault whether to touch the pages of new blocks
+  void Configure(size_t max_pooled_bytes, bool huge_pages, bool prefault);
+
+  /// @brief Allocates a block of at least size bytes that returns to its pool
+  /// once the last reference is released. Thread-safe.
+  /// @return NULL if the allocation fails
+  std::shared_ptr<uint8_t> Allocate(size_t size);
+
+  /// @brief Allocates count blocks of size bytes into the pools ahead of
+  /// time (e.g., while loading a scene), within the pool budget.
+  void Reserve(size_t size, uint32_t count);
+
+  StagingStatistics statistics();
+
+ private:
+  struct Deleter {
+    StagingAllocator* allocator;
+    size_t capacity;
+    // allocator the block comes from, NULL for the C runtime
+    UnityAllocator* backing;
+
+    void operator()(uint8_t* block) const;
+  };
+
+  StagingAllocator(const StagingAllocator&);
+  StagingAllocator& operator=(const StagingAllocator&);
+
+  /// @brief Allocates a new block. m_Mutex must not be held.
+  uint8_t* AllocateBlock(size_t capacity, UnityAllocator* backing,
+                         bool huge_pages, bool prefault);
+
+  /// @brief Frees a block. m_Mutex must not be held.
+  void FreeBlock(uint8_t* block, UnityAllocator* backing);
+
+  void Release(uint8_t* block, size_t capacity, UnityAllocator* backing);
+
+  /// @brief Counts a block of the Unity allocator backing as no longer in
+  /// use. m_Mutex must be held.
+  /// @return backing if it was retired by Shutdown and this was its last
+  /// block in use, to destroy with m_Mutex released; NULL otherwise
+  UnityAllocator* ForgetBlock(UnityAllocator* backing);
+
+  /// @brief Frees pooled blocks until they fit into the budget. Returns the
+  /// blocks to free with m_Mutex released. m_Mutex must be held.
+  void Trim(std::vector<uint8_t*>& blocks);
+
+  std::mutex m_Mutex;
+  IUnityMemoryManager* m_MemoryManager;
+  UnityAllocator* m_Allocator;
+  // blocks of m_Allocator in use
+  uint64_t m_AllocatorBlocks;
+  // Unity allocators released by Shutdown while blocks were in use, with
+  // the number of their blocks still in use
+  std::map<UnityAllocator*, uint64_t> m_RetiredAllocators;
+  size_t m_MaxPooledBytes;
+  bool m_HugePages;
+  bool m_Prefault;
+  // free blocks of the current backing by capacity
+  std::map<size_t, std::vector<uint8_t*> > m_Pools;
+  StagingStatistics m_Statistics;
+};
+
+// staging buffers of the plugin
+extern StagingAllocator g_StagingAllocator;
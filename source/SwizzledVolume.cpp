@@ -0,0 +1,229 @@
+#include "SwizzledVolume.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+
+#include "BrickHalo.h"
+#include "RenderAPI.h"
+
+static const int32_t kTileTexels =
+    SwizzledVolume::kTileSize * SwizzledVolume::kTileSize *
+    SwizzledVolume::kTileSize;
+
+/// @brief Spreads the lower 21 bits of v to every third bit.
+static uint64_t SpreadBits(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | (v << 32)) & 0x1f00000000ffffULL;
+  v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+  v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+  v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+  v = (v | (v << 2)) & 0x1249249249249249ULL;
+  return v;
+}
+
+/// @brief Morton number of a tile, whose coordinates are below 2^21.
+static uint64_t MortonNumber(uint32_t x, uint32_t y, uint32_t z) {
+  return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+}
+
+/// @brief Copies a run of texels of a row, with fixed-size (vectorized)
+/// copies for whole tile rows.
+static inline void CopyRun(uint8_t* dst, const uint8_t* src, size_t size,
+                           size_t tile_row_size) {
+  switch (size == tile_row_size ? size : 0) {
+    case 16:
+      memcpy(dst, src, 16);
+      break;
+    case 32:
+      memcpy(dst, src, 32);
+      break;
+    case 64:
+      memcpy(dst, src, 64);
+      break;
+    case 128:
+      memcpy(dst, src, 128);
+      break;
+    default:
+      memcpy(dst, src, size);
+      break;
+  }
+}
+
+SwizzledVolume::SwizzledVolume()
+    : m_Width(0),
+      m_Height(0),
+      m_Depth(0),
+      m_Format(R8_UINT),
+      m_BytesPerTexel(0) {
+  m_TileCounts[0] = m_TileCounts[1] = m_TileCounts[2] = 0;
+}
+
+bool SwizzledVolume::Allocate(int32_t width, int32_t height, int32_t depth,
+                              Format format) {
+  // Morton numbers hold 21 bits of tile coordinates
+  const int32_t max_extent = kTileSize << 21;
+  if (BytesPerTexel(format) == 0 || width <= 0 || height <= 0 ||
+      depth <= 0 || width > max_extent || height > max_extent ||
+      depth > max_extent) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": cannot store a " << width << "x" << height << "x"
+       << depth << " volume of format " << format << " in tiles";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  int32_t tile_counts[3] = {(width + kTileSize - 1) / kTileSize,
+                            (height + kTileSize - 1) / kTileSize,
+                            (depth + kTileSize - 1) / kTileSize};
+  // at most 2^63 tiles, the byte count is checked before it is computed
+  uint64_t tile_count =
+      (uint64_t)tile_counts[0] * tile_counts[1] * tile_counts[2];
+  uint64_t tile_size = (uint64_t)kTileTexels * BytesPerTexel(format);
+  uint64_t max_size = kMaxSize < (uint64_t)SIZE_MAX ? kMaxSize : SIZE_MAX;
+  if (tile_count > max_size / tile_size) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": the tiles of a " << width << "x" << height << "x"
+       << depth << " volume of format " << format << " exceed " << max_size
+       << " bytes";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+
+  std::vector<uint32_t> slots;
+  std::vector<uint8_t> tiles;
+  try {
+    // slots in the order of the tiles' Morton numbers
+    std::vector<std::pair<uint64_t, uint32_t> > numbers((size_t)tile_count);
+    for (int32_t k = 0, i = 0; k < tile_counts[2]; ++k) {
+      for (int32_t j = 0; j < tile_counts[1]; ++j) {
+        for (int32_t t = 0; t < tile_counts[0]; ++t, ++i) {
+          numbers[i].first = MortonNumber(t, j, k);
+          numbers[i].second = (uint32_t)i;
+        }
+      }
+    }
+    std::sort(numbers.begin(), numbers.end());
+    slots.resize((size_t)tile_count);
+    for (size_t slot = 0; slot < slots.size(); ++slot)
+      slots[numbers[slot].second] = (uint32_t)slot;
+    tiles.assign((size_t)(tile_count * tile_size), 0);
+  } catch (const std::bad_alloc&) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": cannot allocate " << tile_count * tile_size
+       << " bytes for a " << width << "x" << height << "x" << depth
+       << " volume of format " << format;
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+
+  m_Width = width;
+  m_Height = height;
+  m_Depth = depth;
+  m_Format = format;
+  m_BytesPerTexel = BytesPerTexel(format);
+  for (int a = 0; a < 3; ++a) m_TileCounts[a] = tile_counts[a];
+  m_Slots.swap(slots);
+  m_Tiles.swap(tiles);
+  return true;
+}
+
+bool SwizzledVolume::Contains(int32_t x, int32_t y, int32_t z, int32_t width,
+                              int32_t height, int32_t depth) const {
+  return !m_Tiles.empty() && x >= 0 && y >= 0 && z >= 0 && width > 0 &&
+         height > 0 && depth > 0 && width <= m_Width - x &&
+         height <= m_Height - y && depth <= m_Depth - z;
+}
+
+void SwizzledVolume::CopyBox(int32_t x, int32_t y, int32_t z, int32_t width,
+                             int32_t height, int32_t depth, uint8_t* linear,
+                             size_t row_pitch, size_t slice_pitch,
+                             bool extract) const {
+  size_t tile_row_size = (size_t)kTileSize * m_BytesPerTexel;
+  size_t tile_slice_size = tile_row_size * kTileSize;
+  size_t tile_size = tile_slice_size * kTileSize;
+  // tiles are visited in x, y, z order and each is read or written from its
+  // first to its last row
+  for (int32_t tz = z / kTileSize; tz <= (z + depth - 1) / kTileSize; ++tz) {
+    int32_t z0 = std::max(z, tz * kTileSize);
+    int32_t z1 = std::min(z + depth, (tz + 1) * kTileSize);
+    for (int32_t ty = y / kTileSize; ty <= (y + height - 1) / kTileSize;
+         ++ty) {
+      int32_t y0 = std::max(y, ty * kTileSize);
+      int32_t y1 = std::min(y + height, (ty + 1) * kTileSize);
+      for (int32_t tx = x / kTileSize; tx <= (x + width - 1) / kTileSize;
+           ++tx) {
+        int32_t x0 = std::max(x, tx * kTileSize);
+        int32_t x1 = std::min(x + width, (tx + 1) * kTileSize);
+        size_t run = (size_t)(x1 - x0) * m_BytesPerTexel;
+        uint32_t slot = m_Slots[((size_t)tz * m_TileCounts[1] + ty) *
+                                    m_TileCounts[0] +
+                                tx];
+        // only written if !extract
+        uint8_t* tile = const_cast<uint8_t*>(m_Tiles.data()) +
+                        (size_t)slot * tile_size +
+                        (size_t)(x0 - tx * kTileSize) * m_BytesPerTexel;
+        for (int32_t sz = z0; sz < z1; ++sz) {
+          uint8_t* tile_row = tile +
+                              (size_t)(sz - tz * kTileSize) * tile_slice_size +
+                              (size_t)(y0 - ty * kTileSize) * tile_row_size;
+          uint8_t* linear_row = linear + (size_t)(sz - z) * slice_pitch +
+                                (size_t)(y0 - y) * row_pitch +
+                                (size_t)(x0 - x) * m_BytesPerTexel;
+          for (int32_t sy = y0; sy < y1; ++sy) {
+            if (extract)
+              CopyRun(linear_row, tile_row, run, tile_row_size);
+            else
+              CopyRun(tile_row, linear_row, run, tile_row_size);
+            tile_row += tile_row_size;
+            linear_row += row_pitch;
+          }
+        }
+      }
+    }
+  }
+}
+
+void SwizzledVolume::Write(int32_t x, int32_t y, int32_t z, int32_t width,
+                           int32_t height, int32_t depth, const void* src) {
+  size_t row_pitch = (size_t)width * m_BytesPerTexel;
+  CopyBox(x, y, z, width, height, depth, (uint8_t*)src, row_pitch,
+          row_pitch * height, false);
+}
+
+void SwizzledVolume::Extract(int32_t x, int32_t y, int32_t z, int32_t width,
+                             int32_t height, int32_t depth, void* dst) const {
+  size_t row_pitch = (size_t)width * m_BytesPerTexel;
+  CopyBox(x, y, z, width, height, depth, (uint8_t*)dst, row_pitch,
+          row_pitch * height, true);
+}
+
+void SwizzledVolume::ExtractPadded(int32_t x, int32_t y, int32_t z,
+                                   int32_t width, int32_t height,
+                                   int32_t depth, int32_t halo,
+                                   void* dst) const {
+  int32_t padded_width = width + 2 * halo;
+  int32_t padded_height = height + 2 * halo;
+  int32_t padded_depth = depth + 2 * halo;
+  // part of the padded box that lies within the volume
+  int32_t x0 = std::max(x - halo, 0);
+  int32_t y0 = std::max(y - halo, 0);
+  int32_t z0 = std::max(z - halo, 0);
+  int32_t x1 = std::min(x + width + halo, m_Width);
+  int32_t y1 = std::min(y + height + halo, m_Height);
+  int32_t z1 = std::min(z + depth + halo, m_Depth);
+  int32_t before[3] = {x0 - (x - halo), y0 - (y - halo), z0 - (z - halo)};
+  int32_t after[3] = {x + width + halo - x1, y + height + halo - y1,
+                      z + depth + halo - z1};
+
+  size_t row_pitch = (size_t)padded_width * m_BytesPerTexel;
+  size_t slice_pitch = row_pitch * padded_height;
+  uint8_t* inside = (uint8_t*)dst + (size_t)before[2] * slice_pitch +
+                    (size_t)before[1] * row_pitch +
+                    (size_t)before[0] * m_BytesPerTexel;
+  CopyBox(x0, y0, z0, x1 - x0, y1 - y0, z1 - z0, inside, row_pitch,
+          slice_pitch, true);
+  ClampPaddedBox(dst, padded_width, padded_height, padded_depth,
+                 m_BytesPerTexel, before, after);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "Formats.h"
+
+/// @brief Host volume stored as tiles of kTileSize^3 texels laid out in
+/// Morton (Z-) order, so that sub-boxes (bricks) are read from a few
+/// contiguous runs of memory instead of one cache line per row and slice of a
+/// linear volume, which also thrashes the TLB on large volumes. Texels are
+/// linear (x fastest) within a tile.
+///
+/// Tiles are numbered by interleaving the bits of their coordinates and
+/// stored in the order of their numbers, skipping the numbers of tiles
+/// outside the volume, so that extents that are not powers of two waste no
+/// memory besides the partial tiles at the upper borders. Reads and writes of
+/// disjoint boxes can run concurrently.
+class SwizzledVolume {
+ public:
+  /// @brief Extent of the tiles along every axis. Tiles of R8 texels are one
+  /// 4 KiB page.
+  static const int32_t kTileSize = 16;
+
+  /// @brief Largest size in bytes of the tiles of a volume.
+  static const uint64_t kMaxSize = (uint64_t)64 << 30;
+
+  SwizzledVolume();
+
+  /// @brief Allocates a zero-filled volume.
+  /// @return false (and logs an error) if the format is block-compressed, an
+  /// extent is not positive, the tiles would exceed kMaxSize or the memory
+  /// cannot be allocated
+  bool Allocate(int32_t width, int32_t height, int32_t depth, Format format);
+
+  /// @brief Whether the box lies within the volume.
+  bool Contains(int32_t x, int32_t y, int32_t z, int32_t width,
+                int32_t height, int32_t depth) const;
+
+  /// @brief Writes a box of linear texels, e.g., the whole volume to convert
+  /// it from a linear layout.
+  /// @param src tightly packed texels of the box
+  void Write(int32_t x, int32_t y, int32_t z, int32_t width, int32_t height,
+             int32_t depth, const void* src);
+
+  /// @brief Reads a box into tightly packed linear texels (the layout
+  /// expected by TextureSubImage3D), tile by tile.
+  void Extract(int32_t x, int32_t y, int32_t z, int32_t width, int32_t height,
+               int32_t depth, void* dst) const;
+
+  /// @brief Same as Extract, but the box is grown by halo texels on every
+  /// side and clamped to the volume (see GatherPaddedBox).
+  void ExtractPadded(int32_t x, int32_t y, int32_t z, int32_t width,
+                     int32_t height, int32_t depth, int32_t halo,
+                     void* dst) const;
+
+  Format format() const { return m_Format; }
+
+ private:
+  /// @brief Copies the texels of a box between the tiles and a linear
+  /// buffer. Writes to the tiles although const if !extract.
+  /// @param row_pitch bytes between the rows of the linear buffer
+  /// @param slice_pitch bytes between the slices of the linear buffer
+  /// @param extract whether the tiles are read (or written)
+  void CopyBox(int32_t x, int32_t y, int32_t z, int32_t width,
+               int32_t height, int32_t depth, uint8_t* linear,
+               size_t row_pitch, size_t slice_pitch, bool extract) const;
+
+  int32_t m_Width;
+  int32_t m_Height;
+  int32_t m_Depth;
+  Format m_Format;
+  uint32_t m_BytesPerTexel;
+  // tiles along x, y and z
+  int32_t m_TileCounts[3];
+  // storage slot of each tile, x fastest
+  std::vector<uint32_t> m_Slots;
+  std::vector<uint8_t> m_Tiles;
+};
@@ -1,14 +1,44 @@
 #include <assert.h>
 #include <math.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
 
 #include "PlatformBase.h"
+#include "BlockCompression.h"
+#include "BrickHalo.h"
+#include "BrickCache.h"
+#include "BrickedVolume.h"
+#include "BrickPrefetcher.h"
+#include "BrickStatistics.h"
+#include "ContentHashTable.h"
+#include "DeltaCodec.h"
+#include "Decompression.h"
+#include "FormatConversion.h"
+#include "GpuMemoryBudget.h"
+#include "MappedVolume.h"
+#include "MipChain.h"
+#include "PartitionedVolume.h"
+#include "ReadQueue.h"
+#include "SliceRepacker.h"
 #include "RenderAPI.h"
+#include "StagingAllocator.h"
+#include "SwizzledVolume.h"
+#include "UploadQueue.h"
+#include "VolumeTable.h"
+#include "WorkerPool.h"
 
 enum Event {
   TextureSubImage2D = 0,
   TextureSubImage3D = 1,
   CreateTexture3D = 2,
-  ClearTexture3D = 3
+  ClearTexture3D = 3,
+  FlushUploadQueue = 4,
+  WindowTexture3D = 5,
+  CreatePartitionedTexture3D = 6,
+  ClearPartitionedTexture3D = 7
 };
 
 static void UNITY_INTERFACE_API
@@ -20,19 +50,106 @@ UnityPluginLoad(IUnityInterfaces* unityInterfaces) {
   g_Graphics = g_UnityInterfaces->Get<IUnityGraphics>();
   g_Graphics->RegisterDeviceEventCallback(OnGraphicsDeviceEvent);
   g_Log = g_UnityInterfaces->Get<IUnityLog>();
+  g_StagingAllocator.Initialize(unityInterfaces);
 
   // Run OnGraphicsDeviceEvent(initialize) manually on plugin load
   OnGraphicsDeviceEvent(kUnityGfxDeviceEventInitialize);
 }
 
+// decompresses the payloads queued through EnqueueCompressedTextureSubImage3D
+// and gathers the bricks of mapped volumes
+static WorkerPool s_WorkerPool;
+
+// volume files registered through RegisterMappedVolume and
+// RegisterBrickedVolume
+static VolumeTable<MappedVolume> s_MappedVolumes;
+static VolumeTable<BrickedVolume> s_BrickedVolumes;
+
+// bricks of bricked volumes kept in host memory, see SetBrickCacheBudgets
+static BrickCache s_BrickCache;
+
+// bricks of bricked volumes loaded ahead of their requests, see
+// SetBrickPrefetching
+static BrickPrefetcher s_BrickPrefetcher;
+
+// reads of the bricks of bricked volumes through io_uring, see
+// SetBrickReadQueue
+static ReadQueue s_ReadQueue;
+static std::atomic<bool> s_DirectBrickReads(false);
+
+// slice streams repacked into bricks, see CreateSliceRepacker
+static VolumeTable<SliceRepacker> s_SliceRepackers;
+
+// completed slab being cut into bricks, one task per row of bricks
+struct SlabCut {
+  std::shared_ptr<SliceRepacker> repacker;
+  SliceRepacker::Slab slab;
+  uint64_t ticket;
+  std::mutex mutex;
+  // bricks of all rows, queued together once the last row has been cut
+  std::vector<UploadCommand> uploads;
+  int32_t remaining;
+};
+
+// rows of slabs that could not be cut for lack of staging buffers, cut again
+// after the next FlushUploadQueue event (see CutSlabRow)
+static std::mutex s_UncutRowsMutex;
+static std::vector<std::pair<std::shared_ptr<SlabCut>, int32_t> > s_UncutRows;
+
+// host volumes stored in tiles, see CreateSwizzledVolume
+static VolumeTable<SwizzledVolume> s_SwizzledVolumes;
+
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload() {
   g_Graphics->UnregisterDeviceEventCallback(OnGraphicsDeviceEvent);
+  // the worker threads must not outlive the plugin's code, completed reads
+  // are handed to them
+  s_ReadQueue.Shutdown();
+  s_WorkerPool.Shutdown();
+  s_BrickPrefetcher.Configure(0, 0);
+  s_BrickCache.SetBudgets(0, 0);
+  s_MappedVolumes.Clear();
+  s_BrickedVolumes.Clear();
+  s_SliceRepackers.Clear();
+  {
+    std::lock_guard<std::mutex> lock(s_UncutRowsMutex);
+    s_UncutRows.clear();
+  }
+  s_SwizzledVolumes.Clear();
+  // staging buffers still referenced release the Unity allocator later
+  g_StagingAllocator.Shutdown();
 }
 
 // GraphicsDeviceEvent
 static RenderAPI* s_CurrentAPI = NULL;
 static UnityGfxRenderer s_DeviceType = kUnityGfxRendererNull;
 
+// uploads queued through EnqueueTextureSubImage3D
+static UploadQueue s_UploadQueue;
+
+// content hashes of the textures created through CreateTexture3D
+static ContentHashTable s_ContentHashes;
+
+// per-brick statistics of the textures registered through
+// RegisterBrickStatistics
+static BrickStatisticsTable s_BrickStatistics;
+
+// block-compressed textures created through CreateTexture3D whose uploads
+// are encoded on the submitting thread
+static BlockCompressor s_BlockCompressor;
+
+// sizes of the textures created through CreateTexture3D, see
+// SetGpuMemoryBudget
+static GpuMemoryBudget s_GpuMemory;
+
+// volumes created through CreatePartitionedTexture3D
+static VolumeTable<PartitionedVolume> s_PartitionedVolumes;
+
+// textures created through CreateTexture3D with several mip levels, see
+// UpdateCreateTexture3DMipParams
+static MipChainTable s_MipChains;
+// whether mip chains are regenerated on the GPU, see SetGpuMipRegeneration
+static std::atomic<bool> s_GpuMipRegeneration(false);
+
 static void UNITY_INTERFACE_API
 OnGraphicsDeviceEvent(UnityGfxDeviceEventType eventType) {
   // Create graphics API implementation upon initialization
@@ -49,6 +166,17 @@ OnGraphicsDeviceEvent(UnityGfxDeviceEventType eventType) {
 
   // Cleanup graphics API implementation upon shutdown
   if (eventType == kUnityGfxDeviceEventShutdown) {
+    {
+      std::lock_guard<std::mutex> lock(s_UncutRowsMutex);
+      s_UncutRows.clear();
+    }
+    // the hashes recorded for the dropped uploads are forgotten along with
+    // the tracked textures
+    s_UploadQueue.Clear();
+    s_ContentHashes.Clear();
+    s_BrickStatistics.Clear();
+    s_BlockCompressor.Clear();
+    s_MipChains.Clear();
     delete s_CurrentAPI;
     s_CurrentAPI = NULL;
     s_DeviceType = kUnityGfxRendererNull;
@@ -75,8 +203,28 @@ struct TextureSubImage3DParams {
   int32_t height;
   int32_t depth;
   void* data_ptr;
+  SourceLayout layout;
   int32_t level;
   Format format;
+  // content is already resident (see SetContentHashing) or could not be
+  // encoded for a block-compressed texture
+  bool skip;
+  // hash of the content (and its format before encoding) recorded once the
+  // upload executed, if the texture's content is tracked
+  bool record_hash;
+  uint64_t content_hash;
+  Format content_format;
+  // owns the encoded blocks of uploads to block-compressed textures
+  std::shared_ptr<void> storage;
+  // delta-coded brick (see DeltaCodec.h) replacing data_ptr, NULL if none
+  const void* encoded_ptr;
+  size_t encoded_size;
+  // R8_UINT texture that also receives the windowed texels, NULL if none
+  void* windowed_handle;
+  uint16_t window_low;
+  uint16_t window_high;
+  // uploads of the coarser mip levels, see UpdateCreateTexture3DMipParams
+  std::vector<UploadCommand> mip_uploads;
 };
 
 struct CreateTexture3DParams {
@@ -84,18 +232,52 @@ struct CreateTexture3DParams {
   uint32_t height;
   uint32_t depth;
   Format format;
+  // 0 for a full mip chain
+  uint32_t mip_levels;
+  DownsampleFilter filter;
 };
 
 struct ClearTexture3DParams {
   void* texture_handle;
 };
 
+struct CreatePartitionedTexture3DParams {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  Format format;
+  uint64_t max_partition_bytes;
+};
+
+struct WindowTexture3DParams {
+  void* src_handle;
+  void* dst_handle;
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  int32_t level;
+  Format src_format;
+  uint16_t low;
+  uint16_t high;
+};
+
 // global state parameters
 static TextureSubImage2DParams g_TextureSubImage2DParams;
-static TextureSubImage3DParams g_TextureSubImage3DParams;
+// replaced (never written to) by the Update*Params calls, the render thread
+// keeps the parameters and the buffers they own alive while it uploads
+static std::mutex g_TextureSubImage3DMutex;
+static std::shared_ptr<const TextureSubImage3DParams>
+    g_TextureSubImage3DParams;
 static CreateTexture3DParams g_CreateTexture3DParams;
 static ClearTexture3DParams g_ClearTexture3DParams;
+static CreatePartitionedTexture3DParams g_CreatePartitionedTexture3DParams;
+static int32_t g_ClearPartitionedTexture3DId = 0;
+static WindowTexture3DParams g_WindowTexture3DParams;
 static void* g_Texture3D = NULL;
+static int32_t g_PartitionedTexture3DId = 0;
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
 UpdateTextureSubImage2DParams(void* texture_handle, int32_t xoffset,
@@ -111,21 +293,1414 @@ UpdateTextureSubImage2DParams(void* texture_handle, int32_t xoffset,
   g_TextureSubImage2DParams.format = format;
 }
 
+/// @brief Forgets the content hash of the region of an upload whose content
+/// does not (or will not) match what was hashed for it.
+static void InvalidateContentHash(const UploadCommand& cmd) {
+  s_ContentHashes.Invalidate(cmd.texture_handle, cmd.xoffset, cmd.yoffset,
+                             cmd.zoffset, cmd.width, cmd.height, cmd.depth,
+                             cmd.level);
+}
+
+/// @brief Hands the parameters of the next TextureSubImage3D event over to
+/// the render thread.
+static void SetTextureSubImage3DParams(
+    std::shared_ptr<const TextureSubImage3DParams> params) {
+  {
+    std::lock_guard<std::mutex> lock(g_TextureSubImage3DMutex);
+    g_TextureSubImage3DParams.swap(params);
+  }
+  // the replaced parameters (if the render thread is done with them) are
+  // released without holding the lock
+}
+
+/// @brief Fills the parameters of a TextureSubImage3D event uploading a
+/// sub-box of a host volume: hashes (and encodes) the source and generates
+/// the coarser levels of mip chains downsampled on the host, on the calling
+/// thread so that the render thread only has to upload.
+static void PrepareTextureSubImage3D(void* texture_handle, int32_t xoffset,
+                                     int32_t yoffset, int32_t zoffset,
+                                     int32_t width, int32_t height,
+                                     int32_t depth, void* data_ptr,
+                                     const SourceLayout& layout,
+                                     int32_t level, Format format,
+                                     TextureSubImage3DParams& params) {
+  UploadCommand cmd;
+  cmd.texture_handle = texture_handle;
+  cmd.xoffset = xoffset;
+  cmd.yoffset = yoffset;
+  cmd.zoffset = zoffset;
+  cmd.width = width;
+  cmd.height = height;
+  cmd.depth = depth;
+  cmd.data_ptr = data_ptr;
+  cmd.layout = layout;
+  cmd.level = level;
+  cmd.format = format;
+
+  params.texture_handle = texture_handle;
+  params.xoffset = xoffset;
+  params.yoffset = yoffset;
+  params.zoffset = zoffset;
+  params.width = width;
+  params.height = height;
+  params.depth = depth;
+  params.data_ptr = data_ptr;
+  params.layout = layout;
+  params.level = level;
+  params.format = format;
+  params.encoded_ptr = NULL;
+  params.encoded_size = 0;
+  params.windowed_handle = NULL;
+  // the hash is only recorded by the render thread once the upload
+  // executed, these parameters may be replaced before that
+  params.content_format = format;
+  params.record_hash = s_ContentHashes.Hash(
+      texture_handle, xoffset, yoffset, zoffset, width, height, depth,
+      data_ptr, layout, level, format, params.content_hash);
+  params.skip = params.record_hash &&
+                s_ContentHashes.IsResident(texture_handle, xoffset, yoffset,
+                                           zoffset, width, height, depth,
+                                           level, format, params.content_hash);
+  if (!params.skip && s_BlockCompressor.IsRegistered(texture_handle)) {
+    UploadCommand compressed;
+    if (s_BlockCompressor.Compress(cmd, compressed)) {
+      params.data_ptr = compressed.data_ptr;
+      params.layout = compressed.layout;
+      params.format = compressed.format;
+      params.storage = compressed.storage;
+    } else {
+      params.skip = true;
+    }
+  }
+  if (!params.skip && s_MipChains.IsDownsampledOnHost(texture_handle))
+    s_MipChains.Downsample(cmd, params.mip_uploads);
+}
+
+/// @brief Same as UpdateTextureSubImage3DParams but the source is a sub-box
+/// of a larger host volume pointed to by data_ptr (see SourceLayout).
+/// @param src_row_length width of the host volume (0: width)
+/// @param src_image_height height of the host volume (0: height)
+/// @param src_xoffset x offset of the sub-box within the host volume
+/// @param src_yoffset y offset of the sub-box within the host volume
+/// @param src_zoffset z offset of the sub-box within the host volume
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UpdateTextureSubImage3DStridedParams(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr,
+    int32_t src_row_length, int32_t src_image_height, int32_t src_xoffset,
+    int32_t src_yoffset, int32_t src_zoffset, int32_t level, Format format) {
+  SourceLayout layout;
+  layout.row_length = src_row_length;
+  layout.image_height = src_image_height;
+  layout.skip_texels = src_xoffset;
+  layout.skip_rows = src_yoffset;
+  layout.skip_images = src_zoffset;
+  std::shared_ptr<TextureSubImage3DParams> params(
+      new TextureSubImage3DParams());
+  PrepareTextureSubImage3D(texture_handle, xoffset, yoffset, zoffset, width,
+                           height, depth, data_ptr, layout, level, format,
+                           *params);
+  SetTextureSubImage3DParams(params);
+}
+
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
 UpdateTextureSubImage3DParams(void* texture_handle, int32_t xoffset,
                               int32_t yoffset, int32_t zoffset, int32_t width,
                               int32_t height, int32_t depth, void* data_ptr,
                               int32_t level, Format format) {
-  g_TextureSubImage3DParams.texture_handle = texture_handle;
-  g_TextureSubImage3DParams.xoffset = xoffset;
-  g_TextureSubImage3DParams.yoffset = yoffset;
-  g_TextureSubImage3DParams.zoffset = zoffset;
-  g_TextureSubImage3DParams.width = width;
-  g_TextureSubImage3DParams.height = height;
-  g_TextureSubImage3DParams.depth = depth;
-  g_TextureSubImage3DParams.data_ptr = data_ptr;
-  g_TextureSubImage3DParams.level = level;
-  g_TextureSubImage3DParams.format = format;
+  UpdateTextureSubImage3DStridedParams(texture_handle, xoffset, yoffset,
+                                       zoffset, width, height, depth, data_ptr,
+                                       0, 0, 0, 0, 0, level, format);
+}
+
+/// @brief Clamps a window bound passed by the C# side to [0, 65535].
+static uint16_t ClampWindowBound(int32_t value) {
+  return (uint16_t)(value < 0 ? 0 : (value > 65535 ? 65535 : value));
+}
+
+/// @brief Same as UpdateTextureSubImage3DParams but the next
+/// TextureSubImage3D event also writes the windowed (see
+/// ConvertUInt16ToUInt8Window) texels into the same sub-region of an R8_UINT
+/// texture of the same size. The 16-bit brick is uploaded once and windowed
+/// by a compute pass where the backend supports it and on the render thread
+/// otherwise.
+/// @param windowed_handle R8_UINT texture receiving the windowed texels
+/// @param format R16_UINT or R16UI
+/// @param window_low value mapped to 0
+/// @param window_high value mapped to 255
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UpdateTextureSubImage3DWindowedParams(void* texture_handle,
+                                      void* windowed_handle, int32_t xoffset,
+                                      int32_t yoffset, int32_t zoffset,
+                                      int32_t width, int32_t height,
+                                      int32_t depth, void* data_ptr,
+                                      int32_t level, Format format,
+                                      int32_t window_low, int32_t window_high) {
+  std::shared_ptr<TextureSubImage3DParams> params(
+      new TextureSubImage3DParams());
+  // rejected calls upload nothing
+  if (format != R16_UINT && format != R16UI) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": format " << format << " is not a 16-bit format";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    params->skip = true;
+    SetTextureSubImage3DParams(params);
+    return;
+  }
+  // the windowed texels never reach the host
+  if (s_MipChains.IsDownsampledOnHost(windowed_handle)) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": the mip chain of texture " << windowed_handle
+       << " is downsampled on the host, windowed texels can only be written "
+          "to textures whose mip chains are regenerated on the GPU";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    params->skip = true;
+    SetTextureSubImage3DParams(params);
+    return;
+  }
+  PrepareTextureSubImage3D(texture_handle, xoffset, yoffset, zoffset, width,
+                           height, depth, data_ptr, PackedSourceLayout(),
+                           level, format, *params);
+  params->windowed_handle = windowed_handle;
+  params->window_low = ClampWindowBound(window_low);
+  params->window_high = ClampWindowBound(window_high);
+  s_ContentHashes.Invalidate(windowed_handle, xoffset, yoffset, zoffset, width,
+                             height, depth, level);
+  SetTextureSubImage3DParams(params);
+}
+
+/// @brief Same as UpdateTextureSubImage3DParams but the source is a brick
+/// encoded with the lossless R16 codec (see DeltaCodec.h), whose extents are
+/// taken from its header. The next TextureSubImage3D event decodes it on the
+/// GPU where the backend supports compute shaders and on the render thread
+/// otherwise. The encoded brick has to stay valid until the event executed.
+/// Bricks of textures whose mip chains are downsampled on the host are
+/// decoded on the calling thread instead.
+/// @param format R16_UINT or R16UI
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UpdateTextureSubImage3DDeltaR16Params(void* texture_handle, int32_t xoffset,
+                                      int32_t yoffset, int32_t zoffset,
+                                      void* encoded_ptr, uint64_t encoded_size,
+                                      int32_t level, Format format) {
+  DeltaCodecHeader header;
+  size_t data_offset;
+  bool valid = ReadDeltaR16Header(encoded_ptr, (size_t)encoded_size, header,
+                                  data_offset);
+  if (!valid) {
+    header.width = header.height = header.depth = 0;
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": payload of " << encoded_size
+       << " bytes is not a delta-coded brick";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  } else if (format != R16_UINT && format != R16UI) {
+    valid = false;
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": format " << format << " is not a 16-bit format";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  }
+  std::shared_ptr<TextureSubImage3DParams> params(
+      new TextureSubImage3DParams());
+  // mip chains downsampled on the host need the decoded texels, the brick is
+  // decoded on the calling thread and uploaded like raw texels then
+  if (valid && s_MipChains.IsDownsampledOnHost(texture_handle)) {
+    size_t size =
+        TextureDataSize(format, header.width, header.height, header.depth);
+    std::shared_ptr<uint8_t> decoded = g_StagingAllocator.Allocate(size);
+    if (decoded && Decompress(kCodecDeltaR16, encoded_ptr,
+                              (size_t)encoded_size, decoded.get(), size)) {
+      PrepareTextureSubImage3D(texture_handle, xoffset, yoffset, zoffset,
+                               header.width, header.height, header.depth,
+                               decoded.get(), PackedSourceLayout(), level,
+                               format, *params);
+      // encoded blocks replace the decoded texels
+      if (!params->storage) params->storage = decoded;
+    } else {
+      std::ostringstream ss;
+      ss << __FUNCTION__ << ": cannot decode the brick of " << encoded_size
+         << " bytes";
+      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+      params->skip = true;
+    }
+    SetTextureSubImage3DParams(params);
+    return;
+  }
+  params->texture_handle = texture_handle;
+  params->xoffset = xoffset;
+  params->yoffset = yoffset;
+  params->zoffset = zoffset;
+  params->width = header.width;
+  params->height = header.height;
+  params->depth = header.depth;
+  params->data_ptr = NULL;
+  params->layout = PackedSourceLayout();
+  params->level = level;
+  params->format = format;
+  params->encoded_ptr = encoded_ptr;
+  params->encoded_size = (size_t)encoded_size;
+  params->windowed_handle = NULL;
+  params->skip = !valid;
+  // the content is only known after decoding
+  if (valid) {
+    s_ContentHashes.Invalidate(texture_handle, xoffset, yoffset, zoffset,
+                               header.width, header.height, header.depth,
+                               level);
+  }
+  SetTextureSubImage3DParams(params);
+}
+
+/// @brief Turns an upload into the uploads that actually have to be queued:
+/// drops it if its content is already resident, leaves out empty bricks,
+/// encodes uploads to block-compressed textures and generates the coarser
+/// levels of mip chains (queued first). Runs on the submitting (or a worker)
+/// thread.
+/// @param uploads receives the uploads to queue, empty if none
+static void PrepareUploads(const UploadCommand& cmd,
+                           std::vector<UploadCommand>& uploads) {
+  if (s_ContentHashes.IsRedundant(cmd.texture_handle, cmd.xoffset,
+                                  cmd.yoffset, cmd.zoffset, cmd.width,
+                                  cmd.height, cmd.depth, cmd.data_ptr,
+                                  cmd.layout, cmd.level, cmd.format)) {
+    return;
+  }
+
+  // computes the per-brick statistics and leaves out empty bricks, which
+  // keep their previous content on the GPU
+  if (s_BrickStatistics.Analyze(cmd, uploads)) InvalidateContentHash(cmd);
+
+  // encodes the uploads to block-compressed textures
+  for (size_t i = 0; i < uploads.size();) {
+    UploadCommand compressed;
+    if (!s_BlockCompressor.IsRegistered(uploads[i].texture_handle)) {
+      ++i;
+    } else if (s_BlockCompressor.Compress(uploads[i], compressed)) {
+      uploads[i++] = compressed;
+    } else {
+      InvalidateContentHash(uploads[i]);
+      uploads.erase(uploads.begin() + i);
+    }
+  }
+
+  // the coarser levels are generated even if every brick was left out as
+  // empty, they would show the region's previous content otherwise
+  std::vector<UploadCommand> mips;
+  if (!s_MipChains.Downsample(cmd, mips)) return;
+  // the generated content is not hashed
+  for (size_t i = 0; i < mips.size(); ++i) InvalidateContentHash(mips[i]);
+  uploads.insert(uploads.begin(), mips.begin(), mips.end());
+}
+
+/// @brief Queues a sub-region upload of a sub-box of a larger host volume
+/// (see UpdateTextureSubImage3DStridedParams) to be executed by the next
+/// FlushUploadQueue event.
+/// @return ticket of the upload, see IsUploadComplete
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueueTextureSubImage3DStrided(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr,
+    int32_t src_row_length, int32_t src_image_height, int32_t src_xoffset,
+    int32_t src_yoffset, int32_t src_zoffset, int32_t level, Format format) {
+  UploadCommand cmd;
+  cmd.texture_handle = texture_handle;
+  cmd.xoffset = xoffset;
+  cmd.yoffset = yoffset;
+  cmd.zoffset = zoffset;
+  cmd.width = width;
+  cmd.height = height;
+  cmd.depth = depth;
+  cmd.data_ptr = data_ptr;
+  cmd.layout.row_length = src_row_length;
+  cmd.layout.image_height = src_image_height;
+  cmd.layout.skip_texels = src_xoffset;
+  cmd.layout.skip_rows = src_yoffset;
+  cmd.layout.skip_images = src_zoffset;
+  cmd.level = level;
+  cmd.format = format;
+  if (s_MipChains.IsDownsampledOnHost(texture_handle)) {
+    // the coarser levels are generated on a worker thread
+    uint64_t ticket = s_UploadQueue.Reserve();
+    s_WorkerPool.Submit([=]() {
+      std::vector<UploadCommand> uploads;
+      PrepareUploads(cmd, uploads);
+      s_UploadQueue.Fulfill(ticket, uploads.empty() ? NULL : &uploads[0],
+                            uploads.size());
+    });
+    return ticket;
+  }
+  std::vector<UploadCommand> uploads;
+  PrepareUploads(cmd, uploads);
+  if (uploads.empty()) return s_UploadQueue.Drop();
+  return s_UploadQueue.Push(&uploads[0], uploads.size());
+}
+
+/// @brief Queues a sub-region upload to be executed by the next
+/// FlushUploadQueue event. Queued uploads to the same texture, level and
+/// format that tile a larger box are coalesced into fewer, larger uploads.
+/// The memory pointed to by data_ptr has to stay valid (i.e., pinned) until
+/// the returned ticket is reported complete by IsUploadComplete.
+/// @return ticket of the upload
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueueTextureSubImage3D(void* texture_handle, int32_t xoffset,
+                         int32_t yoffset, int32_t zoffset, int32_t width,
+                         int32_t height, int32_t depth, void* data_ptr,
+                         int32_t level, Format format) {
+  return EnqueueTextureSubImage3DStrided(texture_handle, xoffset, yoffset,
+                                         zoffset, width, height, depth,
+                                         data_ptr, 0, 0, 0, 0, 0, level,
+                                         format);
+}
+
+/// @brief Queues a sub-region upload whose source is compressed (e.g., an
+/// LZ4/Zstd-compressed brick read from disk). The payload is copied, so it
+/// can be released as soon as this returns. It is decompressed on a native
+/// worker thread into a staging buffer owned by the plugin, which is then
+/// queued like EnqueueTextureSubImage3D queues its source. Uploads are
+/// queued in the order their decompression completes.
+/// @param compressed_ptr compressed, tightly packed texels of the box
+/// @param compressed_size size in bytes of the compressed payload
+/// @param codec see Codec in Decompression.h
+/// @param decompressed_size size in bytes of the decompressed texels, has to
+/// be width * height * depth * bytes per texel
+/// @return ticket of the upload, reported complete by IsUploadComplete once
+/// the upload has been executed or failed to decompress
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueueCompressedTextureSubImage3D(void* texture_handle, int32_t xoffset,
+                                   int32_t yoffset, int32_t zoffset,
+                                   int32_t width, int32_t height,
+                                   int32_t depth, void* compressed_ptr,
+                                   uint64_t compressed_size, int32_t codec,
+                                   uint64_t decompressed_size, int32_t level,
+                                   Format format) {
+  if (!IsCodecSupported((Codec)codec) ||
+      decompressed_size != TextureDataSize(format, width, height, depth) ||
+      BytesPerTexel(format) == 0) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": codec " << codec
+       << " is not supported or the decompressed size " << decompressed_size
+       << " does not match the " << width << "x" << height << "x" << depth
+       << " texels of format " << format;
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return s_UploadQueue.Drop();
+  }
+
+  std::shared_ptr<uint8_t> payload =
+      g_StagingAllocator.Allocate((size_t)compressed_size);
+  if (!payload) return s_UploadQueue.Drop();
+  memcpy(payload.get(), compressed_ptr, (size_t)compressed_size);
+
+  UploadCommand cmd;
+  cmd.texture_handle = texture_handle;
+  cmd.xoffset = xoffset;
+  cmd.yoffset = yoffset;
+  cmd.zoffset = zoffset;
+  cmd.width = width;
+  cmd.height = height;
+  cmd.depth = depth;
+  cmd.data_ptr = NULL;
+  cmd.layout = PackedSourceLayout();
+  cmd.level = level;
+  cmd.format = format;
+
+  uint64_t ticket = s_UploadQueue.Reserve();
+  s_WorkerPool.Submit([=]() mutable {
+    // decompressed straight into the buffer the upload is executed from
+    std::shared_ptr<uint8_t> staging =
+        g_StagingAllocator.Allocate((size_t)decompressed_size);
+    std::vector<UploadCommand> uploads;
+    if (staging &&
+        Decompress((Codec)codec, payload.get(), (size_t)compressed_size,
+                   staging.get(), (size_t)decompressed_size)) {
+      cmd.data_ptr = staging.get();
+      cmd.storage = staging;
+      PrepareUploads(cmd, uploads);
+    }
+    s_UploadQueue.Fulfill(ticket, uploads.empty() ? NULL : &uploads[0],
+                          uploads.size());
+  });
+  return ticket;
+}
+
+/// @brief Memory-maps a raw volume file (texels of a single format, x
+/// fastest, then y, then z) so that its bricks can be uploaded with
+/// EnqueueMappedTextureSubImage3D without passing through C#.
+/// @param path path of the file
+/// @param header_offset offset in bytes of the first texel within the file
+/// @return id of the volume, 0 (and logs an error) if the file cannot be
+/// mapped
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+RegisterMappedVolume(const char* path, int32_t width, int32_t height,
+                     int32_t depth, Format format, uint64_t header_offset) {
+  std::shared_ptr<MappedVolume> volume(new MappedVolume());
+  if (!volume->Open(path, width, height, depth, format, header_offset))
+    return 0;
+  return s_MappedVolumes.Register(volume);
+}
+
+/// @brief Unregisters a mapped volume. The file is unmapped once the queued
+/// uploads of its bricks have been gathered.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UnregisterMappedVolume(int32_t volume_id) {
+  s_MappedVolumes.Unregister(volume_id);
+}
+
+/// @brief Queues a sub-region upload whose source is a box of a mapped
+/// volume (see RegisterMappedVolume), named by its coordinates. The OS is
+/// asked to read the box's pages ahead right away, a native worker thread
+/// then gathers its rows from the page cache into a staging buffer owned by
+/// the plugin (so that page faults never stall the render thread), which is
+/// queued like EnqueueTextureSubImage3D queues its source. The format of the
+/// upload is the volume's.
+/// @param volume_id id returned by RegisterMappedVolume
+/// @param src_xoffset x offset of the box within the volume
+/// @param src_yoffset y offset of the box within the volume
+/// @param src_zoffset z offset of the box within the volume
+/// @return ticket of the upload, reported complete by IsUploadComplete once
+/// the upload has been executed
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueueMappedTextureSubImage3D(void* texture_handle, int32_t xoffset,
+                               int32_t yoffset, int32_t zoffset, int32_t width,
+                               int32_t height, int32_t depth, int32_t volume_id,
+                               int32_t src_xoffset, int32_t src_yoffset,
+                               int32_t src_zoffset, int32_t level) {
+  std::shared_ptr<MappedVolume> volume = s_MappedVolumes.Find(volume_id);
+  if (!volume || !volume->Contains(src_xoffset, src_yoffset, src_zoffset,
+                                   width, height, depth)) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": volume " << volume_id
+       << " is not registered or does not contain the " << width << "x"
+       << height << "x" << depth << " box at (" << src_xoffset << ", "
+       << src_yoffset << ", " << src_zoffset << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return s_UploadQueue.Drop();
+  }
+  volume->WillNeed(src_xoffset, src_yoffset, src_zoffset, width, height,
+                   depth);
+
+  UploadCommand cmd;
+  cmd.texture_handle = texture_handle;
+  cmd.xoffset = xoffset;
+  cmd.yoffset = yoffset;
+  cmd.zoffset = zoffset;
+  cmd.width = width;
+  cmd.height = height;
+  cmd.depth = depth;
+  cmd.data_ptr = NULL;
+  cmd.layout = PackedSourceLayout();
+  cmd.level = level;
+  cmd.format = volume->format();
+
+  uint64_t ticket = s_UploadQueue.Reserve();
+  s_WorkerPool.Submit([=]() mutable {
+    size_t size = TextureDataSize(cmd.format, width, height, depth);
+    std::shared_ptr<uint8_t> staging = g_StagingAllocator.Allocate(size);
+    std::vector<UploadCommand> uploads;
+    if (staging) {
+      volume->Gather(src_xoffset, src_yoffset, src_zoffset, width, height,
+                     depth, staging.get());
+      cmd.data_ptr = staging.get();
+      cmd.storage = staging;
+      PrepareUploads(cmd, uploads);
+    }
+    s_UploadQueue.Fulfill(ticket, uploads.empty() ? NULL : &uploads[0],
+                          uploads.size());
+  });
+  return ticket;
+}
+
+/// @brief Queues an upload whose tightly packed source is written into a
+/// staging buffer owned by the plugin by gather(dst) on a worker thread.
+template <typename Gather>
+static uint64_t EnqueueGatheredUpload(UploadCommand cmd, Gather gather) {
+  uint64_t ticket = s_UploadQueue.Reserve();
+  s_WorkerPool.Submit([=]() mutable {
+    size_t size =
+        TextureDataSize(cmd.format, cmd.width, cmd.height, cmd.depth);
+    std::shared_ptr<uint8_t> staging = g_StagingAllocator.Allocate(size);
+    std::vector<UploadCommand> uploads;
+    if (staging) {
+      gather(staging.get());
+      cmd.data_ptr = staging.get();
+      cmd.storage = staging;
+      PrepareUploads(cmd, uploads);
+    }
+    s_UploadQueue.Fulfill(ticket, uploads.empty() ? NULL : &uploads[0],
+                          uploads.size());
+  });
+  return ticket;
+}
+
+/// @brief Validates the parameters of a padded brick upload and sets up its
+/// command, whose box is the brick grown by halo texels on every side.
+/// @return false (and logs an error) if they are invalid
+static bool SetUpPaddedUpload(const char* caller, void* texture_handle,
+                              int32_t xoffset, int32_t yoffset,
+                              int32_t zoffset, int32_t width, int32_t height,
+                              int32_t depth, int32_t halo, int32_t level,
+                              Format format, bool contained,
+                              UploadCommand& cmd) {
+  if (!contained || halo < 0 || halo > kMaxBrickHalo ||
+      BytesPerTexel(format) == 0 || xoffset < 0 || yoffset < 0 ||
+      zoffset < 0) {
+    std::ostringstream ss;
+    ss << caller << ": invalid " << width << "x" << height << "x" << depth
+       << " brick with a halo of " << halo << " texels (at most "
+       << kMaxBrickHalo << ") at (" << xoffset << ", " << yoffset << ", "
+       << zoffset << "), it has to lie within its volume and have an "
+       << "uncompressed format (" << format << ")";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return false;
+  }
+  cmd.texture_handle = texture_handle;
+  cmd.xoffset = xoffset;
+  cmd.yoffset = yoffset;
+  cmd.zoffset = zoffset;
+  cmd.width = width + 2 * halo;
+  cmd.height = height + 2 * halo;
+  cmd.depth = depth + 2 * halo;
+  cmd.data_ptr = NULL;
+  cmd.layout = PackedSourceLayout();
+  cmd.level = level;
+  cmd.format = format;
+  return true;
+}
+
+/// @brief Queues the upload of a brick of a host volume padded with a halo
+/// (apron) of halo texels on every side, copied from its neighbours, so that
+/// bricks of an atlas can be sampled with hardware (trilinear) filtering
+/// without seams or manual neighbour lookups. The padded brick is gathered
+/// into a staging buffer on a native worker thread and uploaded as a single
+/// (width + 2 * halo) x (height + 2 * halo) x (depth + 2 * halo) box. Halo
+/// texels outside the volume repeat its border texels (clamp-to-edge).
+/// @param xoffset x offset of the padded box within the texture
+/// @param width width of the brick without its halo
+/// @param data_ptr tightly packed texels of the whole volume, has to stay
+/// valid until the returned ticket is reported complete
+/// @param src_width width of the volume
+/// @param src_xoffset x offset of the brick (without its halo) within the
+/// volume
+/// @param halo texels on each side, at most kMaxBrickHalo (8), usually 1
+/// @return ticket of the upload, see IsUploadComplete
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueuePaddedTextureSubImage3D(
+    void* texture_handle, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr,
+    int32_t src_width, int32_t src_height, int32_t src_depth,
+    int32_t src_xoffset, int32_t src_yoffset, int32_t src_zoffset,
+    int32_t halo, int32_t level, Format format) {
+  bool contained = data_ptr && src_xoffset >= 0 && src_yoffset >= 0 &&
+                   src_zoffset >= 0 && width > 0 && height > 0 &&
+                   depth > 0 && width <= src_width - src_xoffset &&
+                   height <= src_height - src_yoffset &&
+                   depth <= src_depth - src_zoffset;
+  UploadCommand cmd;
+  if (!SetUpPaddedUpload(__FUNCTION__, texture_handle, xoffset, yoffset,
+                         zoffset, width, height, depth, halo, level, format,
+                         contained, cmd))
+    return s_UploadQueue.Drop();
+  uint32_t bytes_per_texel = BytesPerTexel(format);
+  return EnqueueGatheredUpload(cmd, [=](void* dst) {
+    GatherPaddedBox(data_ptr, src_width, src_height, src_depth,
+                    bytes_per_texel, src_xoffset, src_yoffset, src_zoffset,
+                    width, height, depth, halo, dst);
+  });
+}
+
+/// @brief Same as EnqueuePaddedTextureSubImage3D, but the brick and its halo
+/// are gathered from a mapped volume (see RegisterMappedVolume), whose format
+/// is the upload's.
+/// @param src_xoffset x offset of the brick (without its halo) within the
+/// volume
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueuePaddedMappedTextureSubImage3D(void* texture_handle, int32_t xoffset,
+                                     int32_t yoffset, int32_t zoffset,
+                                     int32_t width, int32_t height,
+                                     int32_t depth, int32_t volume_id,
+                                     int32_t src_xoffset, int32_t src_yoffset,
+                                     int32_t src_zoffset, int32_t halo,
+                                     int32_t level) {
+  std::shared_ptr<MappedVolume> volume = s_MappedVolumes.Find(volume_id);
+  bool contained = volume && volume->Contains(src_xoffset, src_yoffset,
+                                              src_zoffset, width, height,
+                                              depth);
+  UploadCommand cmd;
+  if (!SetUpPaddedUpload(__FUNCTION__, texture_handle, xoffset, yoffset,
+                         zoffset, width, height, depth, halo, level,
+                         volume ? volume->format() : R8_UINT, contained, cmd))
+    return s_UploadQueue.Drop();
+  volume->WillNeed(src_xoffset, src_yoffset, src_zoffset, width, height,
+                   depth);
+  return EnqueueGatheredUpload(cmd, [=](void* dst) {
+    volume->GatherPadded(src_xoffset, src_yoffset, src_zoffset, width,
+                         height, depth, halo, dst);
+  });
+}
+
+/// @brief Sets up the repacking of a stream of z-slices (full xy planes, x
+/// fastest) of a volume into bricks of a texture (see AddRepackerSlice), so
+/// that slice-major acquisitions do not have to be transposed in C#.
+/// @param width width of the volume (and of its slices)
+/// @param brick_size extent of the bricks along every axis
+/// @return id of the repacker, 0 (and logs an error) if the parameters are
+/// invalid
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+CreateSliceRepacker(void* texture_handle, int32_t width, int32_t height,
+                    int32_t depth, Format format, int32_t brick_size,
+                    int32_t level) {
+  std::shared_ptr<SliceRepacker> repacker(new SliceRepacker());
+  if (!repacker->Configure(texture_handle, width, height, depth, format,
+                           brick_size, level))
+    return 0;
+  return s_SliceRepackers.Register(repacker);
+}
+
+/// @brief Releases a repacker. Slabs whose slices have not all been added
+/// are dropped, completed slabs are still uploaded.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+DestroySliceRepacker(int32_t repacker_id) {
+  s_SliceRepackers.Unregister(repacker_id);
+}
+
+/// @brief Cuts a row of bricks of a completed slab and queues the bricks of
+/// the slab once its last row has been cut. Rows that cannot be cut for lack
+/// of staging buffers are kept for RetryUncutRows. Runs on a worker thread.
+/// @param retry whether the row failed to be cut before (logged once)
+static void CutSlabRow(const std::shared_ptr<SlabCut>& cut, int32_t row,
+                       bool retry) {
+  std::vector<UploadCommand> bricks;
+  if (!cut->repacker->CutBrickRow(cut->slab, row, bricks)) {
+    if (!retry) {
+      std::ostringstream ss;
+      ss << __FUNCTION__ << ": no staging buffer for row " << row
+         << " of the slab at z = " << cut->slab.z
+         << ", retrying after the next flush";
+      UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    }
+    std::lock_guard<std::mutex> lock(s_UncutRowsMutex);
+    s_UncutRows.push_back(std::make_pair(cut, row));
+    return;
+  }
+  std::vector<UploadCommand> uploads;
+  std::vector<UploadCommand> prepared;
+  for (size_t i = 0; i < bricks.size(); ++i) {
+    prepared.clear();
+    PrepareUploads(bricks[i], prepared);
+    uploads.insert(uploads.end(), prepared.begin(), prepared.end());
+  }
+  std::lock_guard<std::mutex> lock(cut->mutex);
+  cut->uploads.insert(cut->uploads.end(), uploads.begin(), uploads.end());
+  if (--cut->remaining > 0) return;
+  s_UploadQueue.Fulfill(cut->ticket,
+                        cut->uploads.empty() ? NULL : &cut->uploads[0],
+                        cut->uploads.size());
+  cut->uploads.clear();
+}
+
+/// @brief Cuts the rows kept by CutSlabRow again, once a flush has released
+/// the staging buffers of the executed uploads. Called on the render thread.
+static void RetryUncutRows() {
+  std::vector<std::pair<std::shared_ptr<SlabCut>, int32_t> > rows;
+  {
+    std::lock_guard<std::mutex> lock(s_UncutRowsMutex);
+    rows.swap(s_UncutRows);
+  }
+  for (size_t i = 0; i < rows.size(); ++i) {
+    std::shared_ptr<SlabCut> cut = rows[i].first;
+    int32_t row = rows[i].second;
+    s_WorkerPool.Submit([=]() { CutSlabRow(cut, row, true); });
+  }
+}
+
+/// @brief Copies a tightly packed slice into its slab of brick_size slices,
+/// so that the slice can be reused as soon as this returns. Slices can be
+/// added in any order and from several threads. Once the last slice of a
+/// slab has been added, the slab is cut into bricks on native worker threads
+/// (one task per row of bricks, reading the slab sequentially) and the
+/// bricks are queued like EnqueueTextureSubImage3D queues its source, to be
+/// executed by FlushUploadQueue events. Rows that cannot be cut for lack of
+/// staging buffers are cut again after the next FlushUploadQueue event.
+/// @param z index of the slice within the volume
+/// @return ticket of the bricks of the slab if the slice completed it (see
+/// IsUploadComplete), 0 otherwise or (logging an error) if the slice is
+/// invalid
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+AddRepackerSlice(int32_t repacker_id, int32_t z, void* slice_ptr) {
+  std::shared_ptr<SliceRepacker> repacker =
+      s_SliceRepackers.Find(repacker_id);
+  SliceRepacker::Slab slab;
+  bool complete = false;
+  if (!repacker) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": repacker " << repacker_id
+       << " is not registered";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return 0;
+  }
+  if (!repacker->AddSlice(z, slice_ptr, slab, complete) || !complete)
+    return 0;
+
+  std::shared_ptr<SlabCut> cut(new SlabCut());
+  cut->repacker = repacker;
+  cut->slab = slab;
+  cut->ticket = s_UploadQueue.Reserve();
+  cut->remaining = repacker->brick_rows();
+  for (int32_t row = 0; row < repacker->brick_rows(); ++row)
+    s_WorkerPool.Submit([=]() { CutSlabRow(cut, row, false); });
+  return cut->ticket;
+}
+
+/// @brief Allocates a zero-filled host volume stored in tiles of 16^3 texels
+/// in Morton (Z-) order (see SwizzledVolume.h), from which bricks are
+/// extracted by reading a few contiguous runs of memory instead of one cache
+/// line per row and slice. Fill it with WriteSwizzledVolume.
+/// @return id of the volume, 0 (and logs an error) if it cannot be allocated
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+CreateSwizzledVolume(int32_t width, int32_t height, int32_t depth,
+                     Format format) {
+  std::shared_ptr<SwizzledVolume> volume(new SwizzledVolume());
+  if (!volume->Allocate(width, height, depth, format)) return 0;
+  return s_SwizzledVolumes.Register(volume);
+}
+
+/// @brief Releases a swizzled volume once the queued uploads of its bricks
+/// have been extracted.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+DestroySwizzledVolume(int32_t volume_id) {
+  s_SwizzledVolumes.Unregister(volume_id);
+}
+
+/// @brief Looks up a swizzled volume that contains a box.
+/// @return NULL (and logs an error) if there is none
+static std::shared_ptr<SwizzledVolume> FindSwizzledVolume(
+    const char* caller, int32_t volume_id, int32_t x, int32_t y, int32_t z,
+    int32_t width, int32_t height, int32_t depth) {
+  std::shared_ptr<SwizzledVolume> volume = s_SwizzledVolumes.Find(volume_id);
+  if (volume && volume->Contains(x, y, z, width, height, depth))
+    return volume;
+  std::ostringstream ss;
+  ss << caller << ": volume " << volume_id
+     << " is not registered or does not contain the " << width << "x"
+     << height << "x" << depth << " box at (" << x << ", " << y << ", " << z
+     << ")";
+  UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+  return std::shared_ptr<SwizzledVolume>();
+}
+
+/// @brief Converts a box of linear texels (x fastest, tightly packed) into
+/// the tiles of a swizzled volume, e.g., the whole volume at once or slices
+/// as they are loaded. Boxes that do not overlap can be written from several
+/// threads.
+/// @return 0 (and logs an error) if the volume does not contain the box
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+WriteSwizzledVolume(int32_t volume_id, int32_t xoffset, int32_t yoffset,
+                    int32_t zoffset, int32_t width, int32_t height,
+                    int32_t depth, void* src) {
+  std::shared_ptr<SwizzledVolume> volume =
+      FindSwizzledVolume(__FUNCTION__, volume_id, xoffset, yoffset, zoffset,
+                         width, height, depth);
+  if (!volume || !src) return 0;
+  volume->Write(xoffset, yoffset, zoffset, width, height, depth, src);
+  return 1;
+}
+
+/// @brief Converts a box of a swizzled volume back into tightly packed
+/// linear texels.
+/// @return 0 (and logs an error) if the volume does not contain the box
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+ReadSwizzledVolume(int32_t volume_id, int32_t xoffset, int32_t yoffset,
+                   int32_t zoffset, int32_t width, int32_t height,
+                   int32_t depth, void* dst) {
+  std::shared_ptr<SwizzledVolume> volume =
+      FindSwizzledVolume(__FUNCTION__, volume_id, xoffset, yoffset, zoffset,
+                         width, height, depth);
+  if (!volume || !dst) return 0;
+  volume->Extract(xoffset, yoffset, zoffset, width, height, depth, dst);
+  return 1;
+}
+
+/// @brief Queues the upload of a brick of a swizzled volume, optionally
+/// padded with a halo (see EnqueuePaddedTextureSubImage3D). A native worker
+/// thread extracts it, tile by tile, into a staging buffer that is queued
+/// like EnqueueTextureSubImage3D queues its source. The format of the upload
+/// is the volume's.
+/// @param xoffset x offset of the (padded) box within the texture
+/// @param src_xoffset x offset of the brick (without its halo) within the
+/// volume
+/// @param halo texels on each side, 0 for none
+/// @return ticket of the upload, see IsUploadComplete
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueueSwizzledTextureSubImage3D(void* texture_handle, int32_t xoffset,
+                                 int32_t yoffset, int32_t zoffset,
+                                 int32_t width, int32_t height, int32_t depth,
+                                 int32_t volume_id, int32_t src_xoffset,
+                                 int32_t src_yoffset, int32_t src_zoffset,
+                                 int32_t halo, int32_t level) {
+  std::shared_ptr<SwizzledVolume> volume = s_SwizzledVolumes.Find(volume_id);
+  bool contained = volume && volume->Contains(src_xoffset, src_yoffset,
+                                              src_zoffset, width, height,
+                                              depth);
+  UploadCommand cmd;
+  if (!SetUpPaddedUpload(__FUNCTION__, texture_handle, xoffset, yoffset,
+                         zoffset, width, height, depth, halo, level,
+                         volume ? volume->format() : R8_UINT, contained, cmd))
+    return s_UploadQueue.Drop();
+  return EnqueueGatheredUpload(cmd, [=](void* dst) {
+    if (halo == 0) {
+      volume->Extract(src_xoffset, src_yoffset, src_zoffset, width, height,
+                      depth, dst);
+    } else {
+      volume->ExtractPadded(src_xoffset, src_yoffset, src_zoffset, width,
+                            height, depth, halo, dst);
+    }
+  });
+}
+
+/// @brief Opens a bricked multi-resolution volume file (see BrickedVolume.h
+/// and tools/BrickBuilder.cpp) and reads its index.
+/// @return id of the volume, 0 (and logs an error) if the file cannot be read
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+RegisterBrickedVolume(const char* path) {
+  std::shared_ptr<BrickedVolume> volume(new BrickedVolume());
+  if (!volume->Open(path)) return 0;
+  return s_BrickedVolumes.Register(volume);
+}
+
+/// @brief Unregisters a bricked volume. The file is closed once the queued
+/// uploads of its bricks have been read.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UnregisterBrickedVolume(int32_t volume_id) {
+  s_BrickedVolumes.Unregister(volume_id);
+  s_BrickPrefetcher.Forget(volume_id);
+  s_BrickCache.Forget(volume_id);
+}
+
+/// @brief Retrieves the format, brick size and number of levels of a bricked
+/// volume.
+/// @return 1 if the volume is registered, 0 otherwise
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetBrickedVolumeInfo(int32_t volume_id, int32_t* format, int32_t* brick_size,
+                     int32_t* level_count) {
+  std::shared_ptr<BrickedVolume> volume = s_BrickedVolumes.Find(volume_id);
+  if (!volume) return 0;
+  *format = volume->header().format;
+  *brick_size = volume->header().brick_size;
+  *level_count = volume->header().level_count;
+  return 1;
+}
+
+/// @brief Retrieves the extents of a level of a bricked volume and its number
+/// of bricks along every axis.
+/// @return 1 if the volume is registered and has the level, 0 otherwise
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetBrickedVolumeLevel(int32_t volume_id, int32_t level, int32_t* width,
+                      int32_t* height, int32_t* depth, int32_t* bricks_x,
+                      int32_t* bricks_y, int32_t* bricks_z) {
+  std::shared_ptr<BrickedVolume> volume = s_BrickedVolumes.Find(volume_id);
+  if (!volume || level < 0 || level >= volume->header().level_count) return 0;
+  BrickedVolumeLevelExtents(volume->header(), level, *width, *height, *depth);
+  BrickedVolumeLevelBricks(volume->header(), level, *bricks_x, *bricks_y,
+                           *bricks_z);
+  return 1;
+}
+
+/// @brief Retrieves the minimum and maximum texel value of a brick of a
+/// bricked volume from its index (e.g., to skip empty bricks before reading
+/// them).
+/// @return 1 if the brick exists, 0 otherwise
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetBrickedVolumeBrickRange(int32_t volume_id, int32_t level, int32_t brick_x,
+                           int32_t brick_y, int32_t brick_z, uint32_t* min,
+                           uint32_t* max) {
+  std::shared_ptr<BrickedVolume> volume = s_BrickedVolumes.Find(volume_id);
+  BrickedVolumeBrick brick;
+  if (!volume || !volume->FindBrick(level, brick_x, brick_y, brick_z, brick))
+    return 0;
+  *min = brick.entry.min;
+  *max = brick.entry.max;
+  return 1;
+}
+
+/// @brief Decodes the stored extent of a brick into a staging buffer owned by
+/// the plugin.
+/// @param stored stored extent of the brick. If NULL, the extent is read
+/// from the file and, if the brick is compressed, returned through stored.
+/// @return the brick's texels, NULL if it cannot be read or decoded
+static std::shared_ptr<uint8_t> LoadBrick(const BrickedVolume& volume,
+                                          const BrickedVolumeBrick& brick,
+                                          std::shared_ptr<uint8_t>& stored) {
+  size_t size = TextureDataSize(volume.format(), brick.width, brick.height,
+                                brick.depth);
+  bool uncompressed =
+      brick.entry.codec == kCodecNone && brick.entry.size == size;
+  if (stored && uncompressed) return stored;
+  std::shared_ptr<uint8_t> staging = g_StagingAllocator.Allocate(size);
+  bool loaded = staging != NULL;
+  if (uncompressed) {
+    // uncompressed bricks are read straight into the staging buffer
+    loaded = loaded && volume.ReadBrick(brick, staging.get());
+  } else {
+    if (loaded && !stored) {
+      stored = g_StagingAllocator.Allocate(brick.entry.size);
+      loaded = stored && volume.ReadBrick(brick, stored.get());
+    }
+    loaded = loaded && Decompress((Codec)brick.entry.codec, stored.get(),
+                                  brick.entry.size, staging.get(), size);
+  }
+  return loaded ? staging : std::shared_ptr<uint8_t>();
+}
+
+/// @brief Fulfills the ticket of the upload of a loaded brick (nothing is
+/// uploaded if staging is NULL).
+static void FulfillBrick(uint64_t ticket, UploadCommand cmd,
+                         const std::shared_ptr<uint8_t>& staging) {
+  std::vector<UploadCommand> uploads;
+  if (staging) {
+    cmd.data_ptr = staging.get();
+    cmd.storage = staging;
+    PrepareUploads(cmd, uploads);
+  }
+  s_UploadQueue.Fulfill(ticket, uploads.empty() ? NULL : &uploads[0],
+                        uploads.size());
+}
+
+/// @brief Loads a brick (see LoadBrick), keeps it in the host cache and
+/// fulfills the ticket of its upload. Runs on a worker thread.
+static void LoadAndFulfillBrick(uint64_t ticket, const UploadCommand& cmd,
+                                const BrickKey& key,
+                                const BrickedVolume& volume,
+                                const BrickedVolumeBrick& brick,
+                                std::shared_ptr<uint8_t> stored) {
+  std::shared_ptr<uint8_t> staging = LoadBrick(volume, brick, stored);
+  if (staging) {
+    s_BrickCache.Insert(
+        key, brick.entry, staging,
+        TextureDataSize(cmd.format, cmd.width, cmd.height, cmd.depth), stored);
+  }
+  FulfillBrick(ticket, cmd, staging);
+}
+
+/// @brief Issues the prefetches of the bricks predicted to follow key as
+/// low-priority worker tasks that load the bricks with blocking reads.
+static void PrefetchBricks(const std::shared_ptr<BrickedVolume>& volume,
+                           const BrickKey& key) {
+  std::vector<BrickKey> candidates;
+  s_BrickPrefetcher.Predict(key, candidates);
+  uint32_t remaining = s_BrickPrefetcher.max_predictions();
+  for (size_t i = 0; i < candidates.size() && remaining > 0; ++i) {
+    BrickKey candidate = candidates[i];
+    BrickedVolumeBrick brick;
+    uint64_t id;
+    // bricks in the hot tier of the host cache are loaded already
+    if (!volume->FindBrick(candidate.level, candidate.x, candidate.y,
+                           candidate.z, brick) ||
+        s_BrickCache.ContainsDecoded(candidate) ||
+        !s_BrickPrefetcher.Issue(candidate, id))
+      continue;
+    --remaining;
+    s_WorkerPool.SubmitLowPriority([=]() {
+      // canceled or requested prefetches are dropped before they are read
+      if (!s_BrickPrefetcher.Begin(candidate, id)) return;
+      std::shared_ptr<uint8_t> stored;
+      s_BrickPrefetcher.Complete(candidate, id,
+                                 LoadBrick(*volume, brick, stored),
+                                 TextureDataSize(volume->format(), brick.width,
+                                                 brick.height, brick.depth));
+    });
+  }
+}
+
+/// @brief Queues the upload of a brick of a bricked volume, named by its
+/// level and brick coordinates, to a sub-region of a texture. A native worker
+/// thread reads the brick's stored extent with a single positional read (or
+/// the read is queued to io_uring, see SetBrickReadQueue), decompresses it if
+/// needed into a staging buffer owned by the plugin and queues it like
+/// EnqueueTextureSubImage3D queues its source. The extents and format of the
+/// upload are the brick's (smaller than the brick size at the upper borders
+/// of a level).
+/// @param volume_id id returned by RegisterBrickedVolume
+/// @param volume_level resolution level of the brick, 0 is the finest
+/// @param level mip level of the texture
+/// @return ticket of the upload, reported complete by IsUploadComplete once
+/// the upload has been executed or failed to be read
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueueBrickedTextureSubImage3D(void* texture_handle, int32_t xoffset,
+                                int32_t yoffset, int32_t zoffset,
+                                int32_t volume_id, int32_t volume_level,
+                                int32_t brick_x, int32_t brick_y,
+                                int32_t brick_z, int32_t level) {
+  std::shared_ptr<BrickedVolume> volume = s_BrickedVolumes.Find(volume_id);
+  BrickedVolumeBrick brick;
+  if (!volume || !volume->FindBrick(volume_level, brick_x, brick_y, brick_z,
+                                    brick)) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": volume " << volume_id
+       << " is not registered or has no brick (" << brick_x << ", " << brick_y
+       << ", " << brick_z << ") on level " << volume_level;
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return s_UploadQueue.Drop();
+  }
+
+  UploadCommand cmd;
+  cmd.texture_handle = texture_handle;
+  cmd.xoffset = xoffset;
+  cmd.yoffset = yoffset;
+  cmd.zoffset = zoffset;
+  cmd.width = brick.width;
+  cmd.height = brick.height;
+  cmd.depth = brick.depth;
+  cmd.data_ptr = NULL;
+  cmd.layout = PackedSourceLayout();
+  cmd.level = level;
+  cmd.format = volume->format();
+
+  uint64_t ticket = s_UploadQueue.Reserve();
+  BrickKey key = {volume_id, volume_level, brick_x, brick_y, brick_z};
+  bool prefetching = s_BrickPrefetcher.max_predictions() > 0;
+  bool loaded = false;
+  if (prefetching) {
+    loaded = s_BrickPrefetcher.Request(
+        key, [=](const std::shared_ptr<uint8_t>& staging) {
+          if (!staging) {
+            s_WorkerPool.Submit([=]() {
+              LoadAndFulfillBrick(ticket, cmd, key, *volume, brick, staging);
+            });
+            return;
+          }
+          s_BrickCache.Insert(
+              key, brick.entry, staging,
+              TextureDataSize(cmd.format, cmd.width, cmd.height, cmd.depth),
+              std::shared_ptr<uint8_t>());
+          FulfillBrick(ticket, cmd, staging);
+        });
+  }
+  std::shared_ptr<uint8_t> decoded, stored;
+  if (!loaded && s_BrickCache.Find(key, decoded, stored)) {
+    // decoded bricks go straight to the upload queue, compressed ones are
+    // decoded on a worker thread
+    loaded = true;
+    if (decoded) {
+      FulfillBrick(ticket, cmd, decoded);
+    } else {
+      s_WorkerPool.Submit([=]() {
+        LoadAndFulfillBrick(ticket, cmd, key, *volume, brick, stored);
+      });
+    }
+  }
+  if (prefetching) PrefetchBricks(volume, key);
+  if (loaded) return ticket;
+
+  bool direct = s_DirectBrickReads && volume->descriptor(true) >= 0;
+  int fd = volume->descriptor(direct);
+  if (fd < 0 || !s_ReadQueue.IsRunning()) {
+    s_WorkerPool.Submit([=]() {
+      LoadAndFulfillBrick(ticket, cmd, key, *volume, brick,
+                          std::shared_ptr<uint8_t>());
+    });
+    return ticket;
+  }
+
+  // O_DIRECT reads whole aligned blocks into an aligned buffer (bricks are
+  // aligned to the container's alignment)
+  size_t size = brick.entry.size, alignment = 1;
+  if (direct) {
+    alignment = volume->header().alignment;
+    size = (size + alignment - 1) / alignment * alignment;
+  }
+  // staging blocks are page aligned, larger alignments are rare
+  std::shared_ptr<uint8_t> buffer = g_StagingAllocator.Allocate(
+      alignment <= 4096 ? size : size + alignment - 1);
+  if (!buffer) {
+    s_WorkerPool.Submit([=]() {
+      LoadAndFulfillBrick(ticket, cmd, key, *volume, brick,
+                          std::shared_ptr<uint8_t>());
+    });
+    return ticket;
+  }
+  std::shared_ptr<uint8_t> payload(
+      buffer, buffer.get() + (alignment - (uintptr_t)buffer.get() % alignment) %
+                                 alignment);
+  s_ReadQueue.Read(
+      fd, brick.entry.offset, payload.get(), size, brick.entry.size,
+      [=](bool success) {
+        // failed reads (e.g., O_DIRECT reads the device's block size does not
+        // allow) are retried as blocking reads
+        std::shared_ptr<uint8_t> stored =
+            success ? payload : std::shared_ptr<uint8_t>();
+        s_WorkerPool.Submit([=]() {
+          LoadAndFulfillBrick(ticket, cmd, key, *volume, brick, stored);
+        });
+      });
+  return ticket;
+}
+
+/// @brief Reads the bricks of bricked volumes through io_uring (Linux 5.6+)
+/// with up to queue_depth reads in flight, submitted by the threads calling
+/// EnqueueBrickedTextureSubImage3D instead of blocking a worker thread per
+/// read. Worker threads only decode the completed reads.
+/// @param queue_depth maximum number of reads in flight, 0 (the default)
+/// reads bricks with blocking reads on the worker threads
+/// @param direct_io whether to read with O_DIRECT, bypassing the page cache,
+/// where the file system allows it
+/// @return 1 if reads go through io_uring, 0 if they fall back to blocking
+/// reads (other platforms, older kernels or io_uring disabled)
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetBrickReadQueue(int32_t queue_depth, int32_t direct_io) {
+  s_DirectBrickReads = direct_io != 0;
+  if (queue_depth <= 0) {
+    s_ReadQueue.Shutdown();
+    return 0;
+  }
+  return s_ReadQueue.Start((uint32_t)queue_depth) ? 1 : 0;
+}
+
+/// @brief Sets the budgets of the host-memory cache of the bricks of bricked
+/// volumes, so that bricks requested again (e.g., after the GPU evicted them)
+/// are not read from the file again. The hot tier keeps decoded bricks that
+/// are queued for upload right away, the warm tier the stored extents of
+/// compressed bricks that are decoded on a worker thread. Both tiers evict
+/// the bricks that are cheapest to load again per byte first
+/// (GreedyDual-Size).
+/// @param hot_bytes budget of the decoded bricks, 0 (the default) disables
+/// the tier
+/// @param warm_bytes budget of the compressed bricks, 0 (the default)
+/// disables the tier
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetBrickCacheBudgets(uint64_t hot_bytes, uint64_t warm_bytes) {
+  s_BrickCache.SetBudgets((size_t)hot_bytes, (size_t)warm_bytes);
+}
+
+/// @brief Retrieves the counters of the host brick cache: the lookups of
+/// EnqueueBrickedTextureSubImage3D served by either tier or by neither and
+/// the current sizes of the tiers.
+/// @param reset whether to reset the lookup counters
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetBrickCacheStatistics(uint64_t* hot_hits, uint64_t* warm_hits,
+                        uint64_t* misses, uint64_t* hot_bytes,
+                        uint64_t* warm_bytes, int32_t reset) {
+  BrickCacheStatistics statistics = s_BrickCache.statistics();
+  if (reset != 0) s_BrickCache.ResetStatistics();
+  *hot_hits = statistics.hot_hits;
+  *warm_hits = statistics.warm_hits;
+  *misses = statistics.misses;
+  *hot_bytes = statistics.hot_bytes;
+  *warm_bytes = statistics.warm_bytes;
+}
+
+/// @brief Enables prefetching of the bricks of bricked volumes. Every
+/// EnqueueBrickedTextureSubImage3D predicts the bricks likely to be requested
+/// next (previous successors of the brick, next brick along the direction of
+/// motion, face neighbours) and loads them on low-priority worker tasks that
+/// only run while no other work is queued. Requests of prefetched bricks skip
+/// reading and decoding them.
+/// @param max_predictions number of bricks prefetched per request, 0 (the
+/// default) disables prefetching
+/// @param max_bytes maximum size of the prefetched bricks kept until they are
+/// requested, oldest dropped first
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetBrickPrefetching(int32_t max_predictions, uint64_t max_bytes) {
+  s_BrickPrefetcher.Configure(
+      max_predictions > 0 ? (uint32_t)max_predictions : 0, (size_t)max_bytes);
+}
+
+/// @brief Drops the prefetched bricks and the prefetches that have not
+/// started (e.g., when the camera jumps). Prefetches requested in the
+/// meantime are completed.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+CancelBrickPrefetches() {
+  s_BrickPrefetcher.Cancel();
+}
+
+/// @brief Retrieves the counters of the brick prefetcher: hits / requests is
+/// the share of requests served by prefetches, wasted / issued the share of
+/// prefetches that were evicted, canceled or failed before being requested.
+/// @param reset whether to reset the counters
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetBrickPrefetchStatistics(uint64_t* requests, uint64_t* hits,
+                           uint64_t* issued, uint64_t* wasted,
+                           int32_t reset) {
+  BrickPrefetchStatistics statistics = s_BrickPrefetcher.statistics();
+  if (reset != 0) s_BrickPrefetcher.ResetStatistics();
+  *requests = statistics.requests;
+  *hits = statistics.hits;
+  *issued = statistics.issued;
+  *wasted = statistics.wasted;
+}
+
+/// @brief Sets the number of native threads decompressing the payloads of
+/// EnqueueCompressedTextureSubImage3D. 0 (the default) uses one thread less
+/// than the number of hardware threads.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetWorkerThreadCount(int32_t count) {
+  s_WorkerPool.SetThreadCount(count > 0 ? (uint32_t)count : 0);
+}
+
+/// @brief Configures the pools of staging buffers (decompressed, gathered
+/// and read bricks, BC4 blocks) the worker threads allocate from. Buffers
+/// come from a "TextureSubPlugin/Staging" allocator of Unity's memory manager
+/// where available.
+/// @param max_pooled_bytes maximum capacity of the released buffers kept for
+/// reuse, 128 MiB by default. 0 frees buffers as soon as they are released.
+/// @param huge_pages whether to back buffers of 2 MiB or more with
+/// transparent huge pages (Linux only)
+/// @param prefault whether to touch the pages of new buffers when they are
+/// allocated instead of on first access
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+ConfigureStagingAllocator(uint64_t max_pooled_bytes, int32_t huge_pages,
+                          int32_t prefault) {
+  g_StagingAllocator.Configure((size_t)max_pooled_bytes, huge_pages != 0,
+                               prefault != 0);
+}
+
+/// @brief Allocates count staging buffers of size bytes into the pools ahead
+/// of time (e.g., while a scene is loading), within the pool budget.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+ReserveStagingBuffers(uint64_t size, int32_t count) {
+  if (count > 0) g_StagingAllocator.Reserve((size_t)size, (uint32_t)count);
+}
+
+/// @brief Retrieves the occupancy of the staging buffers: the capacity of
+/// the buffers in use and its peak, the capacity of the pooled buffers and
+/// the allocations served from the pools or by new buffers.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetStagingStatistics(uint64_t* in_use_bytes, uint64_t* peak_in_use_bytes,
+                     uint64_t* pooled_bytes, uint64_t* pool_hits,
+                     uint64_t* pool_misses) {
+  StagingStatistics statistics = g_StagingAllocator.statistics();
+  *in_use_bytes = statistics.in_use_bytes;
+  *peak_in_use_bytes = statistics.peak_in_use_bytes;
+  *pooled_bytes = statistics.pooled_bytes;
+  *pool_hits = statistics.pool_hits;
+  *pool_misses = statistics.pool_misses;
+}
+
+/// @brief Sets the maximum size in bytes of a coalesced upload. 0 disables
+/// coalescing of queued uploads.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetUploadCoalescingLimit(uint64_t max_bytes) {
+  s_UploadQueue.SetCoalescingLimit((size_t)max_bytes);
+}
+
+/// @brief Sets the size in bytes above which queued uploads are split into
+/// Z-slabs (or Y-tiles). 0 disables splitting.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetUploadSlabSize(uint64_t max_bytes) {
+  s_UploadQueue.SetSlabSize((size_t)max_bytes);
+}
+
+/// @brief Sets the maximum time in milliseconds a FlushUploadQueue event may
+/// spend uploading. Slabs that do not fit into the budget are uploaded by
+/// the following FlushUploadQueue events. 0 disables the budget.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetUploadTimeBudget(float milliseconds) {
+  s_UploadQueue.SetTimeBudget(milliseconds);
+}
+
+/// @brief Enables/disables dropping of uploads to textures created through
+/// CreateTexture3D whose content is identical to the resident content of the
+/// same region. Hashing happens on the thread that submits the upload.
+/// Textures must then only be written through this plugin.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetContentHashing(int32_t enabled) {
+  s_ContentHashes.SetEnabled(enabled != 0);
+}
+
+/// @brief Starts computing per-brick statistics (min, max, mean) of the
+/// uploads queued to a volume texture. Queued bricks whose maximum is lower
+/// than empty_threshold are not uploaded and the per-brick maxima are written
+/// to metadata_texture (optional, one texel per brick, same format as the
+/// volume) for empty-space skipping. Only R8/R16 volumes are supported.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+RegisterBrickStatistics(void* texture_handle, int32_t width, int32_t height,
+                        int32_t depth, Format format, int32_t brick_width,
+                        int32_t brick_height, int32_t brick_depth,
+                        uint32_t empty_threshold,
+                        void* metadata_texture_handle) {
+  s_BrickStatistics.Register(texture_handle, width, height, depth, format,
+                             brick_width, brick_height, brick_depth,
+                             empty_threshold, metadata_texture_handle);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UnregisterBrickStatistics(void* texture_handle) {
+  s_BrickStatistics.Unregister(texture_handle);
+}
+
+/// @brief Retrieves the statistics of a brick of a registered texture.
+/// @return 1 if the brick has been uploaded (or left out because it is
+/// empty), 0 otherwise
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetBrickStatistics(void* texture_handle, int32_t brick_x, int32_t brick_y,
+                   int32_t brick_z, uint32_t* min, uint32_t* max,
+                   float* mean) {
+  BrickStats stats;
+  if (!s_BrickStatistics.Get(texture_handle, brick_x, brick_y, brick_z,
+                             stats))
+    return 0;
+  *min = stats.min;
+  *max = stats.max;
+  *mean = stats.mean;
+  return 1;
+}
+
+/// @brief Whether all slabs of a queued upload have been uploaded.
+/// @param ticket as returned by EnqueueTextureSubImage3D
+/// @return 1 if complete, 0 otherwise
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+IsUploadComplete(uint64_t ticket) {
+  return s_UploadQueue.IsComplete(ticket) ? 1 : 0;
+}
+
+// Texel conversion kernels for producer threads. None of them touches the
+// graphics device, they can be called from any thread (e.g., on pinned
+// managed arrays) before the converted data is enqueued. src and dst may be
+// the same buffer.
+
+/// @brief Instruction set used by the conversion kernels on this CPU.
+/// @return 0 scalar, 1 SSE2, 2 AVX2, 3 NEON
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetConversionInstructionSet() {
+  return (int32_t)GetConversionISA();
+}
+
+/// @brief Converts count signed 16-bit values (e.g., CT Hounsfield units) to
+/// R16 texels: dst = clamp(src + offset, 0, 65535).
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+ConvertInt16ToR16(void* src, void* dst, uint64_t count, int32_t offset) {
+  ConvertInt16ToUInt16((const int16_t*)src, (uint16_t*)dst, (size_t)count,
+                       offset);
+}
+
+/// @brief Windows count R16 texels into R8 texels: window_low maps to 0 and
+/// window_high to 255.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+ConvertR16ToR8Window(void* src, void* dst, uint64_t count,
+                     uint32_t window_low, uint32_t window_high) {
+  ConvertUInt16ToUInt8Window(
+      (const uint16_t*)src, (uint8_t*)dst, (size_t)count,
+      (uint16_t)(window_low > 65535 ? 65535 : window_low),
+      (uint16_t)(window_high > 65535 ? 65535 : window_high));
+}
+
+/// @brief Converts count 32-bit floats to half floats (R16F texels).
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+ConvertFloat32ToR16F(void* src, void* dst, uint64_t count) {
+  ConvertFloat32ToFloat16((const float*)src, (uint16_t*)dst, (size_t)count);
+}
+
+/// @brief Converts count 32-bit labels to R16 texels, saturating at 65535.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+ConvertUInt32ToR16(void* src, void* dst, uint64_t count) {
+  ConvertUInt32ToUInt16((const uint32_t*)src, (uint16_t*)dst, (size_t)count);
+}
+
+/// @brief Reverses the byte order of count 16-bit values.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SwapBytes16(void* src, void* dst, uint64_t count) {
+  ByteSwap16(src, dst, (size_t)count);
+}
+
+/// @brief Reverses the byte order of count 32-bit values.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SwapBytes32(void* src, void* dst, uint64_t count) {
+  ByteSwap32(src, dst, (size_t)count);
 }
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
@@ -135,6 +1710,38 @@ UpdateCreateTexture3DParams(uint32_t width, uint32_t height, uint32_t depth,
   g_CreateTexture3DParams.height = height;
   g_CreateTexture3DParams.depth = depth;
   g_CreateTexture3DParams.format = format;
+  g_CreateTexture3DParams.mip_levels = 1;
+  g_CreateTexture3DParams.filter = kDownsampleAverage;
+}
+
+/// @brief Same as UpdateCreateTexture3DParams (to be called after it) but the
+/// next CreateTexture3D event creates a texture with several mip levels.
+/// Uploads to a level generate the coarser levels of the uploaded region on
+/// the submitting thread (on a worker thread for queued uploads) and queue
+/// them ahead of it, so that a coarse preview appears first.
+/// @param mip_levels number of levels, 0 for a full chain down to 1x1x1
+/// @param filter see DownsampleFilter: 0 average (R8_UINT, R16_UINT, R32F),
+/// 1 maximum or 2 minimum (also R16UI and R32UI, e.g., for labels)
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UpdateCreateTexture3DMipParams(int32_t mip_levels, int32_t filter) {
+  g_CreateTexture3DParams.mip_levels =
+      mip_levels > 0 ? (uint32_t)mip_levels : 0;
+  g_CreateTexture3DParams.filter = (DownsampleFilter)filter;
+}
+
+/// @brief Sets whether textures created afterwards with several mip levels
+/// have their coarser levels regenerated on the GPU instead of downsampled on
+/// the host. The boxes written to a level are then recorded and only their
+/// footprint on the coarser levels is recomputed by a compute pass at the end
+/// of the TextureSubImage3D, FlushUploadQueue and WindowTexture3D events, so
+/// that editing a small region does not cost a full mip generation. Falls
+/// back to the host for formats and filters the backend cannot downsample
+/// (OpenGL Core 4.3+ downsamples all uncompressed formats, integer formats
+/// with maximum and minimum only).
+/// @param enabled 0 to downsample on the host (default)
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetGpuMipRegeneration(int32_t enabled) {
+  s_GpuMipRegeneration = enabled != 0;
 }
 
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
@@ -142,6 +1749,186 @@ UpdateClearTexture3DParams(void* texture_handle) {
   g_ClearTexture3DParams.texture_handle = texture_handle;
 }
 
+/// @brief Sets up the WindowTexture3D event that re-windows a resident
+/// sub-region of a 16-bit texture into the same sub-region of an R8_UINT
+/// texture on the GPU (e.g., when the user changes the window), without
+/// uploading the 16-bit texels again. Requires a backend with compute shaders
+/// (OpenGL Core 4.3+), the event logs an error otherwise.
+/// @param src_format R16_UINT or R16UI, format of src_handle
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UpdateWindowTexture3DParams(void* src_handle, void* dst_handle,
+                            int32_t xoffset, int32_t yoffset, int32_t zoffset,
+                            int32_t width, int32_t height, int32_t depth,
+                            int32_t level, Format src_format,
+                            int32_t window_low, int32_t window_high) {
+  g_WindowTexture3DParams.src_handle = src_handle;
+  g_WindowTexture3DParams.dst_handle = dst_handle;
+  g_WindowTexture3DParams.xoffset = xoffset;
+  g_WindowTexture3DParams.yoffset = yoffset;
+  g_WindowTexture3DParams.zoffset = zoffset;
+  g_WindowTexture3DParams.width = width;
+  g_WindowTexture3DParams.height = height;
+  g_WindowTexture3DParams.depth = depth;
+  g_WindowTexture3DParams.level = level;
+  g_WindowTexture3DParams.src_format = src_format;
+  g_WindowTexture3DParams.low = ClampWindowBound(window_low);
+  g_WindowTexture3DParams.high = ClampWindowBound(window_high);
+  s_ContentHashes.Invalidate(dst_handle, xoffset, yoffset, zoffset, width,
+                             height, depth, level);
+}
+
+/// @brief Uploads a delta-coded brick, decoding it on the GPU if the backend
+/// supports it and on the render thread otherwise.
+static void DecodeTextureSubImage3D(const TextureSubImage3DParams& params) {
+  if (s_CurrentAPI->TextureSubImage3DDeltaR16(
+          params.texture_handle, params.xoffset, params.yoffset,
+          params.zoffset, params.encoded_ptr, params.encoded_size,
+          params.level, params.format)) {
+    return;
+  }
+  // kept across events to avoid reallocating for every brick
+  static std::vector<uint16_t> s_Decoded;
+  s_Decoded.resize((size_t)params.width * params.height * params.depth);
+  if (!Decompress(kCodecDeltaR16, params.encoded_ptr, params.encoded_size,
+                  s_Decoded.data(), s_Decoded.size() * sizeof(uint16_t))) {
+    return;
+  }
+  s_CurrentAPI->TextureSubImage3D(
+      params.texture_handle, params.xoffset, params.yoffset, params.zoffset,
+      params.width, params.height, params.depth, s_Decoded.data(),
+      PackedSourceLayout(), params.level, params.format);
+}
+
+/// @brief Writes the windowed texels of an upload into its R8_UINT texture,
+/// with a compute pass if the backend supports it and on the render thread
+/// otherwise.
+static void WindowTextureSubImage3D(const TextureSubImage3DParams& params) {
+  if (s_CurrentAPI->WindowTexture3D(
+          params.texture_handle, params.windowed_handle, params.xoffset,
+          params.yoffset, params.zoffset, params.width, params.height,
+          params.depth, params.level, params.format, params.window_low,
+          params.window_high)) {
+    return;
+  }
+  // kept across events to avoid reallocating for every brick
+  static std::vector<uint8_t> s_Windowed;
+  s_Windowed.resize((size_t)params.width * params.height * params.depth);
+  ConvertUInt16ToUInt8Window((const uint16_t*)params.data_ptr,
+                             s_Windowed.data(), s_Windowed.size(),
+                             params.window_low, params.window_high);
+  s_CurrentAPI->TextureSubImage3D(
+      params.windowed_handle, params.xoffset, params.yoffset, params.zoffset,
+      params.width, params.height, params.depth, s_Windowed.data(),
+      PackedSourceLayout(), params.level, R8_UINT);
+}
+
+/// @brief Regenerates the dirty footprints of the mip chains regenerated on
+/// the GPU. Called on the render thread.
+static void RegenerateMipChains() {
+  // kept to avoid reallocating them every frame
+  static std::vector<UploadCommand> s_Regenerated;
+  s_Regenerated.clear();
+  s_MipChains.Regenerate(s_CurrentAPI, s_Regenerated);
+  // the generated content is not hashed
+  for (size_t i = 0; i < s_Regenerated.size(); ++i)
+    InvalidateContentHash(s_Regenerated[i]);
+}
+
+/// @brief Feeds the video memory reported by the driver into the budget, at
+/// most every 250ms unless forced. Called on the render thread.
+static void RefreshGpuMemory(bool force) {
+  static std::chrono::steady_clock::time_point s_LastRefresh;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (!force && now - s_LastRefresh < std::chrono::milliseconds(250)) return;
+  s_LastRefresh = now;
+  uint64_t total_bytes = 0, available_bytes = 0;
+  bool known = s_CurrentAPI->QueryVideoMemory(total_bytes, available_bytes);
+  s_GpuMemory.SetDeviceMemory(known, total_bytes, available_bytes,
+                              s_CurrentAPI->InternalMemorySize());
+}
+
+/// @brief Creates a texture within the GPU memory budget and registers it
+/// with the plugin's per-texture state. Called on the render thread.
+/// @param mip_levels number of levels, 0 for a full chain. Block-compressed
+/// textures have a single level.
+/// @return the texture, NULL if it is refused or cannot be created
+static void* CreateTrackedTexture3D(uint32_t width, uint32_t height,
+                                    uint32_t depth, Format format,
+                                    uint32_t mip_levels,
+                                    DownsampleFilter filter) {
+  int32_t full_levels =
+      MipLevelCount((int32_t)width, (int32_t)height, (int32_t)depth);
+  int32_t levels = mip_levels == 0 || mip_levels > (uint32_t)full_levels
+                       ? full_levels
+                       : (int32_t)mip_levels;
+  if (IsCompressedFormat(format)) levels = 1;
+  size_t size = MipChainDataSize(format, (int32_t)width, (int32_t)height,
+                                 (int32_t)depth, levels);
+  if (!s_GpuMemory.Admit(size)) return NULL;
+  void* texture = NULL;
+  s_CurrentAPI->CreateTexture3D(width, height, depth, format,
+                                (uint32_t)levels, texture);
+  if (!texture) return NULL;
+  s_GpuMemory.Register(texture, size);
+  s_ContentHashes.Register(texture);
+  if (IsCompressedFormat(format))
+    s_BlockCompressor.Register(texture, width, height, format);
+  if (levels > 1) {
+    bool on_gpu = s_GpuMipRegeneration &&
+                  s_CurrentAPI->SupportsDownsampling(format, filter);
+    s_MipChains.Register(texture, (int32_t)width, (int32_t)height,
+                         (int32_t)depth, format, levels, filter, on_gpu);
+  }
+  return texture;
+}
+
+/// @brief Unregisters a texture created by CreateTrackedTexture3D and
+/// releases it. Called on the render thread.
+static void ClearTrackedTexture3D(void* texture_handle) {
+  s_ContentHashes.Unregister(texture_handle);
+  s_BrickStatistics.Unregister(texture_handle);
+  s_BlockCompressor.Unregister(texture_handle);
+  s_MipChains.Unregister(texture_handle);
+  s_GpuMemory.Unregister(texture_handle);
+  s_CurrentAPI->ClearTexture3D(texture_handle);
+}
+
+/// @brief Creates the partitions of a volume within the device's limits.
+/// Called on the render thread.
+/// @return id of the volume, 0 if it cannot be partitioned or a partition
+/// cannot be created
+static int32_t CreatePartitions(
+    const CreatePartitionedTexture3DParams& params) {
+  uint64_t max_bytes = s_CurrentAPI->MaxTextureBytes();
+  if (params.max_partition_bytes > 0 && params.max_partition_bytes < max_bytes)
+    max_bytes = params.max_partition_bytes;
+  std::shared_ptr<PartitionedVolume> volume(new PartitionedVolume());
+  if (!volume->Layout((int32_t)params.width, (int32_t)params.height,
+                      (int32_t)params.depth, params.format,
+                      s_CurrentAPI->MaxTexture3DSize(), max_bytes)) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": " << params.width << "x" << params.height << "x"
+       << params.depth << " texels of format " << params.format
+       << " cannot be partitioned into textures of at most " << max_bytes
+       << " bytes and " << s_CurrentAPI->MaxTexture3DSize()
+       << " texels per axis";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return 0;
+  }
+  std::vector<VolumePartition>& partitions = volume->partitions();
+  for (size_t i = 0; i < partitions.size(); ++i) {
+    partitions[i].texture_handle = CreateTrackedTexture3D(
+        (uint32_t)partitions[i].width, (uint32_t)partitions[i].height,
+        (uint32_t)partitions[i].depth, params.format, 1, kDownsampleAverage);
+    if (!partitions[i].texture_handle) {
+      for (size_t j = 0; j < i; ++j)
+        ClearTrackedTexture3D(partitions[j].texture_handle);
+      return 0;
+    }
+  }
+  return s_PartitionedVolumes.Register(volume);
+}
+
 static void UNITY_INTERFACE_API OnRenderEvent(int eventID) {
   // Unknown / unsupported graphics device type? Do nothing
   if (s_CurrentAPI == NULL) return;
@@ -157,24 +1944,126 @@ static void UNITY_INTERFACE_API OnRenderEvent(int eventID) {
       break;
     }
     case Event::TextureSubImage3D: {
-      s_CurrentAPI->TextureSubImage3D(
-          g_TextureSubImage3DParams.texture_handle,
-          g_TextureSubImage3DParams.xoffset, g_TextureSubImage3DParams.yoffset,
-          g_TextureSubImage3DParams.zoffset, g_TextureSubImage3DParams.width,
-          g_TextureSubImage3DParams.height, g_TextureSubImage3DParams.depth,
-          g_TextureSubImage3DParams.data_ptr, g_TextureSubImage3DParams.level,
-          g_TextureSubImage3DParams.format);
+      std::shared_ptr<const TextureSubImage3DParams> last;
+      {
+        std::lock_guard<std::mutex> lock(g_TextureSubImage3DMutex);
+        last = g_TextureSubImage3DParams;
+      }
+      if (!last) break;
+      const TextureSubImage3DParams& params = *last;
+      if (params.encoded_ptr) {
+        if (!params.skip) {
+          DecodeTextureSubImage3D(params);
+          s_MipChains.MarkDirty(params.texture_handle, params.xoffset,
+                                params.yoffset, params.zoffset, params.width,
+                                params.height, params.depth, params.level);
+          RegenerateMipChains();
+        }
+        break;
+      }
+      // a resident 16-bit brick may still have to be windowed differently
+      if (!params.skip) {
+        for (size_t i = 0; i < params.mip_uploads.size(); ++i) {
+          const UploadCommand& mip = params.mip_uploads[i];
+          s_CurrentAPI->TextureSubImage3D(
+              mip.texture_handle, mip.xoffset, mip.yoffset, mip.zoffset,
+              mip.width, mip.height, mip.depth, mip.data_ptr, mip.layout,
+              mip.level, mip.format);
+          // the generated content is not hashed
+          InvalidateContentHash(mip);
+        }
+        s_CurrentAPI->TextureSubImage3D(
+            params.texture_handle, params.xoffset, params.yoffset,
+            params.zoffset, params.width, params.height, params.depth,
+            params.data_ptr, params.layout, params.level, params.format);
+        if (params.record_hash) {
+          s_ContentHashes.Record(params.texture_handle, params.xoffset,
+                                 params.yoffset, params.zoffset, params.width,
+                                 params.height, params.depth, params.level,
+                                 params.content_format, params.content_hash);
+        }
+      }
+      if (params.windowed_handle) WindowTextureSubImage3D(params);
+      if (!params.skip) {
+        s_MipChains.MarkDirty(params.texture_handle, params.xoffset,
+                              params.yoffset, params.zoffset, params.width,
+                              params.height, params.depth, params.level);
+      }
+      s_MipChains.MarkDirty(params.windowed_handle, params.xoffset,
+                            params.yoffset, params.zoffset, params.width,
+                            params.height, params.depth, params.level);
+      RegenerateMipChains();
       break;
     }
     case Event::CreateTexture3D: {
-      s_CurrentAPI->CreateTexture3D(
-          g_CreateTexture3DParams.width, g_CreateTexture3DParams.height,
-          g_CreateTexture3DParams.depth, g_CreateTexture3DParams.format,
-          g_Texture3D);
+      RefreshGpuMemory(true);
+      const CreateTexture3DParams& params = g_CreateTexture3DParams;
+      g_Texture3D = CreateTrackedTexture3D(params.width, params.height,
+                                           params.depth, params.format,
+                                           params.mip_levels, params.filter);
       break;
     }
     case Event::ClearTexture3D: {
-      s_CurrentAPI->ClearTexture3D(g_ClearTexture3DParams.texture_handle);
+      ClearTrackedTexture3D(g_ClearTexture3DParams.texture_handle);
+      break;
+    }
+    case Event::CreatePartitionedTexture3D: {
+      RefreshGpuMemory(true);
+      g_PartitionedTexture3DId =
+          CreatePartitions(g_CreatePartitionedTexture3DParams);
+      break;
+    }
+    case Event::ClearPartitionedTexture3D: {
+      std::shared_ptr<PartitionedVolume> volume =
+          s_PartitionedVolumes.Find(g_ClearPartitionedTexture3DId);
+      if (!volume) break;
+      s_PartitionedVolumes.Unregister(g_ClearPartitionedTexture3DId);
+      for (size_t i = 0; i < volume->partitions().size(); ++i)
+        ClearTrackedTexture3D(volume->partitions()[i].texture_handle);
+      break;
+    }
+    case Event::FlushUploadQueue: {
+      // executed uploads, kept to avoid reallocating them every frame
+      static std::vector<UploadCommand> s_Executed;
+      s_Executed.clear();
+      s_UploadQueue.Flush(s_CurrentAPI, &s_Executed);
+      for (size_t i = 0; i < s_Executed.size(); ++i) {
+        const UploadCommand& cmd = s_Executed[i];
+        s_MipChains.MarkDirty(cmd.texture_handle, cmd.xoffset, cmd.yoffset,
+                              cmd.zoffset, cmd.width, cmd.height, cmd.depth,
+                              cmd.level);
+      }
+      RegenerateMipChains();
+      RefreshGpuMemory(false);
+      RetryUncutRows();
+      break;
+    }
+    case Event::WindowTexture3D: {
+      const WindowTexture3DParams& params = g_WindowTexture3DParams;
+      // the windowed texels never reach the host
+      if (s_MipChains.IsDownsampledOnHost(params.dst_handle)) {
+        std::ostringstream ss;
+        ss << "WindowTexture3D: the mip chain of texture " << params.dst_handle
+           << " is downsampled on the host, only textures whose mip chains "
+              "are regenerated on the GPU can be windowed";
+        UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+        break;
+      }
+      if (!s_CurrentAPI->WindowTexture3D(
+              params.src_handle, params.dst_handle, params.xoffset,
+              params.yoffset, params.zoffset, params.width, params.height,
+              params.depth, params.level, params.src_format, params.low,
+              params.high)) {
+        std::ostringstream ss;
+        ss << "WindowTexture3D: not supported for format " << params.src_format
+           << " by this graphics API";
+        UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+        break;
+      }
+      s_MipChains.MarkDirty(params.dst_handle, params.xoffset, params.yoffset,
+                            params.zoffset, params.width, params.height,
+                            params.depth, params.level);
+      RegenerateMipChains();
       break;
     }
     default:
@@ -191,3 +2080,172 @@ extern "C" UNITY_INTERFACE_EXPORT void* UNITY_INTERFACE_API
 RetrieveCreatedTexture3D() {
   return g_Texture3D;
 }
+
+/// @brief Sets up the CreatePartitionedTexture3D event that creates a volume
+/// too large for a single native texture (GL_MAX_3D_TEXTURE_SIZE, the 2GB
+/// resource limit of Direct3D 11) as a grid of textures within the device's
+/// limits, neighbouring partitions overlapping by one texel so that each can
+/// be filtered seamlessly. Retrieve the volume's id with
+/// RetrievePartitionedTexture3D and its layout with
+/// GetPartitionedTexture3DLayout and GetPartitionedTexture3DPartition.
+/// @param format uncompressed format of the volume
+/// @param max_partition_bytes maximum size of a partition, 0 for the
+/// device's limit
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UpdateCreatePartitionedTexture3DParams(uint32_t width, uint32_t height,
+                                       uint32_t depth, Format format,
+                                       uint64_t max_partition_bytes) {
+  g_CreatePartitionedTexture3DParams.width = width;
+  g_CreatePartitionedTexture3DParams.height = height;
+  g_CreatePartitionedTexture3DParams.depth = depth;
+  g_CreatePartitionedTexture3DParams.format = format;
+  g_CreatePartitionedTexture3DParams.max_partition_bytes = max_partition_bytes;
+}
+
+/// @return id of the volume created by the last CreatePartitionedTexture3D
+/// event, 0 if it failed
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+RetrievePartitionedTexture3D() {
+  return g_PartitionedTexture3DId;
+}
+
+/// @brief Sets up the ClearPartitionedTexture3D event that releases the
+/// partitions of a volume. Uploads queued to the volume must be complete.
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+UpdateClearPartitionedTexture3DParams(int32_t volume_id) {
+  g_ClearPartitionedTexture3DId = volume_id;
+}
+
+/// @brief Retrieves the number of partitions of a volume along each axis.
+/// Partitions are indexed x fastest.
+/// @return 0 if the id is not registered
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetPartitionedTexture3DLayout(int32_t volume_id, int32_t* x_count,
+                              int32_t* y_count, int32_t* z_count) {
+  std::shared_ptr<PartitionedVolume> volume =
+      s_PartitionedVolumes.Find(volume_id);
+  if (!volume) return 0;
+  *x_count = volume->count(0);
+  *y_count = volume->count(1);
+  *z_count = volume->count(2);
+  return 1;
+}
+
+/// @brief Retrieves a partition of a volume: its native texture and the box
+/// of the volume it holds (in texels, including the texel shared with each
+/// neighbour). A shader samples volume position p (in texels) from the
+/// partition whose box contains p's filter footprint, at p - offset.
+/// @return 0 if the id is not registered or index is out of range
+extern "C" int32_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetPartitionedTexture3DPartition(int32_t volume_id, int32_t index,
+                                 void** texture_handle, int32_t* xoffset,
+                                 int32_t* yoffset, int32_t* zoffset,
+                                 int32_t* width, int32_t* height,
+                                 int32_t* depth) {
+  std::shared_ptr<PartitionedVolume> volume =
+      s_PartitionedVolumes.Find(volume_id);
+  if (!volume || index < 0 ||
+      (size_t)index >= volume->partitions().size())
+    return 0;
+  const VolumePartition& partition = volume->partitions()[index];
+  *texture_handle = partition.texture_handle;
+  *xoffset = partition.x;
+  *yoffset = partition.y;
+  *zoffset = partition.z;
+  *width = partition.width;
+  *height = partition.height;
+  *depth = partition.depth;
+  return 1;
+}
+
+/// @brief Queues an upload of a sub-box of a partitioned volume, in volume
+/// coordinates, like EnqueueTextureSubImage3DStrided: it is routed to every
+/// partition it intersects. The memory pointed to by data_ptr has to stay
+/// valid until the returned ticket is reported complete.
+/// @return ticket of the uploads to all partitions
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+EnqueuePartitionedTextureSubImage3D(
+    int32_t volume_id, int32_t xoffset, int32_t yoffset, int32_t zoffset,
+    int32_t width, int32_t height, int32_t depth, void* data_ptr,
+    int32_t src_row_length, int32_t src_image_height, int32_t src_xoffset,
+    int32_t src_yoffset, int32_t src_zoffset) {
+  std::shared_ptr<PartitionedVolume> volume =
+      s_PartitionedVolumes.Find(volume_id);
+  if (!volume) {
+    std::ostringstream ss;
+    ss << __FUNCTION__ << ": volume " << volume_id << " is not registered";
+    UNITY_LOG_ERROR(g_Log, ss.str().c_str());
+    return s_UploadQueue.Drop();
+  }
+  UploadCommand cmd;
+  cmd.texture_handle = NULL;
+  cmd.xoffset = xoffset;
+  cmd.yoffset = yoffset;
+  cmd.zoffset = zoffset;
+  cmd.width = width;
+  cmd.height = height;
+  cmd.depth = depth;
+  cmd.data_ptr = data_ptr;
+  cmd.layout.row_length = src_row_length;
+  cmd.layout.image_height = src_image_height;
+  cmd.layout.skip_texels = src_xoffset;
+  cmd.layout.skip_rows = src_yoffset;
+  cmd.layout.skip_images = src_zoffset;
+  cmd.level = 0;
+  cmd.format = volume->format();
+  std::vector<UploadCommand> routed, uploads, prepared;
+  volume->Route(cmd, routed);
+  for (size_t i = 0; i < routed.size(); ++i) {
+    prepared.clear();
+    PrepareUploads(routed[i], prepared);
+    uploads.insert(uploads.end(), prepared.begin(), prepared.end());
+  }
+  if (uploads.empty()) return s_UploadQueue.Drop();
+  return s_UploadQueue.Push(&uploads[0], uploads.size());
+}
+
+/// @brief Sets the budget of the GPU memory owned by the plugin (textures
+/// created through CreateTexture3D and the backend's buffers). CreateTexture3D
+/// events that would exceed it, or the video memory the driver reports as
+/// available (GL_NVX_gpu_memory_info, GL_ATI_meminfo, DXGI 1.4), are refused:
+/// RetrieveCreatedTexture3D returns NULL and an error is logged.
+/// @param max_bytes 0 (the default) only enforces the driver's limit
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+SetGpuMemoryBudget(uint64_t max_bytes) {
+  s_GpuMemory.SetBudget((size_t)max_bytes);
+}
+
+/// @brief Retrieves the GPU memory accounting, so that LOD logic can react
+/// before the driver starts paging. The device numbers are refreshed by
+/// FlushUploadQueue and CreateTexture3D events and are 0 if the driver does
+/// not report them.
+/// @param texture_bytes size of the textures created and not cleared
+/// @param peak_texture_bytes largest texture_bytes so far
+/// @param texture_count number of textures created and not cleared
+/// @param internal_bytes size of the backend's buffers
+/// @param budget_bytes budget set through SetGpuMemoryBudget
+/// @param device_total_bytes dedicated video memory of the device
+/// @param device_available_bytes video memory currently available
+/// @param refused number of refused CreateTexture3D events
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetGpuMemoryStatistics(uint64_t* texture_bytes, uint64_t* peak_texture_bytes,
+                       uint64_t* texture_count, uint64_t* internal_bytes,
+                       uint64_t* budget_bytes, uint64_t* device_total_bytes,
+                       uint64_t* device_available_bytes, uint64_t* refused) {
+  GpuMemoryStatistics statistics = s_GpuMemory.statistics();
+  *texture_bytes = statistics.texture_bytes;
+  *peak_texture_bytes = statistics.peak_texture_bytes;
+  *texture_count = statistics.texture_count;
+  *internal_bytes = statistics.internal_bytes;
+  *budget_bytes = statistics.budget_bytes;
+  *device_total_bytes = statistics.device_total_bytes;
+  *device_available_bytes = statistics.device_available_bytes;
+  *refused = statistics.refused;
+}
+
+/// @brief Size in bytes of a texture created through CreateTexture3D, 0 if
+/// it has been cleared or was not created by the plugin.
+extern "C" uint64_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
+GetTexture3DMemorySize(void* texture_handle) {
+  return s_GpuMemory.size(texture_handle);
+}
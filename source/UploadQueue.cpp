@@ -0,0 +1,439 @@
+#include "UploadQueue.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+// default upper bound of a coalesced upload. Coalescing mainly pays off for
+// small bricks (16^3/32^3) where the per-call overhead dominates, so there is
+// no need to gather arbitrarily large boxes into the staging buffer.
+static const size_t kDefaultCoalescingLimit = 8 * 1024 * 1024;
+
+// default size above which uploads are split into slabs. Slabs are only
+// spread over several flushes if a time budget is set.
+static const size_t kDefaultSlabSize = 32 * 1024 * 1024;
+
+/// @brief Orders uploads to coarser mip levels first.
+static bool IsCoarser(const UploadCommand& a, const UploadCommand& b) {
+  return a.level > b.level;
+}
+
+struct UploadQueue::Node {
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  // indices of the coalesced commands, in submission order
+  std::vector<size_t> pieces;
+};
+
+static size_t BoxSizeInBytes(int32_t width, int32_t height, int32_t depth,
+                             uint32_t bytes_per_texel) {
+  return (size_t)width * (size_t)height * (size_t)depth * bytes_per_texel;
+}
+
+UploadQueue::UploadQueue()
+    : m_CoalescingLimit(kDefaultCoalescingLimit),
+      m_SlabSize(kDefaultSlabSize),
+      m_TimeBudget(0.0f),
+      m_NextTicket(1) {}
+
+uint64_t UploadQueue::Push(const UploadCommand* cmds, size_t count) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  uint64_t ticket = m_NextTicket++;
+  uint32_t slabs = 0;
+  for (size_t i = 0; i < count; ++i) slabs += Split(cmds[i], ticket);
+  if (slabs > 0) m_Outstanding[ticket] = slabs;
+  return ticket;
+}
+
+uint32_t UploadQueue::Split(const UploadCommand& cmd, uint64_t ticket) {
+  uint32_t bytes_per_texel = BytesPerTexel(cmd.format);
+  size_t row_size = BoxSizeInBytes(cmd.width, 1, 1, bytes_per_texel);
+  size_t slice_size = BoxSizeInBytes(cmd.width, cmd.height, 1, bytes_per_texel);
+  if (m_SlabSize == 0 || row_size == 0 || cmd.depth <= 0 ||
+      slice_size * cmd.depth <= m_SlabSize) {
+    m_Pending.push_back(cmd);
+    m_Pending.back().ticket = ticket;
+    return 1;
+  }
+
+  // split into Z-slabs, or into Y-tiles of single slices if a slice alone
+  // exceeds the slab size. Slabs reference the original source through a
+  // strided layout, no data is copied.
+  int32_t slab_depth = 1, tile_height = cmd.height;
+  if (slice_size <= m_SlabSize) {
+    slab_depth = (int32_t)(m_SlabSize / slice_size);
+  } else {
+    tile_height = (int32_t)(m_SlabSize / row_size);
+    if (tile_height < 1) tile_height = 1;
+  }
+
+  UploadCommand slab = cmd;
+  slab.ticket = ticket;
+  slab.layout.row_length =
+      (int32_t)(SourceRowPitch(cmd.layout, cmd.width, bytes_per_texel) /
+                bytes_per_texel);
+  slab.layout.image_height =
+      cmd.layout.image_height > 0 ? cmd.layout.image_height : cmd.height;
+  uint32_t count = 0;
+  for (int32_t z = 0; z < cmd.depth; z += slab_depth) {
+    slab.zoffset = cmd.zoffset + z;
+    slab.layout.skip_images = cmd.layout.skip_images + z;
+    slab.depth = cmd.depth - z < slab_depth ? cmd.depth - z : slab_depth;
+    for (int32_t y = 0; y < cmd.height; y += tile_height) {
+      slab.yoffset = cmd.yoffset + y;
+      slab.layout.skip_rows = cmd.layout.skip_rows + y;
+      slab.height = cmd.height - y < tile_height ? cmd.height - y : tile_height;
+      m_Pending.push_back(slab);
+      ++count;
+    }
+  }
+  return count;
+}
+
+uint64_t UploadQueue::Drop() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_NextTicket++;
+}
+
+uint64_t UploadQueue::Reserve() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  uint64_t ticket = m_NextTicket++;
+  // placeholder slab, removed by Fulfill
+  m_Outstanding[ticket] = 1;
+  return ticket;
+}
+
+void UploadQueue::Fulfill(uint64_t ticket, const UploadCommand* cmds,
+                          size_t count) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  std::unordered_map<uint64_t, uint32_t>::iterator it =
+      m_Outstanding.find(ticket);
+  if (it == m_Outstanding.end()) return;
+  uint32_t slabs = 0;
+  for (size_t i = 0; i < count; ++i) slabs += Split(cmds[i], ticket);
+  if (slabs > 0) {
+    it->second = slabs;
+  } else {
+    m_Outstanding.erase(it);
+  }
+}
+
+void UploadQueue::Clear() {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Pending.clear();
+  m_Outstanding.clear();
+}
+
+bool UploadQueue::IsComplete(uint64_t ticket) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return ticket < m_NextTicket &&
+         m_Outstanding.find(ticket) == m_Outstanding.end();
+}
+
+void UploadQueue::SetCoalescingLimit(size_t max_bytes) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_CoalescingLimit = max_bytes;
+}
+
+void UploadQueue::SetSlabSize(size_t max_bytes) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_SlabSize = max_bytes;
+}
+
+void UploadQueue::SetTimeBudget(float milliseconds) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_TimeBudget = milliseconds;
+}
+
+void UploadQueue::Flush(RenderAPI* api,
+                        std::vector<UploadCommand>* executed) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::vector<UploadCommand> cmds;
+  for (bool first = true;; first = false) {
+    size_t limit;
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      if (m_Pending.empty()) return;
+      // uploads to different levels never overlap, coarse levels are
+      // executed first so that a preview is shown while finer ones arrive
+      if (first &&
+          !std::is_sorted(m_Pending.begin(), m_Pending.end(), IsCoarser)) {
+        std::stable_sort(m_Pending.begin(), m_Pending.end(), IsCoarser);
+      }
+      if (!first && m_TimeBudget > 0.0f) {
+        std::chrono::duration<float, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= m_TimeBudget) return;
+      }
+
+      // without a time budget everything is executed as a single batch.
+      // Otherwise batches of at most one slab are executed so that the budget
+      // is checked in between.
+      size_t batch_size = m_TimeBudget > 0.0f && m_SlabSize > 0
+                              ? m_SlabSize
+                              : (size_t)-1;
+      size_t size = 0;
+      cmds.clear();
+      while (!m_Pending.empty()) {
+        const UploadCommand& cmd = m_Pending.front();
+        size_t cmd_size = BoxSizeInBytes(cmd.width, cmd.height, cmd.depth,
+                                         BytesPerTexel(cmd.format));
+        if (!cmds.empty() && size + cmd_size > batch_size) break;
+        size += cmd_size;
+        cmds.push_back(cmd);
+        m_Pending.pop_front();
+      }
+      limit = m_CoalescingLimit;
+    }
+
+    Execute(api, cmds, limit);
+    if (executed) {
+      for (size_t i = 0; i < cmds.size(); ++i) {
+        executed->push_back(cmds[i]);
+        executed->back().storage.reset();
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (size_t i = 0; i < cmds.size(); ++i) {
+      std::unordered_map<uint64_t, uint32_t>::iterator it =
+          m_Outstanding.find(cmds[i].ticket);
+      if (it != m_Outstanding.end() && --it->second == 0) {
+        m_Outstanding.erase(it);
+      }
+    }
+  }
+}
+
+void UploadQueue::Execute(RenderAPI* api,
+                          const std::vector<UploadCommand>& cmds,
+                          size_t limit) {
+  // bucket commands by (texture, level, format) in order of first appearance.
+  // Uploads to different textures/levels never overlap so they can be freely
+  // reordered with respect to each other. Within a bucket, only nodes that
+  // are consecutive in submission order are merged so that overlapping writes
+  // keep their relative order.
+  std::vector<size_t> group_heads;
+  std::vector<std::vector<Node> > groups;
+  for (size_t i = 0; i < cmds.size(); ++i) {
+    const UploadCommand& cmd = cmds[i];
+    size_t g = 0;
+    for (; g < group_heads.size(); ++g) {
+      const UploadCommand& head = cmds[group_heads[g]];
+      if (head.texture_handle == cmd.texture_handle &&
+          head.level == cmd.level && head.format == cmd.format)
+        break;
+    }
+    if (g == group_heads.size()) {
+      group_heads.push_back(i);
+      groups.push_back(std::vector<Node>());
+    }
+
+    Node node;
+    node.xoffset = cmd.xoffset;
+    node.yoffset = cmd.yoffset;
+    node.zoffset = cmd.zoffset;
+    node.width = cmd.width;
+    node.height = cmd.height;
+    node.depth = cmd.depth;
+    node.pieces.push_back(i);
+
+    std::vector<Node>& nodes = groups[g];
+    if (nodes.empty() ||
+        !TryMerge(nodes.back(), node, BytesPerTexel(cmd.format), limit)) {
+      nodes.push_back(node);
+    }
+  }
+
+  // rows merged during the first pass can now be merged into slabs and slabs
+  // into larger boxes. Each pass can only grow boxes along one more axis,
+  // hence at most two more passes are useful.
+  for (size_t g = 0; g < groups.size(); ++g) {
+    uint32_t bytes_per_texel = BytesPerTexel(cmds[group_heads[g]].format);
+    for (int pass = 0; pass < 2; ++pass) {
+      std::vector<Node>& nodes = groups[g];
+      std::vector<Node> merged;
+      merged.reserve(nodes.size());
+      for (size_t n = 0; n < nodes.size(); ++n) {
+        if (merged.empty() ||
+            !TryMerge(merged.back(), nodes[n], bytes_per_texel, limit)) {
+          merged.push_back(nodes[n]);
+        }
+      }
+      bool changed = merged.size() != nodes.size();
+      nodes.swap(merged);
+      if (!changed) break;
+    }
+
+    for (size_t n = 0; n < groups[g].size(); ++n) {
+      Upload(api, groups[g][n], cmds);
+    }
+  }
+}
+
+void UploadQueue::Upload(RenderAPI* api, const Node& node,
+                         const std::vector<UploadCommand>& cmds) {
+  const UploadCommand& first = cmds[node.pieces[0]];
+  if (node.pieces.size() == 1) {
+    api->TextureSubImage3D(first.texture_handle, first.xoffset, first.yoffset,
+                           first.zoffset, first.width, first.height,
+                           first.depth, first.data_ptr, first.layout,
+                           first.level, first.format);
+    return;
+  }
+
+  uint32_t bytes_per_texel = BytesPerTexel(first.format);
+
+  // the sources can be uploaded in place if all of them are sub-boxes of the
+  // same host volume at the same relative position as in the texture
+  bool same_volume = true;
+  for (size_t p = 0; p < node.pieces.size() && same_volume; ++p) {
+    const UploadCommand& cmd = cmds[node.pieces[p]];
+    same_volume =
+        cmd.data_ptr == first.data_ptr &&
+        SourceRowPitch(cmd.layout, cmd.width, bytes_per_texel) ==
+            SourceRowPitch(first.layout, first.width, bytes_per_texel) &&
+        SourceSlicePitch(cmd.layout, cmd.width, cmd.height, bytes_per_texel) ==
+            SourceSlicePitch(first.layout, first.width, first.height,
+                             bytes_per_texel) &&
+        cmd.layout.skip_texels - cmd.xoffset ==
+            first.layout.skip_texels - first.xoffset &&
+        cmd.layout.skip_rows - cmd.yoffset ==
+            first.layout.skip_rows - first.yoffset &&
+        cmd.layout.skip_images - cmd.zoffset ==
+            first.layout.skip_images - first.zoffset;
+  }
+  if (same_volume) {
+    SourceLayout layout;
+    layout.row_length = (int32_t)(
+        SourceRowPitch(first.layout, first.width, bytes_per_texel) /
+        bytes_per_texel);
+    layout.image_height = (int32_t)(
+        SourceSlicePitch(first.layout, first.width, first.height,
+                         bytes_per_texel) /
+        SourceRowPitch(first.layout, first.width, bytes_per_texel));
+    layout.skip_texels =
+        first.layout.skip_texels + node.xoffset - first.xoffset;
+    layout.skip_rows = first.layout.skip_rows + node.yoffset - first.yoffset;
+    layout.skip_images =
+        first.layout.skip_images + node.zoffset - first.zoffset;
+    api->TextureSubImage3D(first.texture_handle, node.xoffset, node.yoffset,
+                           node.zoffset, node.width, node.height, node.depth,
+                           first.data_ptr, layout, first.level, first.format);
+    return;
+  }
+
+  // ... or if they are tightly packed full XY slabs of the merged box that
+  // follow each other in memory (e.g., consecutive Z-slabs of the same array)
+  bool contiguous = true;
+  const uint8_t* expected =
+      SourceOrigin(first.data_ptr, first.layout, first.width, first.height,
+                   bytes_per_texel);
+  int32_t expected_z = node.zoffset;
+  for (size_t p = 0; p < node.pieces.size() && contiguous; ++p) {
+    const UploadCommand& cmd = cmds[node.pieces[p]];
+    contiguous = cmd.xoffset == node.xoffset && cmd.width == node.width &&
+                 cmd.yoffset == node.yoffset && cmd.height == node.height &&
+                 cmd.zoffset == expected_z &&
+                 SourceOrigin(cmd.data_ptr, cmd.layout, cmd.width, cmd.height,
+                              bytes_per_texel) == expected &&
+                 SourceSlicePitch(cmd.layout, cmd.width, cmd.height,
+                                  bytes_per_texel) ==
+                     BoxSizeInBytes(cmd.width, cmd.height, 1, bytes_per_texel);
+    expected += BoxSizeInBytes(cmd.width, cmd.height, cmd.depth,
+                               bytes_per_texel);
+    expected_z += cmd.depth;
+  }
+  if (contiguous) {
+    api->TextureSubImage3D(
+        first.texture_handle, node.xoffset, node.yoffset, node.zoffset,
+        node.width, node.height, node.depth,
+        (void*)SourceOrigin(first.data_ptr, first.layout, first.width,
+                            first.height, bytes_per_texel),
+        PackedSourceLayout(), first.level, first.format);
+    return;
+  }
+
+  size_t size_in_bytes =
+      BoxSizeInBytes(node.width, node.height, node.depth, bytes_per_texel);
+  if (m_Staging.size() < size_in_bytes) m_Staging.resize(size_in_bytes);
+
+  size_t dst_row_pitch = (size_t)node.width * bytes_per_texel;
+  size_t dst_slice_pitch = dst_row_pitch * node.height;
+  for (size_t p = 0; p < node.pieces.size(); ++p) {
+    const UploadCommand& cmd = cmds[node.pieces[p]];
+    size_t row_size = (size_t)cmd.width * bytes_per_texel;
+    size_t src_row_pitch =
+        SourceRowPitch(cmd.layout, cmd.width, bytes_per_texel);
+    size_t src_slice_pitch =
+        SourceSlicePitch(cmd.layout, cmd.width, cmd.height, bytes_per_texel);
+    const uint8_t* src = SourceOrigin(cmd.data_ptr, cmd.layout, cmd.width,
+                                      cmd.height, bytes_per_texel);
+    uint8_t* dst = &m_Staging[0] +
+                   (size_t)(cmd.zoffset - node.zoffset) * dst_slice_pitch +
+                   (size_t)(cmd.yoffset - node.yoffset) * dst_row_pitch +
+                   (size_t)(cmd.xoffset - node.xoffset) * bytes_per_texel;
+    for (int32_t z = 0; z < cmd.depth; ++z) {
+      const uint8_t* src_row = src + z * src_slice_pitch;
+      uint8_t* dst_row = dst + z * dst_slice_pitch;
+      for (int32_t y = 0; y < cmd.height; ++y) {
+        memcpy(dst_row, src_row, row_size);
+        src_row += src_row_pitch;
+        dst_row += dst_row_pitch;
+      }
+    }
+  }
+
+  api->TextureSubImage3D(first.texture_handle, node.xoffset, node.yoffset,
+                         node.zoffset, node.width, node.height, node.depth,
+                         &m_Staging[0], PackedSourceLayout(), first.level,
+                         first.format);
+}
+
+bool UploadQueue::TryMerge(Node& a, const Node& b, uint32_t bytes_per_texel,
+                           size_t limit) {
+  if (limit == 0 || bytes_per_texel == 0) return false;
+  if (a.width <= 0 || a.height <= 0 || a.depth <= 0 || b.width <= 0 ||
+      b.height <= 0 || b.depth <= 0)
+    return false;
+
+  bool same_x = a.xoffset == b.xoffset && a.width == b.width;
+  bool same_y = a.yoffset == b.yoffset && a.height == b.height;
+  bool same_z = a.zoffset == b.zoffset && a.depth == b.depth;
+
+  int32_t xoffset = a.xoffset, yoffset = a.yoffset, zoffset = a.zoffset;
+  int32_t width = a.width, height = a.height, depth = a.depth;
+  if (same_y && same_z &&
+      (a.xoffset + a.width == b.xoffset || b.xoffset + b.width == a.xoffset)) {
+    xoffset = a.xoffset < b.xoffset ? a.xoffset : b.xoffset;
+    width = a.width + b.width;
+  } else if (same_x && same_z && (a.yoffset + a.height == b.yoffset ||
+                                  b.yoffset + b.height == a.yoffset)) {
+    yoffset = a.yoffset < b.yoffset ? a.yoffset : b.yoffset;
+    height = a.height + b.height;
+  } else if (same_x && same_y && (a.zoffset + a.depth == b.zoffset ||
+                                  b.zoffset + b.depth == a.zoffset)) {
+    zoffset = a.zoffset < b.zoffset ? a.zoffset : b.zoffset;
+    depth = a.depth + b.depth;
+  } else {
+    return false;
+  }
+
+  if (BoxSizeInBytes(width, height, depth, bytes_per_texel) > limit)
+    return false;
+
+  a.xoffset = xoffset;
+  a.yoffset = yoffset;
+  a.zoffset = zoffset;
+  a.width = width;
+  a.height = height;
+  a.depth = depth;
+  a.pieces.insert(a.pieces.end(), b.pieces.begin(), b.pieces.end());
+  return true;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderAPI.h"
+
+/// @brief A single pending sub-region upload. Mirrors the parameters of
+/// RenderAPI::TextureSubImage3D.
+struct UploadCommand {
+  void* texture_handle;
+  int32_t xoffset;
+  int32_t yoffset;
+  int32_t zoffset;
+  int32_t width;
+  int32_t height;
+  int32_t depth;
+  void* data_ptr;
+  SourceLayout layout;
+  int32_t level;
+  Format format;
+  // ticket of the enqueued command this upload belongs to
+  uint64_t ticket;
+  // keeps the memory data_ptr points into alive if it is owned by the plugin
+  std::shared_ptr<void> storage;
+};
+
+/// @brief Thread-safe queue of 3D sub-region uploads that are executed on the
+/// render thread in a single flush.
+///
+/// Uploads that target the same texture, level and format and that tile a
+/// larger contiguous box are coalesced into a single TextureSubImage3D call.
+/// Sources that are already laid out contiguously in memory (e.g., consecutive
+/// Z-slabs of the same array or neighbouring sub-boxes of the same strided
+/// host volume) are uploaded in place, other sources are gathered into a
+/// staging buffer first.
+///
+/// Uploads larger than the slab size are split into Z-slabs (or Y-tiles if a
+/// single slice is already too large) when they are pushed. If a time budget
+/// is set, a flush stops executing slabs once the budget is exhausted and the
+/// remaining ones are executed by subsequent flushes, so that large uploads
+/// are spread over several frames.
+///
+/// Each pushed command is identified by a ticket that is reported complete
+/// once all of its slabs have been uploaded. Source memory of a queued upload
+/// has to stay valid until its ticket is complete.
+class UploadQueue {
+ public:
+  UploadQueue();
+
+  /// @brief Appends an upload to the queue. Can be called from any thread.
+  /// @return ticket of the upload (see IsComplete)
+  uint64_t Push(const UploadCommand& cmd) { return Push(&cmd, 1); }
+
+  /// @brief Appends several uploads that share a single ticket to the queue.
+  /// Can be called from any thread.
+  /// @return ticket of the uploads, complete once all of them are executed
+  uint64_t Push(const UploadCommand* cmds, size_t count);
+
+  /// @brief Issues a ticket for an upload that is dropped without being
+  /// executed (e.g., because its content is already resident). The ticket is
+  /// reported complete right away.
+  uint64_t Drop();
+
+  /// @brief Issues a ticket for uploads that are pushed later through Fulfill
+  /// (e.g., once their source has been decompressed on a worker thread). The
+  /// ticket is not reported complete before it is fulfilled.
+  uint64_t Reserve();
+
+  /// @brief Appends the uploads of a reserved ticket to the queue. Can be
+  /// called from any thread. Without uploads, the ticket is reported complete
+  /// right away. Uploads of tickets dropped by Clear in the meantime are
+  /// discarded.
+  void Fulfill(uint64_t ticket, const UploadCommand* cmds, size_t count);
+
+  /// @brief Coalesces and executes the queued uploads in submission order,
+  /// coarser mip levels first, until the queue is empty or the time budget is
+  /// exhausted. Has to be called from the render thread.
+  /// @param api render API used to execute the uploads
+  /// @param executed if not NULL, receives the executed uploads (without
+  /// their source storage)
+  void Flush(RenderAPI* api, std::vector<UploadCommand>* executed = NULL);
+
+  /// @brief Drops all queued uploads without executing them (e.g., on device
+  /// shutdown). Their tickets are reported complete so that callers can
+  /// release the source memory.
+  void Clear();
+
+  /// @brief Whether all slabs of the upload identified by ticket have been
+  /// executed. Can be called from any thread.
+  bool IsComplete(uint64_t ticket);
+
+  /// @brief Sets the size in bytes above which pushed uploads are split into
+  /// slabs. 0 disables splitting.
+  void SetSlabSize(size_t max_bytes);
+
+  /// @brief Sets the maximum time in milliseconds a single flush may spend
+  /// executing uploads. At least one slab is executed per flush. 0 (the
+  /// default) flushes the whole queue.
+  void SetTimeBudget(float milliseconds);
+
+  /// @brief Sets the maximum size in bytes of a coalesced upload. Uploads are
+  /// not merged if the resulting box would be larger than this. 0 disables
+  /// coalescing.
+  void SetCoalescingLimit(size_t max_bytes);
+
+ private:
+  struct Node;
+
+  /// @brief Merges b into a if both boxes are adjacent along exactly one axis
+  /// and have the same extents along the two other axes.
+  /// @return true if b has been merged into a
+  static bool TryMerge(Node& a, const Node& b, uint32_t bytes_per_texel,
+                       size_t limit);
+
+  /// @brief Appends cmd to the pending uploads, split into slabs if needed.
+  /// @return number of appended slabs
+  uint32_t Split(const UploadCommand& cmd, uint64_t ticket);
+
+  /// @brief Coalesces and executes a batch of uploads.
+  void Execute(RenderAPI* api, const std::vector<UploadCommand>& cmds,
+               size_t coalescing_limit);
+
+  void Upload(RenderAPI* api, const Node& node,
+              const std::vector<UploadCommand>& cmds);
+
+  std::mutex m_Mutex;
+  std::deque<UploadCommand> m_Pending;
+  size_t m_CoalescingLimit;
+  size_t m_SlabSize;
+  float m_TimeBudget;
+  uint64_t m_NextTicket;
+  // number of not yet executed slabs per ticket
+  std::unordered_map<uint64_t, uint32_t> m_Outstanding;
+
+  // only accessed from the render thread
+  std::vector<uint8_t> m_Staging;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/// @brief Thread-safe registry of the volume sources (e.g., mapped or bricked
+/// volume files) opened through the plugin, identified by positive ids.
+/// Volumes are shared so that queued uploads keep them open after they are
+/// unregistered.
+template <typename Volume>
+class VolumeTable {
+ public:
+  VolumeTable() : m_NextId(1) {}
+
+  /// @return id of the volume
+  int32_t Register(const std::shared_ptr<Volume>& volume) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    int32_t id = m_NextId++;
+    m_Volumes[id] = volume;
+    return id;
+  }
+
+  void Unregister(int32_t id) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Volumes.erase(id);
+  }
+
+  /// @return the volume, NULL if the id is not registered
+  std::shared_ptr<Volume> Find(int32_t id) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    typename std::unordered_map<int32_t, std::shared_ptr<Volume> >::iterator
+        it = m_Volumes.find(id);
+    return it == m_Volumes.end() ? std::shared_ptr<Volume>() : it->second;
+  }
+
+  /// @brief Unregisters all volumes (e.g., on plugin unload).
+  void Clear() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Volumes.clear();
+  }
+
+ private:
+  std::mutex m_Mutex;
+  int32_t m_NextId;
+  std::unordered_map<int32_t, std::shared_ptr<Volume> > m_Volumes;
+};
@@ -0,0 +1,91 @@
+#include "WorkerPool.h"
+
+#include <utility>
+
+/// @brief Number of threads used if none has been set.
+static uint32_t DefaultThreadCount() {
+  uint32_t count = std::thread::hardware_concurrency();
+  return count > 1 ? count - 1 : 1;
+}
+
+WorkerPool::WorkerPool() : m_ThreadCount(0), m_Generation(0) {}
+
+WorkerPool::~WorkerPool() { Shutdown(); }
+
+void WorkerPool::Submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Tasks.push_back(std::move(task));
+    if (m_Threads.empty()) Start();
+  }
+  m_Condition.notify_one();
+}
+
+void WorkerPool::SubmitLowPriority(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_LowPriorityTasks.push_back(std::move(task));
+    if (m_Threads.empty()) Start();
+  }
+  m_Condition.notify_one();
+}
+
+void WorkerPool::SetThreadCount(uint32_t count) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (count == m_ThreadCount) return;
+    m_ThreadCount = count;
+  }
+  Stop();
+
+  // restart right away if there is work left
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if ((!m_Tasks.empty() || !m_LowPriorityTasks.empty()) && m_Threads.empty())
+    Start();
+}
+
+void WorkerPool::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Tasks.clear();
+    m_LowPriorityTasks.clear();
+  }
+  Stop();
+}
+
+void WorkerPool::Start() {
+  uint32_t count = m_ThreadCount > 0 ? m_ThreadCount : DefaultThreadCount();
+  for (uint32_t i = 0; i < count; ++i)
+    m_Threads.push_back(std::thread(&WorkerPool::Run, this, m_Generation));
+}
+
+void WorkerPool::Stop() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    // threads of older generations exit once they see the new one
+    ++m_Generation;
+    threads.swap(m_Threads);
+  }
+  m_Condition.notify_all();
+  for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+}
+
+void WorkerPool::Run(uint64_t generation) {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_Condition.wait(lock, [&] {
+        return generation != m_Generation || !m_Tasks.empty() ||
+               !m_LowPriorityTasks.empty();
+      });
+      if (generation != m_Generation) return;
+      std::deque<std::function<void()> >& tasks =
+          m_Tasks.empty() ? m_LowPriorityTasks : m_Tasks;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Fixed-size pool of native worker threads executing tasks in
+/// submission order (e.g., decompression of queued uploads), low-priority
+/// tasks after all others.
+///
+/// Threads are started on the first Submit so that loading the plugin does
+/// not spawn any. By default one thread less than the number of hardware
+/// threads is used, leaving a core to Unity's main and render threads.
+class WorkerPool {
+ public:
+  WorkerPool();
+  ~WorkerPool();
+
+  /// @brief Queues a task. Can be called from any thread.
+  void Submit(std::function<void()> task);
+
+  /// @brief Queues a low-priority task (e.g., prefetching) that only starts
+  /// once no task queued through Submit is waiting. Can be called from any
+  /// thread.
+  void SubmitLowPriority(std::function<void()> task);
+
+  /// @brief Sets the number of worker threads (0: default). Running threads
+  /// finish their current task and are replaced, queued tasks are kept.
+  void SetThreadCount(uint32_t count);
+
+  /// @brief Waits for the running tasks, drops the queued ones and stops all
+  /// threads. Has to be called before the plugin is unloaded.
+  void Shutdown();
+
+ private:
+  void Run(uint64_t generation);
+
+  /// @brief Starts the threads of the current generation. m_Mutex must be
+  /// held.
+  void Start();
+
+  /// @brief Joins all threads. m_Mutex must not be held.
+  void Stop();
+
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::deque<std::function<void()> > m_Tasks;
+  std::deque<std::function<void()> > m_LowPriorityTasks;
+  std::vector<std::thread> m_Threads;
+  uint32_t m_ThreadCount;
+  // incremented to make the running threads exit
+  uint64_t m_Generation;
+};
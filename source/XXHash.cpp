@@ -0,0 +1,132 @@
+#include "XXHash.h"
+
+#include <string.h>
+
+static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t Rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// xxHash is defined on little endian reads, which all supported platforms are
+static inline uint64_t Read64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t Read32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input) {
+  acc += input * kPrime2;
+  acc = Rotl(acc, 31);
+  return acc * kPrime1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t val) {
+  acc ^= Round(0, val);
+  return acc * kPrime1 + kPrime4;
+}
+
+XXHash64::XXHash64(uint64_t seed)
+    : m_Seed(seed), m_TotalSize(0), m_BufferSize(0) {
+  m_Acc[0] = seed + kPrime1 + kPrime2;
+  m_Acc[1] = seed + kPrime2;
+  m_Acc[2] = seed;
+  m_Acc[3] = seed - kPrime1;
+}
+
+void XXHash64::Update(const void* data, size_t size) {
+  const uint8_t* p = (const uint8_t*)data;
+  const uint8_t* end = p + size;
+  m_TotalSize += size;
+
+  if (m_BufferSize + size < 32) {
+    memcpy(m_Buffer + m_BufferSize, p, size);
+    m_BufferSize += (uint32_t)size;
+    return;
+  }
+
+  if (m_BufferSize > 0) {
+    uint32_t fill = 32 - m_BufferSize;
+    memcpy(m_Buffer + m_BufferSize, p, fill);
+    p += fill;
+    m_Acc[0] = Round(m_Acc[0], Read64(m_Buffer));
+    m_Acc[1] = Round(m_Acc[1], Read64(m_Buffer + 8));
+    m_Acc[2] = Round(m_Acc[2], Read64(m_Buffer + 16));
+    m_Acc[3] = Round(m_Acc[3], Read64(m_Buffer + 24));
+    m_BufferSize = 0;
+  }
+
+  // the four lanes are independent of each other which lets the CPU keep
+  // four multiplications in flight
+  uint64_t a0 = m_Acc[0], a1 = m_Acc[1], a2 = m_Acc[2], a3 = m_Acc[3];
+  while (end - p >= 32) {
+    a0 = Round(a0, Read64(p));
+    a1 = Round(a1, Read64(p + 8));
+    a2 = Round(a2, Read64(p + 16));
+    a3 = Round(a3, Read64(p + 24));
+    p += 32;
+  }
+  m_Acc[0] = a0;
+  m_Acc[1] = a1;
+  m_Acc[2] = a2;
+  m_Acc[3] = a3;
+
+  m_BufferSize = (uint32_t)(end - p);
+  memcpy(m_Buffer, p, m_BufferSize);
+}
+
+uint64_t XXHash64::Digest() const {
+  uint64_t h;
+  if (m_TotalSize >= 32) {
+    h = Rotl(m_Acc[0], 1) + Rotl(m_Acc[1], 7) + Rotl(m_Acc[2], 12) +
+        Rotl(m_Acc[3], 18);
+    h = MergeRound(h, m_Acc[0]);
+    h = MergeRound(h, m_Acc[1]);
+    h = MergeRound(h, m_Acc[2]);
+    h = MergeRound(h, m_Acc[3]);
+  } else {
+    h = m_Seed + kPrime5;
+  }
+  h += m_TotalSize;
+
+  const uint8_t* p = m_Buffer;
+  const uint8_t* end = m_Buffer + m_BufferSize;
+  while (end - p >= 8) {
+    h ^= Round(0, Read64(p));
+    h = Rotl(h, 27) * kPrime1 + kPrime4;
+    p += 8;
+  }
+  if (end - p >= 4) {
+    h ^= (uint64_t)Read32(p) * kPrime1;
+    h = Rotl(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= (*p) * kPrime5;
+    h = Rotl(h, 11) * kPrime1;
+    ++p;
+  }
+
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t XXHash64::Hash(const void* data, size_t size, uint64_t seed) {
+  XXHash64 state(seed);
+  state.Update(data, size);
+  return state.Digest();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Streaming implementation of the 64-bit xxHash (XXH64) algorithm.
+/// Produces the same digests as the reference implementation. Input is
+/// consumed in 32-byte stripes over four independent accumulators, hence
+/// hashing runs close to memory bandwidth even for short rows of strided
+/// sources.
+class XXHash64 {
+ public:
+  explicit XXHash64(uint64_t seed = 0);
+
+  /// @brief Feeds size bytes pointed to by data into the hash state.
+  void Update(const void* data, size_t size);
+
+  /// @brief Returns the hash of all the data fed so far. Does not modify the
+  /// state so more data can still be fed afterwards.
+  uint64_t Digest() const;
+
+  /// @brief Hashes a single contiguous buffer.
+  static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+ private:
+  uint64_t m_Acc[4];
+  uint64_t m_Seed;
+  uint64_t m_TotalSize;
+  uint8_t m_Buffer[32];
+  uint32_t m_BufferSize;
+};
@@ -0,0 +1,293 @@
+// Command line builder of bricked multi-resolution volume files
+// (source/BrickedVolume.h) from raw volumes.
+//
+// Reads a raw volume (x fastest, then y, then z, little endian), builds the
+// coarser levels with the SIMD 2x2x2 box filter of source/Downsample.h, cuts
+// every level into bricks and writes them with their min/max and an index.
+// Downsampling, brick statistics and compression run on all hardware threads.
+//
+//   BrickBuilder [options] <input.raw> <width> <height> <depth> <r8|r16>
+//                <output.bvol>
+//
+// Options:
+//   -b <size>       brick size (default 64)
+//   -l <levels>     number of levels (default: until a level fits in a brick)
+//   -c <none|delta> codec of the bricks (default none, delta: lossless R16
+//                   codec of source/DeltaCodec.h, kept only where it shrinks
+//                   the brick)
+//   -a <bytes>      alignment of the bricks within the file (default 4096,
+//                   allows O_DIRECT reads)
+//   -j <threads>    number of threads (default: hardware threads)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../source/BrickedVolume.h"
+#include "../source/Decompression.h"
+#include "../source/DeltaCodec.h"
+#include "../source/Downsample.h"
+
+struct Options {
+  int32_t brick_size;
+  int32_t level_count;
+  bool delta;
+  uint32_t alignment;
+  uint32_t threads;
+};
+
+/// @brief Runs task(i) for i in [0, count) on all threads.
+template <typename Task>
+static void ParallelFor(size_t count, uint32_t threads, const Task& task) {
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  for (uint32_t t = 0; t < threads; ++t) {
+    pool.push_back(std::thread([&]() {
+      for (size_t i; (i = next++) < count;) task(i);
+    }));
+  }
+  for (size_t t = 0; t < pool.size(); ++t) pool[t].join();
+}
+
+/// @brief Minimum and maximum texel value of a tightly packed box.
+template <typename T>
+static void MinMax(const T* texels, size_t count, uint32_t& min,
+                   uint32_t& max) {
+  T lo = texels[0], hi = texels[0];
+  for (size_t i = 1; i < count; ++i) {
+    lo = std::min(lo, texels[i]);
+    hi = std::max(hi, texels[i]);
+  }
+  min = lo;
+  max = hi;
+}
+
+/// @brief Encoded brick of a level, before its offset is known.
+struct Brick {
+  std::vector<uint8_t> data;
+  BrickedVolumeEntry entry;
+};
+
+/// @brief Cuts a level into bricks and encodes them.
+static void BuildBricks(const std::vector<uint8_t>& level, int32_t width,
+                        int32_t height, int32_t depth, Format format,
+                        const Options& options, std::vector<Brick>& bricks) {
+  int32_t size = options.brick_size;
+  int32_t bricks_x = (width + size - 1) / size;
+  int32_t bricks_y = (height + size - 1) / size;
+  int32_t bricks_z = (depth + size - 1) / size;
+  uint32_t bytes_per_texel = BytesPerTexel(format);
+  bricks.resize((size_t)bricks_x * bricks_y * bricks_z);
+
+  ParallelFor(bricks.size(), options.threads, [&](size_t i) {
+    int32_t bx = (int32_t)(i % bricks_x);
+    int32_t by = (int32_t)(i / bricks_x % bricks_y);
+    int32_t bz = (int32_t)(i / bricks_x / bricks_y);
+    int32_t x = bx * size, y = by * size, z = bz * size;
+    int32_t w = std::min(size, width - x), h = std::min(size, height - y),
+            d = std::min(size, depth - z);
+
+    Brick& brick = bricks[i];
+    size_t row_size = (size_t)w * bytes_per_texel;
+    brick.data.resize(row_size * h * d);
+    for (int32_t k = 0; k < d; ++k) {
+      for (int32_t j = 0; j < h; ++j) {
+        size_t src = (((size_t)(z + k) * height + y + j) * width + x) *
+                     bytes_per_texel;
+        memcpy(&brick.data[((size_t)k * h + j) * row_size], &level[src],
+               row_size);
+      }
+    }
+
+    memset(&brick.entry, 0, sizeof(brick.entry));
+    size_t count = (size_t)w * h * d;
+    if (bytes_per_texel == 1) {
+      MinMax(brick.data.data(), count, brick.entry.min, brick.entry.max);
+    } else {
+      MinMax((const uint16_t*)brick.data.data(), count, brick.entry.min,
+             brick.entry.max);
+    }
+
+    brick.entry.codec = kCodecNone;
+    if (options.delta) {
+      std::vector<uint8_t> encoded;
+      EncodeDeltaR16((const uint16_t*)brick.data.data(), w, h, d, encoded);
+      if (encoded.size() < brick.data.size()) {
+        brick.data.swap(encoded);
+        brick.entry.codec = kCodecDeltaR16;
+      }
+    }
+    brick.entry.size = (uint32_t)brick.data.size();
+  });
+}
+
+/// @brief Writes zeros up to the next multiple of the alignment.
+static bool Pad(FILE* file, uint64_t& offset, uint32_t alignment) {
+  static const uint8_t kZeros[4096] = {0};
+  uint64_t padding = (alignment - offset % alignment) % alignment;
+  offset += padding;
+  for (; padding > 0;) {
+    size_t chunk = (size_t)std::min<uint64_t>(padding, sizeof(kZeros));
+    if (fwrite(kZeros, 1, chunk, file) != chunk) return false;
+    padding -= chunk;
+  }
+  return true;
+}
+
+static int Usage() {
+  fprintf(stderr,
+          "usage: BrickBuilder [-b brick_size] [-l levels] [-c none|delta] "
+          "[-a alignment] [-j threads]\n"
+          "                    <input.raw> <width> <height> <depth> <r8|r16> "
+          "<output.bvol>\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  options.brick_size = 64;
+  options.level_count = 0;
+  options.delta = false;
+  options.alignment = 4096;
+  options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+  int arg = 1;
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    const char* value = argv[arg + 1];
+    switch (argv[arg][1]) {
+      case 'b':
+        options.brick_size = atoi(value);
+        break;
+      case 'l':
+        options.level_count = atoi(value);
+        break;
+      case 'c':
+        if (strcmp(value, "delta") != 0 && strcmp(value, "none") != 0)
+          return Usage();
+        options.delta = strcmp(value, "delta") == 0;
+        break;
+      case 'a':
+        options.alignment = (uint32_t)atoi(value);
+        break;
+      case 'j':
+        options.threads = (uint32_t)atoi(value);
+        break;
+      default:
+        return Usage();
+    }
+  }
+  if (argc - arg != 6) return Usage();
+  const char* input = argv[arg];
+  int32_t width = atoi(argv[arg + 1]), height = atoi(argv[arg + 2]),
+          depth = atoi(argv[arg + 3]);
+  Format format;
+  if (strcmp(argv[arg + 4], "r8") == 0) {
+    format = R8_UINT;
+  } else if (strcmp(argv[arg + 4], "r16") == 0) {
+    format = R16_UINT;
+  } else {
+    return Usage();
+  }
+  const char* output = argv[arg + 5];
+  if (width <= 0 || height <= 0 || depth <= 0 || options.brick_size <= 0 ||
+      options.level_count < 0 || options.level_count > 32 ||
+      options.alignment == 0 || options.threads == 0 ||
+      (options.delta && format != R16_UINT))
+    return Usage();
+  if (options.level_count == 0) {
+    options.level_count = 1;
+    for (int32_t w = width, h = height, d = depth;
+         std::max(w, std::max(h, d)) > options.brick_size;
+         ++options.level_count) {
+      w = DownsampledExtent(w);
+      h = DownsampledExtent(h);
+      d = DownsampledExtent(d);
+    }
+  }
+
+  // level 0
+  std::vector<uint8_t> level(TextureDataSize(format, width, height, depth));
+  FILE* in = fopen(input, "rb");
+  bool read = in && fread(level.data(), 1, level.size(), in) == level.size();
+  if (in) fclose(in);
+  if (!read) {
+    fprintf(stderr, "cannot read %zu bytes from %s\n", level.size(), input);
+    return 1;
+  }
+
+  FILE* out = fopen(output, "wb");
+  if (!out) {
+    fprintf(stderr, "cannot write %s\n", output);
+    return 1;
+  }
+  BrickedVolumeHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kBrickedVolumeMagic;
+  header.version = kBrickedVolumeVersion;
+  header.width = width;
+  header.height = height;
+  header.depth = depth;
+  header.format = format;
+  header.brick_size = options.brick_size;
+  header.level_count = options.level_count;
+  header.alignment = options.alignment;
+
+  // the header is rewritten once the index offset is known
+  bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+  uint64_t offset = sizeof(header);
+  uint64_t stored = 0;
+  std::vector<BrickedVolumeEntry> index;
+  std::vector<Brick> bricks;
+  for (int32_t l = 0; ok && l < options.level_count; ++l) {
+    BuildBricks(level, width, height, depth, format, options, bricks);
+    for (size_t i = 0; ok && i < bricks.size(); ++i) {
+      ok = Pad(out, offset, options.alignment) &&
+           fwrite(bricks[i].data.data(), 1, bricks[i].data.size(), out) ==
+               bricks[i].data.size();
+      bricks[i].entry.offset = offset;
+      offset += bricks[i].data.size();
+      stored += bricks[i].data.size();
+      index.push_back(bricks[i].entry);
+    }
+    printf("level %d: %dx%dx%d, %zu bricks\n", l, width, height, depth,
+           bricks.size());
+    if (l + 1 == options.level_count) break;
+
+    // next level, one output slice per task
+    int32_t next_width = DownsampledExtent(width);
+    int32_t next_height = DownsampledExtent(height);
+    int32_t next_depth = DownsampledExtent(depth);
+    std::vector<uint8_t> next(
+        TextureDataSize(format, next_width, next_height, next_depth));
+    ParallelFor(next_depth, options.threads, [&](size_t z) {
+      Downsample2x(level.data(), width, height, depth, format, next.data(),
+                   (int32_t)z, 1);
+    });
+    level.swap(next);
+    width = next_width;
+    height = next_height;
+    depth = next_depth;
+  }
+
+  header.index_offset = offset;
+  header.brick_count = index.size();
+  ok = ok &&
+       fwrite(index.data(), sizeof(BrickedVolumeEntry), index.size(), out) ==
+           index.size() &&
+       fseek(out, 0, SEEK_SET) == 0 &&
+       fwrite(&header, sizeof(header), 1, out) == 1;
+  ok = fclose(out) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "cannot write %s\n", output);
+    return 1;
+  }
+  printf("%d levels, %zu bricks, %llu bytes of brick data\n",
+         options.level_count, index.size(), (unsigned long long)stored);
+  return 0;
+}
@@ -0,0 +1,113 @@
+// Command line encoder for the lossless R16 brick codec (source/DeltaCodec.h).
+//
+// Encodes a raw volume of little endian 16-bit texels (x fastest, then y,
+// then z) into a payload that can be passed to
+// EnqueueCompressedTextureSubImage3D with codec 3, and decodes it again for
+// verification.
+//
+//   DeltaEncoder <input.raw> <width> <height> <depth> <output>
+//   DeltaEncoder -d <input> <output.raw>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../source/DeltaCodec.h"
+
+static bool ReadFile(const char* path, std::vector<uint8_t>& data) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  data.resize(size > 0 ? (size_t)size : 0);
+  bool ok = size >= 0 && (data.empty() ||
+                          fread(&data[0], 1, data.size(), file) == data.size());
+  fclose(file);
+  return ok;
+}
+
+static bool WriteFile(const char* path, const void* data, size_t size) {
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+  bool ok = fwrite(data, 1, size, file) == size;
+  return fclose(file) == 0 && ok;
+}
+
+static int Usage() {
+  fprintf(stderr,
+          "usage: DeltaEncoder <input.raw> <width> <height> <depth> <output>\n"
+          "       DeltaEncoder -d <input> <output.raw>\n");
+  return 2;
+}
+
+static int Decode(const char* input, const char* output) {
+  std::vector<uint8_t> encoded;
+  if (!ReadFile(input, encoded)) {
+    fprintf(stderr, "cannot read %s\n", input);
+    return 1;
+  }
+  DeltaCodecHeader header;
+  size_t data_offset;
+  if (!ReadDeltaR16Header(encoded.data(), encoded.size(), header,
+                          data_offset)) {
+    fprintf(stderr, "%s is not an encoded R16 brick\n", input);
+    return 1;
+  }
+  std::vector<uint16_t> texels((size_t)header.width * header.height *
+                               header.depth);
+  if (!DecodeDeltaR16(encoded.data(), encoded.size(), texels.data(),
+                      texels.size()) ||
+      !WriteFile(output, texels.data(), texels.size() * sizeof(uint16_t))) {
+    fprintf(stderr, "cannot decode %s to %s\n", input, output);
+    return 1;
+  }
+  printf("%dx%dx%d texels\n", header.width, header.height, header.depth);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 4 && strcmp(argv[1], "-d") == 0) return Decode(argv[2], argv[3]);
+  if (argc != 6) return Usage();
+
+  int32_t width = atoi(argv[2]), height = atoi(argv[3]),
+          depth = atoi(argv[4]);
+  if (width <= 0 || height <= 0 || depth <= 0) return Usage();
+  size_t count = (size_t)width * height * depth;
+
+  std::vector<uint8_t> raw;
+  if (!ReadFile(argv[1], raw)) {
+    fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 1;
+  }
+  if (raw.size() != count * sizeof(uint16_t)) {
+    fprintf(stderr, "%s has %zu bytes, expected %zu for %dx%dx%d R16 texels\n",
+            argv[1], raw.size(), count * sizeof(uint16_t), width, height,
+            depth);
+    return 1;
+  }
+  std::vector<uint16_t> texels(count);
+  memcpy(texels.data(), raw.data(), raw.size());
+
+  std::vector<uint8_t> encoded;
+  EncodeDeltaR16(texels.data(), width, height, depth, encoded);
+
+  // verify the round trip before writing anything
+  std::vector<uint16_t> decoded(count);
+  if (!DecodeDeltaR16(encoded.data(), encoded.size(), decoded.data(),
+                      decoded.size()) ||
+      decoded != texels) {
+    fprintf(stderr, "round trip failed\n");
+    return 1;
+  }
+  if (!WriteFile(argv[5], encoded.data(), encoded.size())) {
+    fprintf(stderr, "cannot write %s\n", argv[5]);
+    return 1;
+  }
+  printf("%zu -> %zu bytes (%.2fx)\n", raw.size(), encoded.size(),
+         (double)raw.size() / (double)encoded.size());
+  return 0;
+}